@@ -0,0 +1,279 @@
+// Copyright (c) RealCoolEngineer. 2024. All rights reserved.
+// Author: beiklive
+// Date: 2024-04-12
+//
+// 日志模块延迟/吞吐基准测试，结果以 JSON 输出，便于版本间对比
+//   xmake run bench_logger --threads 1,4,16 --sizes 16,256 --outputs none,file --json bench.json > /dev/null
+// 比较异步后台的唤醒方式（CPU 占用与入队到写出的延迟），生产者每条之间停顿 50us：
+//   xmake run bench_logger --modes async --wake poll,spin,notify --pause-us 50 --threads 1,4 --outputs file
+#include "../inc/log.hh"
+#include <filesystem>
+#include <fstream>
+#include <vector>
+
+using namespace beiklive::LOG;
+
+namespace
+{
+    struct BenchConfig
+    {
+        std::vector<int>         threads{ 1, 2, 4, 8, 16, 32, 64, 128, 256 };
+        std::vector<size_t>      sizes{ 16, 128, 1024 };
+        std::vector<std::string> outputs{ "none", "console", "file", "all" };
+        std::vector<std::string> modes{ "sync", "async" };
+        std::vector<std::string> wakes{ "poll" };
+        int                      pauseUs = 0;
+        int                      iterations = 1000;
+        std::string              jsonPath = "bench_logger.json";
+        std::string              logDir = "./bench_log";
+        std::string              label;
+        std::vector<std::string> fileModes{ "buffered" };
+        bool                     keep = false;
+    };
+
+    struct BenchResult
+    {
+        int            threads;
+        std::string    mode;
+        std::string    wake;
+        std::string    fileMode;
+        std::string    output;
+        size_t         messageBytes;
+        uint64_t       records;
+        double         seconds;
+        LatencySummary latency;
+        LatencySummary queueLatency;
+        BackendStats   backend;
+        std::string    loggerMetrics;
+    };
+
+    template <typename T>
+    std::vector<T> parseList(const std::string& arg)
+    {
+        std::vector<T> values;
+        std::stringstream ss(arg);
+        std::string item;
+        while (std::getline(ss, item, ',')) {
+            if (item.empty()) {
+                continue;
+            }
+            std::stringstream conv(item);
+            T v;
+            conv >> v;
+            values.push_back(v);
+        }
+        return values;
+    }
+
+    OUTPUT outputOf(const std::string& name)
+    {
+        if (name == "console") return OUTPUT::CONSOLE;
+        if (name == "file") return OUTPUT::FILE;
+        if (name == "all") return OUTPUT::ALL;
+        return OUTPUT::NONE;
+    }
+
+    WAKEMODE wakeOf(const std::string& name)
+    {
+        if (name == "spin") return WAKEMODE::SPIN;
+        if (name == "notify") return WAKEMODE::NOTIFY;
+        return WAKEMODE::POLL;
+    }
+
+    BenchResult runOnce(const BenchConfig& cfg, int threads, const std::string& mode, const std::string& wake,
+                        const std::string& fileMode, const std::string& output, size_t size)
+    {
+        const std::string payload(size, 'x');
+        std::vector<std::unique_ptr<LatencyHistogram>> histograms;
+        for (int i = 0; i < threads; ++i) {
+            histograms.emplace_back(new LatencyHistogram());
+        }
+
+        LoggerOutputSet(outputOf(output));
+        if (mode == "async") {
+            BackendOptions options;
+            options.wake = wakeOf(wake);
+            LoggerAsyncStart(options);
+        }
+        LoggerMetricsReset();
+
+        std::atomic<bool> go{ false };
+        std::atomic<int> ready{ 0 };
+        std::vector<std::thread> workers;
+        for (int t = 0; t < threads; ++t) {
+            workers.emplace_back([&, t]() {
+                LatencyHistogram& h = *histograms[t];
+                ready.fetch_add(1);
+                while (!go.load(std::memory_order_acquire)) {
+                    std::this_thread::yield();
+                }
+                for (int i = 0; i < cfg.iterations; ++i) {
+                    uint64_t start = TscClock::now();
+                    LOG_INFO("{}", payload);
+                    h.record(TscClock::toNanoseconds(TscClock::now() - start));
+                    if (cfg.pauseUs > 0) {
+                        std::this_thread::sleep_for(std::chrono::microseconds(cfg.pauseUs));
+                    }
+                }
+            });
+        }
+        while (ready.load() < threads) {
+            std::this_thread::yield();
+        }
+
+        auto begin = std::chrono::steady_clock::now();
+        go.store(true, std::memory_order_release);
+        for (auto& w : workers) {
+            w.join();
+        }
+        // 异步模式的吞吐计入后台排空的时间
+        LoggerAsyncStop();
+        auto end = std::chrono::steady_clock::now();
+        BackendStats backend = LoggerBackendStats();
+
+        LatencyHistogram& merged = *histograms[0];
+        for (int i = 1; i < threads; ++i) {
+            merged.merge(*histograms[i]);
+        }
+
+        BenchResult r;
+        r.threads = threads;
+        r.mode = mode;
+        r.wake = mode == "async" ? wake : "";
+        r.fileMode = fileMode;
+        r.output = output;
+        r.messageBytes = size;
+        r.records = static_cast<uint64_t>(threads) * cfg.iterations;
+        r.seconds = std::chrono::duration<double>(end - begin).count();
+        r.latency = LatencySummary::of(merged);
+        MetricsSnapshot snap = LoggerMetricsSnapshot();
+        r.queueLatency = snap.queueLatencyNs;
+        r.backend = mode == "async" ? backend : BackendStats();
+        r.loggerMetrics = snap.toJson();
+        return r;
+    }
+
+    void writeJson(std::ostream& out, const BenchConfig& cfg, const std::vector<BenchResult>& results)
+    {
+        out << "{\"bench\":\"bench_logger\",\"label\":\"" << cfg.label << "\",\"timestamp\":\""
+            << getCurrentTimestamp() << "\",\"hardware_threads\":" << std::thread::hardware_concurrency()
+            << ",\"iterations_per_thread\":" << cfg.iterations << ",\"pause_us\":" << cfg.pauseUs << ",\"results\":[";
+        for (size_t i = 0; i < results.size(); ++i) {
+            const BenchResult& r = results[i];
+            out << (i ? "," : "") << "\n  {\"threads\":" << r.threads << ",\"mode\":\"" << r.mode << "\",\"wake\":\"" << r.wake << "\",\"file_mode\":\"" << r.fileMode << "\",\"output\":\"" << r.output
+                << "\",\"message_bytes\":" << r.messageBytes << ",\"records\":" << r.records
+                << ",\"seconds\":" << r.seconds << ",\"records_per_sec\":" << (r.seconds > 0 ? r.records / r.seconds : 0)
+                << ",\"latency_ns\":{\"p50\":" << r.latency.p50 << ",\"p99\":" << r.latency.p99
+                << ",\"p999\":" << r.latency.p999 << ",\"max\":" << r.latency.max
+                << ",\"mean\":" << r.latency.mean << "},\"queue_latency_ns\":{\"p50\":" << r.queueLatency.p50
+                << ",\"p99\":" << r.queueLatency.p99 << ",\"max\":" << r.queueLatency.max
+                << "},\"backend_cpu_ms\":" << r.backend.cpuNs / 1e6 << ",\"backend_wakeups\":" << r.backend.wakeups
+                << ",\"logger_metrics\":" << r.loggerMetrics << "}";
+        }
+        out << "\n]}" << std::endl;
+    }
+
+    // 日志目录下已有的条目，结束时只删除本次运行新建的
+    std::vector<std::filesystem::path> listEntries(const std::string& dir)
+    {
+        std::vector<std::filesystem::path> entries;
+        std::error_code ec;
+        for (auto it = std::filesystem::directory_iterator(dir, ec); !ec && it != std::filesystem::directory_iterator();
+             it.increment(ec)) {
+            entries.push_back(it->path());
+        }
+        return entries;
+    }
+
+    void removeCreated(const std::string& dir, bool dirExisted, const std::vector<std::filesystem::path>& before)
+    {
+        std::error_code ec;
+        for (const auto& path : listEntries(dir)) {
+            if (std::find(before.begin(), before.end(), path) == before.end()) {
+                std::filesystem::remove_all(path, ec);
+            }
+        }
+        if (!dirExisted) {
+            std::filesystem::remove(dir, ec);   // 只删除空目录
+        }
+    }
+}
+
+int main(int argc, char* argv[])
+{
+    BenchConfig cfg;
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        std::string next = (i + 1 < argc) ? argv[i + 1] : "";
+        if (arg == "--threads") { cfg.threads = parseList<int>(next); ++i; }
+        else if (arg == "--sizes") { cfg.sizes = parseList<size_t>(next); ++i; }
+        else if (arg == "--outputs") { cfg.outputs = parseList<std::string>(next); ++i; }
+        else if (arg == "--modes") { cfg.modes = parseList<std::string>(next); ++i; }
+        else if (arg == "--wake") { cfg.wakes = parseList<std::string>(next); ++i; }
+        else if (arg == "--pause-us") { cfg.pauseUs = std::stoi(next); ++i; }
+        else if (arg == "--iterations") { cfg.iterations = std::stoi(next); ++i; }
+        else if (arg == "--json") { cfg.jsonPath = next; ++i; }
+        else if (arg == "--dir") { cfg.logDir = next; ++i; }
+        else if (arg == "--file-mode") { cfg.fileModes = parseList<std::string>(next); ++i; }
+        else if (arg == "--label") { cfg.label = next; ++i; }
+        else if (arg == "--keep") { cfg.keep = true; }
+        else {
+            std::cerr << "usage: bench_logger [--threads 1,2,4] [--sizes 16,128] [--outputs none,console,file,all]"
+                      << " [--modes sync,async] [--wake poll,spin,notify] [--pause-us N] [--iterations N] [--json path] [--dir logdir] [--file-mode buffered,direct] [--label name] [--keep]" << std::endl;
+            return 1;
+        }
+    }
+
+    std::error_code ec;
+    const bool dirExisted = std::filesystem::exists(cfg.logDir, ec);
+    const std::vector<std::filesystem::path> existing = listEntries(cfg.logDir);
+    LogFilePathSet(cfg.logDir);
+    LoggerLevelSet(LOGLEVEL::INFO);
+    LoggerMetricsSampleSet(0);
+    TscClock::nsPerTick();  // 提前完成 TSC 校准，避免计入首轮
+
+    std::vector<BenchResult> results;
+    for (const auto& mode : cfg.modes) {
+        // 唤醒方式只对异步模式有意义
+        const std::vector<std::string> wakes = mode == "async" ? cfg.wakes : std::vector<std::string>{ "" };
+        for (const auto& wake : wakes) {
+            for (const auto& output : cfg.outputs) {
+                // 文件写入方式只对写文件的输出端有意义
+                const bool toFile = isFileOutput(outputOf(output));
+                const std::vector<std::string> fileModes = toFile ? cfg.fileModes : std::vector<std::string>{ "" };
+                for (const auto& fileMode : fileModes) {
+                    if (toFile) {
+                        LogFileModeSet(fileMode == "direct" ? FILEMODE::DIRECT : FILEMODE::BUFFERED);
+                    }
+                    for (size_t size : cfg.sizes) {
+                        for (int threads : cfg.threads) {
+                            BenchResult r = runOnce(cfg, threads, mode, wake, fileMode, output, size);
+                            std::cerr << "mode=" << r.mode << (r.wake.empty() ? "" : "/" + r.wake)
+                                      << " output=" << r.output << (r.fileMode.empty() ? "" : "/" + r.fileMode)
+                                      << " threads=" << r.threads << " bytes=" << r.messageBytes
+                                      << " rec/s=" << static_cast<uint64_t>(r.records / r.seconds)
+                                      << " p50=" << r.latency.p50 << " p99=" << r.latency.p99
+                                      << " p999=" << r.latency.p999 << " max=" << r.latency.max;
+                            if (r.mode == "async") {
+                                std::cerr << " queue_p50=" << r.queueLatency.p50 << " queue_p99=" << r.queueLatency.p99
+                                          << " backend_cpu_ms=" << r.backend.cpuNs / 1e6 << " wakeups=" << r.backend.wakeups;
+                            }
+                            std::cerr << std::endl;
+                            results.push_back(r);
+                        }
+                    }
+                }
+            }
+        }
+    }
+    LoggerStop();
+
+    std::ofstream json(cfg.jsonPath);
+    writeJson(json.is_open() ? static_cast<std::ostream&>(json) : std::cout, cfg, results);
+
+    // 只删除本次运行写出的日志，--dir 指向已有目录时不影响其中原有的文件
+    if (!cfg.keep) {
+        removeCreated(cfg.logDir, dirExisted, existing);
+    }
+    return 0;
+}
@@ -11,6 +11,7 @@ EXAMPLE_MAIN_START(log_main)
     LOGGER_DEBUG("this is debug 1");
     beiklive::LOG::LoggerLevelSet(beiklive::LOG::LOGLEVEL::DEBUG);
     LOGGER_DEBUG("this is debug 2");
+    beiklive::LOG::LoggerMetricsDump();
     beiklive::LOG::LoggerStop();
     LOGGER_INFO("this log will not output");
 
@@ -4,6 +4,7 @@
 #ifndef INC_LOG_HH_
 #define INC_LOG_HH_
 
+#include <algorithm>
 #include <iostream>
 #include <sstream>
 #include <iomanip>
@@ -12,11 +13,40 @@
 #include <sys/stat.h>
 #include <cstdlib>
 #include <memory>
+#include <chrono>
+#include <atomic>
+#include <thread>
+#include <condition_variable>
+#include <functional>
+#include <string_view>
+#include <vector>
+#include <map>
+#include <tuple>
+#include <type_traits>
+#include <cstddef>
+#include <cstring>
+#include <ctime>
 #ifdef _WIN32
 #include <direct.h>
 #else
 #include <unistd.h>  // For Unix/Linux
 #endif
+#include "log_clock.hh"
+#include "log_metrics.hh"
+#include "log_backend.hh"
+#include "log_flight.hh"
+#include "log_direct.hh"
+#include "log_shm.hh"
+#include "log_index.hh"
+#include "log_format.hh"
+#include "log_span.hh"
+#include "log_trace.hh"
+#include "log_context.hh"
+#include "log_hexdump.hh"
+#include "log_flush.hh"
+#include "log_filter.hh"
+#include "log_socket.hh"
+#include "log_recent.hh"
 
 
 
@@ -51,21 +81,121 @@ namespace beiklive
             ERROR = 31    // Red
         };
 
+        // 记录时间戳的取值方式：SYSTEM 直接取 system_clock，TSC 只读时间戳计数器、输出时再换算
+        enum class CLOCK
+        {
+            SYSTEM,
+            TSC
+        };
+
+        // 时间戳小数部分的位数
+        enum class PRECISION
+        {
+            MILLI,
+            MICRO,
+            NANO
+        };
+
+        struct Timestamp
+        {
+            int64_t value;   // SYSTEM: Unix 纪元纳秒；TSC: TscClock tick
+            CLOCK   clock;
+        };
+
+        // 调用点的静态描述，由 LOG_* 宏在每个调用点生成一份
+        struct Callsite
+        {
+            const char*          function;
+            const char*          file;
+            int                  line;
+            const FormatProgram* format = nullptr;   // 编译期解析的格式串
+            mutable std::atomic<uint32_t> filterState{ 0 };   // 过滤器版本 << 2 | FILTERMATCH
+            // 写出量统计：首次写出时挂入全局链表，之后只做 relaxed 累加
+            mutable std::atomic<uint64_t> hitRecords{ 0 };
+            mutable std::atomic<uint64_t> hitBytes{ 0 };
+            mutable std::atomic<bool>     hitListed{ false };
+            mutable const Callsite*       hitNext = nullptr;
+        };
+
+        namespace
+        {
+            std::atomic<const Callsite*> hitCallsites_{ nullptr };
+        }
+
+        // 各输出端统一按写出的整行计字节，包括行尾的换行符
+        constexpr size_t lineBytes(const size_t length)
+        {
+            return length + 1;
+        }
+
+        void countCallsite(const Callsite* callsite, const size_t bytes)
+        {
+            if (!callsite) {
+                return;
+            }
+            callsite->hitRecords.fetch_add(1, std::memory_order_relaxed);
+            callsite->hitBytes.fetch_add(bytes, std::memory_order_relaxed);
+            if (!callsite->hitListed.load(std::memory_order_relaxed) &&
+                !callsite->hitListed.exchange(true, std::memory_order_acq_rel)) {
+                const Callsite* head = hitCallsites_.load(std::memory_order_relaxed);
+                do {
+                    callsite->hitNext = head;
+                } while (!hitCallsites_.compare_exchange_weak(head, callsite, std::memory_order_release,
+                                                              std::memory_order_relaxed));
+            }
+        }
+
+        namespace
+        {
+            LoggerMetrics   metrics_;
+            TraceWriter     traceWriter_;
+            RecentLog       recentLog_;
+            std::atomic<bool> traceLogs_{ true };
+        }
+
+        int currentProcessId()
+        {
+#ifdef _WIN32
+            return 0;
+#else
+            return static_cast<int>(getpid());
+#endif
+        }
+
+
+        // 日志文件的写入方式：BUFFERED 走 ofstream 和页缓存，DIRECT 以 O_DIRECT 按块写入
+        enum class FILEMODE
+        {
+            BUFFERED,
+            DIRECT
+        };
 
         class FileLogger {
         public:
             FileLogger() : logFile(nullptr) {}
 
             ~FileLogger() {
-                if (logFile && logFile->is_open()) {
-
-                    // 刷新并关闭文件
-                    flush();
-                    logFile->close();
-                }
+                close();
             }
 
             void initializeLogFile(const std::string& filePath) {
+                timeIndex = TimeIndex(indexInterval);
+#ifndef _WIN32
+                if (mode == FILEMODE::DIRECT) {
+                    if (!directFile) {
+                        directFile.reset(new DirectFileWriter());
+                    }
+                    if (!directFile->open(filePath)) {
+                        std::cerr << "Error opening log file: " << filePath << std::endl;
+                    }
+                    else {
+                        currentFilePath = filePath;
+                        currentSize = directFile->size();
+                        loadIndex();
+                    }
+                    return;
+                }
+#endif
                 logFile.reset(new std::ofstream(filePath, std::ios::app));
 
                 if (!logFile->is_open()) {
@@ -75,36 +205,173 @@ namespace beiklive
                     currentFilePath = filePath;
                     // 设置缓冲区大小
                     logFile->rdbuf()->pubsetbuf(0, 1024);
-
+                    logFile->seekp(0, std::ios::end);
+                    currentSize = static_cast<long long>(logFile->tellp());
+                    loadIndex();
                 }
             }
 
-            void logMessage(const std::string& message) {
+            // flushNow 为 false 时由调用方在批量写入后统一 flush；wallNs 为记录时间，非 0 时计入时间索引
+            void logMessage(const std::string& message, bool flushNow = true, int64_t wallNs = 0) {
+                if (indexEnabled && wallNs != 0 && isOpen()) {
+                    timeIndex.observe(wallNs, currentSize);
+                }
+#ifndef _WIN32
+                if (directFile && directFile->isOpen()) {
+                    directFile->write(message.data(), message.size());
+                    directFile->write("\n", 1);
+                    if (flushNow) {
+                        flush();
+                    }
+                    currentSize += static_cast<long long>(lineBytes(message.size()));
+                    metrics_.countSink(SINK::FILE, lineBytes(message.size()));
+                    return;
+                }
+#endif
                 if (logFile && logFile->is_open()) {
-                    (*logFile) << message  << std::endl;
+                    if (flushNow) {
+                        (*logFile) << message  << std::endl;
+                    }
+                    else {
+                        (*logFile) << message << '\n';
+                    }
+                    currentSize += static_cast<long long>(lineBytes(message.size()));
+                    metrics_.countSink(SINK::FILE, lineBytes(message.size()));
+                }
+                else {
+                    metrics_.countDropped();
                 }
             }
 
             void switchLogFile(const std::string& newFilePath) {
-                if (logFile && logFile->is_open()) {
-                    // 刷新并关闭当前文件
-                    flush();
-                    logFile->close();
+                if (isOpen()) {
+                    // 刷新并关闭当前文件，DIRECT 模式下末尾不足一块的数据在此写出并截断
+                    close();
 
                     // 初始化新文件
                     initializeLogFile(newFilePath);
                 }
             }
 
-        private:
-            std::unique_ptr<std::ofstream> logFile;
-            std::string currentFilePath;
+            // 切换写入方式，已打开的文件关闭后按新方式续写
+            void setMode(FILEMODE newMode) {
+#ifdef _WIN32
+                newMode = FILEMODE::BUFFERED;
+#endif
+                if (newMode == mode) {
+                    return;
+                }
+                bool reopen = isOpen();
+                close();
+                mode = newMode;
+                if (reopen) {
+                    initializeLogFile(currentFilePath);
+                }
+            }
+
+            // 时间索引的开关与桶宽，下一个日志文件起生效
+            void setIndex(bool enable, uint32_t intervalSeconds) {
+                indexEnabled = enable;
+                indexInterval = intervalSeconds ? intervalSeconds : 1;
+            }
+
+            // 沿用另一个 FileLogger 的写入方式与索引设置，用于分片文件
+            void configureLike(const FileLogger& other) {
+                mode = other.mode;
+                indexEnabled = other.indexEnabled;
+                indexInterval = other.indexInterval;
+            }
+
+            bool isOpen() const {
+#ifndef _WIN32
+                if (directFile && directFile->isOpen()) {
+                    return true;
+                }
+#endif
+                return logFile && logFile->is_open();
+            }
+
+            // 当前文件已写入的字节数，避免每条日志都重新打开文件取大小
+            long long size() const {
+                return currentSize;
+            }
 
             void flush() {
+#ifndef _WIN32
+                if (directFile && directFile->isOpen()) {
+                    uint64_t start = TscClock::now();
+                    directFile->flush();
+                    metrics_.recordFlush(TscClock::now() - start);
+                    return;
+                }
+#endif
                 if (logFile && logFile->is_open()) {
+                    uint64_t start = TscClock::now();
                     logFile->flush();
+                    metrics_.recordFlush(TscClock::now() - start);
+                }
+            }
+
+            // 已写出的数据落盘：先 flush 到内核，再对同一文件 fdatasync（任一描述符都作用于整个文件）
+            void sync() {
+                flush();
+#ifndef _WIN32
+                if (!isOpen()) {
+                    return;
+                }
+                if (syncFd < 0) {
+                    syncFd = ::open(currentFilePath.c_str(), O_RDONLY | O_CLOEXEC);
+                }
+                if (syncFd < 0 || fdatasync(syncFd) != 0) {
+                    std::perror(("Error syncing log file: " + currentFilePath).c_str());
+                }
+#endif
+            }
+
+            // 关闭时把时间索引写入同名的 .idx 文件
+            void close() {
+                if (indexEnabled && isOpen() && !timeIndex.empty()) {
+                    if (!timeIndex.save(currentFilePath + ".idx")) {
+                        std::cerr << "Error writing log index: " << currentFilePath << ".idx" << std::endl;
+                    }
+                }
+                flush();
+#ifndef _WIN32
+                if (directFile) {
+                    directFile->close();
+                }
+#endif
+                if (logFile && logFile->is_open()) {
+                    logFile->close();
+                }
+#ifndef _WIN32
+                if (syncFd >= 0) {
+                    ::close(syncFd);
+                    syncFd = -1;
+                }
+#endif
+            }
+
+        private:
+            std::unique_ptr<std::ofstream> logFile;
+#ifndef _WIN32
+            std::unique_ptr<DirectFileWriter> directFile;
+            int syncFd = -1;
+#endif
+            FILEMODE mode = FILEMODE::BUFFERED;
+            std::string currentFilePath;
+            long long currentSize = 0;
+
+            // 续写已有文件时接着使用其索引
+            void loadIndex() {
+                if (indexEnabled && currentSize > 0) {
+                    timeIndex.load(currentFilePath + ".idx");
                 }
             }
+
+            bool      indexEnabled = true;
+            uint32_t  indexInterval = 1;
+            TimeIndex timeIndex;
         };
 
 
@@ -120,6 +387,12 @@ namespace beiklive
             FileLogger      filelogger;
 
             std::mutex      logMutex;
+            std::mutex      fileMutex;
+
+            std::atomic<CLOCK>      clock_{ CLOCK::SYSTEM };
+            std::atomic<PRECISION>  precision_{ PRECISION::MILLI };
+            // 进程启动时建立 TSC 锚点，首次换算时无需等待校准
+            const bool      clockAnchored_ = (TscClock::anchor(), true);
         }
 
         //*FILE ***************************************************************
@@ -165,19 +438,6 @@ namespace beiklive
         }
 
 
-        bool isFileSizeOverSize(const std::string& filename) {
-
-            std::lock_guard<std::mutex> lock(logMutex);
-            std::ifstream file(filename, std::ios::binary | std::ios::ate);
-            if (!file.is_open()) {
-                std::cerr << "Error opening file: " << filename << std::endl;
-                return false;  // Unable to open the file
-            }
-            std::streamsize fileSize = file.tellg();  // Get the file size
-            file.close();  // Close the file
-            return fileSize > MaxSingleLogFileSize_;
-        }
-
         void endsWithSlash(std::string& str) {
             if (!str.empty()) {
                 char lastChar = str.back();
@@ -190,8 +450,9 @@ namespace beiklive
             }
         }
 
-        void LogFileRotation(const std::string& msg)
+        void LogFileRotation(const std::string& msg, const bool flushNow = true, const int64_t wallNs = 0)
         {
+            std::lock_guard<std::mutex> lock(fileMutex);
             // 目录初始化
             if (CurCycleLogDirName_.empty())
             {
@@ -208,14 +469,182 @@ namespace beiklive
                 filelogger.initializeLogFile(logFilePath_ + CurCycleLogDirName_ + "/" + CurLogFile_);
             }
 
-            if (isFileSizeOverSize(logFilePath_ + CurCycleLogDirName_ + "/" + CurLogFile_))
+            if (filelogger.size() > MaxSingleLogFileSize_)
             {
+                uint64_t start = TscClock::now();
                 CurLogFile_ = generateLogFileName() + ".log";
                 std::cout << "Switch to new logfile : " << CurLogFile_ << std::endl;
                 filelogger.switchLogFile(logFilePath_ + CurCycleLogDirName_ + "/" + CurLogFile_);
+                metrics_.recordRotation(TscClock::now() - start);
+            }
+
+            filelogger.logMessage(msg, flushNow, wallNs);
+        }
+
+        //*SHARD **************************************************************
+        // 分片模式下每个线程写各自的日志文件，线程之间不共享锁或计数器；
+        // 异步 / 多进程模式下由后台线程按来源线程代写。行首时间戳固定为纳秒精度，log_merge 据此归并。
+        struct ShardFile
+        {
+            std::unique_ptr<FileLogger> file;
+            int                         pid = 0;
+        };
+
+        namespace
+        {
+            constexpr const char* SHARD_FILE_PREFIX = "shard_";   // shard_<pid>_<tid>_<创建时间>.log
+            std::atomic<bool> fileShard_{ false };
+            std::mutex        shardMutex_;      // 只保护后台代写的分片，调用线程自己的分片无需加锁
+            std::map<std::pair<int, int64_t>, ShardFile> shardFiles_;
+        }
+
+        ShardFile& localShard()
+        {
+            thread_local ShardFile shard;
+            return shard;
+        }
+
+        void openShardFile(ShardFile& shard, const int pid, const int64_t tid)
+        {
+            std::string path;
+            {
+                std::lock_guard<std::mutex> lock(fileMutex);
+                if (CurCycleLogDirName_.empty()) {
+                    createDirectory(logFilePath_);
+                    CurCycleLogDirName_ = generateLogFileName();
+                    endsWithSlash(logFilePath_);
+                    createDirectory(logFilePath_ + CurCycleLogDirName_);
+                }
+                path = logFilePath_ + CurCycleLogDirName_ + "/" + SHARD_FILE_PREFIX + std::to_string(pid) + "_" +
+                       std::to_string(tid) + "_" + generateLogFileName() + ".log";
+                if (!shard.file) {
+                    shard.file.reset(new FileLogger());
+                }
+                shard.file->configureLike(filelogger);
+            }
+            if (shard.file->isOpen()) {
+                std::cout << "Switch to new shard : " << path << std::endl;
+                shard.file->switchLogFile(path);
+            }
+            else {
+                std::cout << "New shard : " << path << std::endl;
+                shard.file->initializeLogFile(path);
+            }
+            shard.pid = pid;
+        }
+
+        // 轮转规则与 LogFileRotation 相同：超过单文件大小上限时换新文件
+        void writeShard(ShardFile& shard, const int pid, const int64_t tid, const std::string& msg,
+                        const bool flushNow, const int64_t wallNs)
+        {
+            if (!shard.file || !shard.file->isOpen()) {
+                openShardFile(shard, pid, tid);
+            }
+            else if (shard.file->size() > MaxSingleLogFileSize_) {
+                uint64_t start = TscClock::now();
+                openShardFile(shard, pid, tid);
+                metrics_.recordRotation(TscClock::now() - start);
+            }
+            shard.file->logMessage(msg, flushNow, wallNs);
+        }
+
+        // pid / tid 为记录的来源；在来源线程上调用时写本线程的分片，否则由后台代写
+        void LogShardWrite(const int pid, const int64_t tid, const std::string& msg, const bool flushNow,
+                           const int64_t wallNs)
+        {
+            if (pid == 0 && (tid == 0 || tid == spanThreadId())) {
+                ShardFile& shard = localShard();
+                const int self = currentProcessId();
+                if (shard.file && shard.pid != self) {
+                    // fork 出的子进程不碰父进程线程的文件，也不在析构时改写其索引
+                    shard.file.release();
+                }
+                writeShard(shard, self, tid ? tid : spanThreadId(), msg, flushNow, wallNs);
+                return;
+            }
+            std::lock_guard<std::mutex> lock(shardMutex_);
+            writeShard(shardFiles_[std::make_pair(pid, tid)], pid ? pid : currentProcessId(), tid, msg, flushNow,
+                       wallNs);
+        }
+
+        // 打开后新写出的文件日志按线程分片
+        void LogFileShardSet(const bool enable)
+        {
+            fileShard_.store(enable, std::memory_order_relaxed);
+        }
+
+        bool isFileSharded()
+        {
+            return fileShard_.load(std::memory_order_relaxed);
+        }
+
+        // 文件输出：开启分片时写入来源线程的分片，否则写入轮转文件
+        void fileWrite(const int pid, const int64_t tid, const std::string& line, const bool flushNow,
+                       const int64_t wallNs)
+        {
+            if (isFileSharded()) {
+                LogShardWrite(pid, tid, line, flushNow, wallNs);
+            }
+            else {
+                LogFileRotation(line, flushNow, wallNs);
+            }
+        }
+        //***************************************************************
+
+        void LogFileFlush()
+        {
+            {
+                std::lock_guard<std::mutex> lock(fileMutex);
+                filelogger.flush();
+            }
+            std::lock_guard<std::mutex> lock(shardMutex_);
+            for (auto& kv : shardFiles_) {
+                kv.second.file->flush();
+            }
+        }
+
+        // 已写出的日志文件（含分片）落盘
+        void LogFileSync()
+        {
+            {
+                std::lock_guard<std::mutex> lock(fileMutex);
+                filelogger.sync();
             }
+            std::lock_guard<std::mutex> lock(shardMutex_);
+            for (auto& kv : shardFiles_) {
+                kv.second.file->sync();
+            }
+        }
+
+        // 关闭当前日志文件并写出其时间索引，之后再有输出时新建文件；
+        // 其他线程自己的分片在线程退出时关闭
+        void LogFileClose()
+        {
+            {
+                std::lock_guard<std::mutex> lock(fileMutex);
+                filelogger.close();
+                CurLogFile_.clear();
+            }
+            ShardFile& local = localShard();
+            if (local.file && local.pid == currentProcessId()) {
+                local.file->close();
+            }
+            std::lock_guard<std::mutex> lock(shardMutex_);
+            shardFiles_.clear();
+        }
 
-            filelogger.logMessage(msg);
+        // 设置日志文件写入方式，DIRECT 适合与异步模式配合使用（同步模式下每条日志都会写出一个块）
+        void LogFileModeSet(const FILEMODE mode)
+        {
+            std::lock_guard<std::mutex> lock(fileMutex);
+            filelogger.setMode(mode);
+        }
+
+        // 轮转或关闭日志文件时写出时间索引（<文件名>.idx），按 intervalSeconds 秒分桶，供 log_query 按时间段定位
+        void LogFileIndexSet(const bool enable, const uint32_t intervalSeconds = 1)
+        {
+            std::lock_guard<std::mutex> lock(fileMutex);
+            filelogger.setIndex(enable, intervalSeconds);
         }
 
         void LogFileSizeSet(const long& maxSize = 1024 * 1024 * 10)
@@ -246,24 +675,55 @@ namespace beiklive
             loglevel_ = set;
         }
 
+        void LoggerAsyncStop();
+        void LoggerSharedStop();
+        void LoggerSocketStop();
+        void LoggerRecentStop();
+        void LoggerMetricsReportStop();
+        void LoggerTimerReportStop();
+
         void LoggerStop()
         {
-            std::lock_guard<std::mutex> lock(logMutex);
-            output_ = OUTPUT::NONE;
+            // 先停掉周期汇总，停止之后不再有新的输出
+            LoggerMetricsReportStop();
+            LoggerTimerReportStop();
+            LoggerRecentStop();
+            {
+                std::lock_guard<std::mutex> lock(logMutex);
+                output_ = OUTPUT::NONE;
+            }
+            // 已入队的记录带有入队时的输出目标，停止后台时会全部写出
+            LoggerAsyncStop();
+            LoggerSharedStop();
+            LoggerSocketStop();
+            LogFileSync();
+            LogFileClose();
+            traceWriter_.close();
+            std::cout.flush();
         }
 
+        // 保留最近记录时即使没有输出目标也要格式化
         bool isEnableOutput()
         {
-            return !(output_ == OUTPUT::NONE);
+            return !(output_ == OUTPUT::NONE) || recentLog_.enabled();
+        }
+
+        bool isConsoleOutput(const OUTPUT output) {
+            return (output == OUTPUT::CONSOLE || output == OUTPUT::ALL);
         }
 
         bool isConsoleOutput() {
-            return (output_ == OUTPUT::CONSOLE || output_ == OUTPUT::ALL);
+            return isConsoleOutput(output_);
+        }
+
+        bool isFileOutput(const OUTPUT output)
+        {
+            return (output == OUTPUT::FILE || output == OUTPUT::ALL);
         }
 
         bool isFileOutput()
         {
-            return (output_ == OUTPUT::FILE || output_ == OUTPUT::ALL);
+            return isFileOutput(output_);
         }
 
 #define COLOR(level, message) \
@@ -271,78 +731,306 @@ namespace beiklive
 
 #define GET_FUNCTION_NAME() (std::string(__PRETTY_FUNCTION__) + ":" + std::to_string(__LINE__))
 
+        int64_t currentTimeNs()
+        {
+            return std::chrono::duration_cast<std::chrono::nanoseconds>(
+                std::chrono::system_clock::now().time_since_epoch()
+            ).count();
+        }
+
+        // 纳秒时间戳格式化为 %Y-%m-%d %H:%M:%S.mmm（或 .uuuuuu / .nnnnnnnnn），
+        // 日期时间部分按线程缓存，同一秒内不再调用 localtime
+        std::string formatTimestamp(const int64_t nsSinceEpoch, const PRECISION precision = PRECISION::MILLI)
+        {
+            thread_local std::time_t cachedSecond = -1;
+            thread_local char cachedPrefix[32];
+
+            std::time_t currentTime = static_cast<std::time_t>(nsSinceEpoch / 1000000000);
+            int64_t nanosec = nsSinceEpoch % 1000000000;
+            if (currentTime != cachedSecond) {
+                std::tm tmNow;
+#ifdef _WIN32
+                localtime_s(&tmNow, &currentTime);
+#else
+                localtime_r(&currentTime, &tmNow);
+#endif
+                std::strftime(cachedPrefix, sizeof(cachedPrefix), "%Y-%m-%d %H:%M:%S.", &tmNow);
+                cachedSecond = currentTime;
+            }
+
+            int digits = 3;
+            int64_t fraction = nanosec / 1000000;
+            if (precision == PRECISION::MICRO) {
+                digits = 6;
+                fraction = nanosec / 1000;
+            }
+            else if (precision == PRECISION::NANO) {
+                digits = 9;
+                fraction = nanosec;
+            }
+            std::string timestamp(cachedPrefix);
+            char buf[16];
+            for (int i = digits - 1; i >= 0; --i) {
+                buf[i] = static_cast<char>('0' + fraction % 10);
+                fraction /= 10;
+            }
+            timestamp.append(buf, digits);
+            return timestamp;
+        }
+
         std::string getCurrentTimestamp()
         {
-            auto now = std::chrono::system_clock::now();
-            auto currentTime = std::chrono::system_clock::to_time_t(now);
-            auto millisec = std::chrono::duration_cast<std::chrono::milliseconds>(
-                now.time_since_epoch()
-            ).count() % 1000;
+            return formatTimestamp(currentTimeNs());
+        }
+
+        Timestamp stampNow()
+        {
+            if (clock_.load(std::memory_order_relaxed) == CLOCK::TSC) {
+                return Timestamp{ static_cast<int64_t>(TscClock::now()), CLOCK::TSC };
+            }
+            return Timestamp{ currentTimeNs(), CLOCK::SYSTEM };
+        }
 
-            std::tm tmNow = *std::localtime(&currentTime);
+        // TSC 时间戳在输出时换算为墙上时间，并按记录自身的 tick 每秒重新对齐一次锚点
+        int64_t toWallNs(const Timestamp& ts)
+        {
+            if (ts.clock == CLOCK::SYSTEM) {
+                return ts.value;
+            }
+            TscClock::maybeResync(static_cast<uint64_t>(ts.value));
+            return TscClock::toWallNs(static_cast<uint64_t>(ts.value));
+        }
 
-            std::stringstream timestamp;
-            timestamp << std::put_time(&tmNow, "%Y-%m-%d %H:%M:%S.") << std::setw(3) << std::setfill('0') << millisec;;
+        // TSC 模式下的 tick 不随系统时钟回拨，且取值只需一次 rdtsc
+        void LoggerClockSet(const CLOCK set)
+        {
+            if (set == CLOCK::TSC) {
+                TscClock::calibrate();
+            }
+            clock_.store(set);
+        }
 
-            return timestamp.str();
+        void LoggerTimestampPrecisionSet(const PRECISION set)
+        {
+            precision_.store(set);
         }
 
 
-        std::string format(const std::string& pattern)
+        std::string format(std::string_view pattern)
         {
-            return pattern;
+            return std::string(pattern);
         }
 
+        // 单次扫描 pattern，参数由 log_format.hh 中的 Formatter 直接写入结果
         template <typename T, typename... Args>
-        std::string format(const std::string& pattern, T first, Args &&...args)
+        std::string format(std::string_view pattern, const T& first, const Args&... args)
         {
-            std::stringstream ss;
-            size_t pos = pattern.find("{");
-            size_t pos2 = pattern.find("}", pos);
+            std::string out;
+            out.reserve(pattern.size() + 16 * (sizeof...(Args) + 1));
+            formatTo(out, pattern, first, args...);
+            return out;
+        }
 
-            if (pos != std::string::npos && pos2 != std::string::npos)
-            {
-                ss << pattern.substr(0, pos) << first << pattern.substr(pos2 + 1);
+        // 调用点带有编译期格式程序时直接执行，否则在运行时解析 pattern；没有参数时 pattern 原样输出
+        template <typename... Args>
+        std::string formatCallsite(const Callsite* callsite, std::string_view pattern, const Args&... args)
+        {
+            if constexpr (sizeof...(Args) > 0) {
+                if (callsite && callsite->format) {
+                    std::string out;
+                    out.reserve(pattern.size() + 16 * sizeof...(Args));
+                    formatProgram(out, *callsite->format, args...);
+                    return out;
+                }
+            }
+            return format(pattern, args...);
+        }
+
+        // 时间戳之后的来源前缀："[pid:N] [函数:行] [k=v] "
+        std::string recordWhere(const int pid, const Callsite* callsite, const ContextNode* context)
+        {
+            std::string where;
+            if (pid != 0) {
+                where = "[pid:" + std::to_string(pid) + "] ";
+            }
+            if (callsite) {
+                where += "[" + std::string(callsite->function) + ":" + std::to_string(callsite->line) + "] ";
+            }
+            if (context) {
+                where += "[";
+                where += context->text();
+                where += "] ";
             }
-            else
+            return where;
+        }
+
+        // 日志文件中的一行，stamp 为 "[时间] "
+        std::string fileLine(const LOGLEVEL level, const std::string& stamp, const std::string& where, const std::string& s)
+        {
+            std::stringstream sss;
+            sss << stamp;
+            switch (level)
             {
-                ss << pattern;
+            case LOGLEVEL::INFO:
+                sss << "[I]";
+                break;
+            case LOGLEVEL::WARNING:
+                sss << "[W]";
+                break;
+            case LOGLEVEL::ERROR:
+                sss << "[E]";
+                break;
+            case LOGLEVEL::DEBUG:
+                sss << "[D]";
+                break;
             }
+            sss << " ";
+            sss << where;
+            sss << s;
+            return sss.str();
+        }
 
-            return format(ss.str(), args...);
+        //*SOCKET ***************************************************************
+#ifdef __linux__
+        namespace
+        {
+            SocketSink socketSink_;
         }
 
-        template <typename T, typename K, typename... Args>
-        void MACRO_LOG_OUTPUT(const LOGLEVEL level, T first, K pattern, Args &&...args)
+        // 收集端在线时文件日志改发到套接字，返回 false 时照常写文件
+        bool socketWrite(const LOGLEVEL level, const int64_t wallNs, const int pid, const int64_t tid,
+                         const std::string& line, const bool flushNow)
         {
-            if (isEnableOutput())
-            {
-                if (loglevel_ >= level)
-                {
-                    std::stringstream ss;
-                    ss << "[";
-                    ss << first;
-                    ss << "] ";
-                    ss << pattern;
-                    LOG_OUTPUT(level, ss.str(), args...);
-                }
+            if (!socketSink_.running()) {
+                return false;
             }
+            SocketRecordMeta meta{ wallNs, tid, pid ? pid : currentProcessId(), static_cast<int32_t>(level) };
+            if (!socketSink_.write(meta, line, flushNow)) {
+                return false;
+            }
+            metrics_.countSink(SINK::SOCKET, lineBytes(line.size()));
+            return true;
         }
 
-        template <typename... Args>
-        void LOG_OUTPUT(const LOGLEVEL level, const std::string& pattern, Args &&...args)
+        // 把文件日志按批发往本机收集端（options.endpoint 为 unix:PATH 或 tcp:HOST:PORT）；
+        // 收集端未启动、断开或积压时记录写入日志文件，恢复后自动重连
+        bool LoggerSocketStart(const SocketOptions& options)
         {
-            std::string&& s = format(pattern, args...);
+            // 未能发出的记录与直接写文件时一样分片或轮转；本进程的记录按 pid 0 归入后台代写的分片
+            return socketSink_.start(options, [](const SocketRecordMeta& meta, const std::string& line, bool flushNow) {
+                const int pid = meta.pid == currentProcessId() ? 0 : meta.pid;
+                fileWrite(pid, meta.tid, line, flushNow, meta.wallNs);
+            });
+        }
 
+        // 发出已缓冲的记录后断开
+        void LoggerSocketStop()
+        {
+            socketSink_.stop();
+        }
 
-            std::stringstream ss;
-            ss << "[" << getCurrentTimestamp() << "]";
-            ss << " ";
-            if (isConsoleOutput()) {
-                std::stringstream sss;
-                sss << ss.str();
-                switch (level)
-                {
+        bool isSocketConnected()
+        {
+            return socketSink_.connected();
+        }
+
+        SocketStats LoggerSocketStats()
+        {
+            return socketSink_.stats();
+        }
+#else
+        bool socketWrite(const LOGLEVEL, const int64_t, const int, const int64_t, const std::string&, const bool)
+        {
+            return false;
+        }
+
+        void LoggerSocketStop() {}
+#endif
+        //***************************************************************
+
+        //*RECENT ***************************************************************
+#ifdef __linux__
+        namespace
+        {
+            RecentServer recentServer_;
+        }
+#endif
+
+        std::vector<std::string> LoggerRecentQuery(const RecentQuery& query)
+        {
+            return recentLog_.query(query);
+        }
+
+        // 查询端点的应答：匹配的行，每行以换行结尾；请求有误时为一行 "error: ..."
+        std::string recentRespond(std::string_view request)
+        {
+            RecentQuery query;
+            std::string error;
+            if (!RecentQuery::parse(request, systemNowNs(), &query, &error)) {
+                return "error: " + error + "\n";
+            }
+            std::string out;
+            for (const std::string& line : recentLog_.query(query)) {
+                out += line;
+                out += '\n';
+            }
+            return out;
+        }
+
+        // 在内存中保留最近约 bytes 字节的记录，与输出目标无关（OUTPUT::CONSOLE、NONE 时同样保留）；
+        // socketPath 非空时在该 Unix 套接字上按级别、时间段或子串查询。
+        // 可重复调用：容量不变时保留已有记录，同一路径不重启端点；端点启动失败时返回 false，保留原来的状态
+        bool LoggerRecentStart(const size_t bytes = 8 * 1024 * 1024, const std::string& socketPath = "")
+        {
+#ifdef __linux__
+            if (!socketPath.empty() && !recentServer_.start(socketPath, recentRespond)) {
+                return false;
+            }
+#endif
+            recentLog_.configure(bytes);
+            return true;
+        }
+
+        // 关闭查询端点并释放内存
+        void LoggerRecentStop()
+        {
+#ifdef __linux__
+            recentServer_.stop();
+#endif
+            recentLog_.configure(0);
+        }
+        //***************************************************************
+
+        // 渲染一条已格式化的记录并写入各输出端，同步路径与异步后台共用；pid 非 0 时标注来源进程，
+        // tid 为写日志的线程，只用于 trace 输出；context 为写日志时的诊断上下文
+        void writeRecord(const LOGLEVEL level, const Timestamp& timestamp, const Callsite* callsite,
+                         const std::string& s, const OUTPUT output, const bool flushNow, const int pid = 0,
+                         const int64_t tid = 0, const ContextNode* context = nullptr)
+        {
+            metrics_.countRecord(static_cast<size_t>(level), s.size());
+
+            const int64_t wallNs = toWallNs(timestamp);
+            if (traceWriter_.isOpen() && traceLogs_.load(std::memory_order_relaxed)) {
+                traceWriter_.instant(LEVEL_NAMES[static_cast<size_t>(level)], callsite ? callsite->function : nullptr,
+                                     callsite ? callsite->line : 0, wallNs, pid ? pid : currentProcessId(), tid, s,
+                                     context ? context->text() : std::string_view(), flushNow);
+            }
+            std::stringstream ss;
+            ss << "[" << formatTimestamp(wallNs, precision_.load(std::memory_order_relaxed)) << "]";
+            ss << " ";
+            const std::string where = recordWhere(pid, callsite, context);
+            // 各输出目标写出的字节数；最近记录环不是输出目标，只进入环的记录计为 0 字节
+            size_t emitted = 0;
+            std::string line;     // 日志文件中的一行，最近记录与文件输出共用
+            if (recentLog_.enabled()) {
+                line = fileLine(level, ss.str(), where, s);
+                recentLog_.append(wallNs, static_cast<int>(level), line);
+            }
+            if (isConsoleOutput(output)) {
+                std::stringstream sss;
+                sss << ss.str();
+                switch (level)
+                {
                 case LOGLEVEL::INFO:
                     sss << "[" << COLOR(ColorCode::INFO, "INFO") << "]";
                     break;
@@ -356,70 +1044,1441 @@ namespace beiklive
                     sss << "[" << COLOR(ColorCode::DEBUG, "DEBUG") << "]";
                     break;
                 }
-                sss << " ";
-                sss << s;
-                std::cout << sss.str() << std::endl;
+                sss << " ";
+                sss << where;
+                sss << s;
+                if (flushNow) {
+                    std::cout << sss.str() << std::endl;
+                }
+                else {
+                    std::cout << sss.str() << '\n';
+                }
+                const size_t bytes = lineBytes(sss.str().size());
+                metrics_.countSink(SINK::CONSOLE, bytes);
+                emitted += bytes;
+            }
+            if (isFileOutput(output))
+            {
+                // 分片文件的时间戳固定为纳秒精度，作为 log_merge 的归并键
+                if (isFileSharded()) {
+                    line = fileLine(level, "[" + formatTimestamp(wallNs, PRECISION::NANO) + "] ", where, s);
+                }
+                else if (line.empty()) {
+                    line = fileLine(level, ss.str(), where, s);
+                }
+                emitted += lineBytes(line.size());
+                // 收集端在线时交给套接字，否则写文件
+                if (!socketWrite(level, wallNs, pid, tid, line, flushNow)) {
+                    fileWrite(pid, tid, line, flushNow, wallNs);
+                }
+            }
+            countCallsite(callsite, emitted);
+        }
+
+        //*FILTER ***************************************************************
+        namespace
+        {
+            std::mutex filterMutex_;
+            std::shared_ptr<const LogFilter> filter_;
+            std::atomic<uint32_t> filterGeneration_{ 0 };
+            std::atomic<bool> filterActive_{ false };
+        }
+
+        // 本线程缓存的当前过滤器，只在版本变化时加锁重新获取
+        const LogFilter* localFilter(uint32_t* generation)
+        {
+            thread_local std::shared_ptr<const LogFilter> cached;
+            thread_local uint32_t seen = 0;
+            if (filterGeneration_.load(std::memory_order_acquire) != seen) {
+                std::lock_guard<std::mutex> lock(filterMutex_);
+                cached = filter_;
+                seen = filterGeneration_.load(std::memory_order_relaxed);
+            }
+            *generation = seen;
+            return cached.get();
+        }
+
+        // 调用点上的静态判定，按过滤器版本缓存在 Callsite 中，命中缓存时不加锁
+        FILTERMATCH callsiteFilter(const LOGLEVEL level, const Callsite& callsite)
+        {
+            uint32_t generation = 0;
+            const LogFilter* filter = localFilter(&generation);
+            if (!filter) {
+                return FILTERMATCH::YES;
+            }
+            const uint32_t tag = generation << 2;
+            uint32_t state = callsite.filterState.load(std::memory_order_relaxed);
+            if ((state & ~3u) == tag) {
+                return static_cast<FILTERMATCH>(state & 3u);
+            }
+            FILTERMATCH match = filter->matchStatic(static_cast<int>(level), functionName(callsite.function),
+                                                    callsite.file);
+            callsite.filterState.store(tag | static_cast<uint32_t>(match), std::memory_order_relaxed);
+            return match;
+        }
+
+        // 格式化后的完整判定：调用点已能确定时直接采用，否则再看消息与上下文字段
+        bool recordFilterPass(const LOGLEVEL level, const Callsite* callsite, std::string_view message,
+                              const ContextNode* context)
+        {
+            if (!filterActive_.load(std::memory_order_relaxed)) {
+                return true;
+            }
+            if (callsite) {
+                FILTERMATCH match = callsiteFilter(level, *callsite);
+                if (match != FILTERMATCH::MAYBE) {
+                    return match == FILTERMATCH::YES;
+                }
+            }
+            uint32_t generation = 0;
+            const LogFilter* filter = localFilter(&generation);
+            return !filter ||
+                   filter->match(static_cast<int>(level), callsite ? functionName(callsite->function) : "",
+                                 callsite ? callsite->file : "", message, context ? context->text() : "");
+        }
+
+        // 设置运行时过滤表达式（语法见 LogFilter），为空时取消过滤；表达式有误时返回 false 并保留原过滤器。
+        // 只依赖调用点的条件在调用点判定并缓存，被拒绝的记录不格式化也不入队；
+        // 涉及消息或字段的条件在后台（同步模式下在调用线程）格式化之后判定。
+        bool LoggerFilterSet(const std::string& expression)
+        {
+            std::shared_ptr<LogFilter> filter;
+            if (!expression.empty()) {
+                filter = std::make_shared<LogFilter>();
+                std::string error;
+                if (!filter->compile(expression, &error)) {
+                    std::cerr << "Invalid log filter: " << error << std::endl;
+                    return false;
+                }
+            }
+            std::lock_guard<std::mutex> lock(filterMutex_);
+            filter_ = filter;
+            // 版本占 30 位，跳过 0 以免与调用点的初始状态混淆
+            uint32_t generation = (filterGeneration_.load(std::memory_order_relaxed) + 1) & 0x3fffffffu;
+            filterGeneration_.store(generation ? generation : 1, std::memory_order_release);
+            filterActive_.store(static_cast<bool>(filter), std::memory_order_relaxed);
+            return true;
+        }
+        //***************************************************************
+
+        //*ASYNC ***************************************************************
+        // 异步模式下调用方只把参数按值拷贝进本线程的队列，格式化与 I/O 由后台线程完成。
+        // 字符串类参数拷贝内容，算术/指针/枚举/线程 ID 按位拷贝，其余类型在调用方先转成字符串。
+        template <typename T>
+        struct is_string_arg : std::integral_constant<bool,
+            std::is_same<T, char*>::value || std::is_same<T, const char*>::value ||
+            std::is_same<T, std::string>::value || std::is_same<T, std::string_view>::value> {};
+
+        template <typename T>
+        struct is_trivial_arg : std::integral_constant<bool,
+            !is_string_arg<T>::value && std::is_trivially_copyable<T>::value &&
+            (std::is_arithmetic<T>::value || std::is_enum<T>::value || std::is_pointer<T>::value ||
+             std::is_same<T, std::thread::id>::value)> {};
+
+        // 入队时使用的参数类型，char* 统一为 const char*
+        template <typename T>
+        using stored_arg_t = typename std::conditional<std::is_same<typename std::decay<T>::type, char*>::value,
+            const char*, typename std::decay<T>::type>::type;
+
+        template <typename T, typename Enable = void>
+        struct ArgCodec;
+
+        template <typename T>
+        struct ArgCodec<T, typename std::enable_if<is_trivial_arg<T>::value>::type>
+        {
+            using Decoded = T;
+            static size_t size(const T&) { return sizeof(T); }
+            static char* encode(char* p, const T& v) {
+                std::memcpy(p, &v, sizeof(T));
+                return p + sizeof(T);
+            }
+            static T decode(const char*& p) {
+                T v;
+                std::memcpy(static_cast<void*>(&v), p, sizeof(T));
+                p += sizeof(T);
+                return v;
+            }
+        };
+
+        template <typename T>
+        struct ArgCodec<T, typename std::enable_if<is_string_arg<T>::value>::type>
+        {
+            using Decoded = std::string_view;
+            static std::string_view view(const T& v) {
+                if constexpr (std::is_pointer<T>::value) {
+                    return v ? std::string_view(v) : std::string_view("(null)");
+                }
+                else {
+                    return std::string_view(v);
+                }
+            }
+            static size_t size(const T& v) { return sizeof(uint32_t) + view(v).size(); }
+            static char* encode(char* p, const T& v) {
+                std::string_view sv = view(v);
+                uint32_t len = static_cast<uint32_t>(sv.size());
+                std::memcpy(p, &len, sizeof(len));
+                std::memcpy(p + sizeof(len), sv.data(), sv.size());
+                return p + sizeof(len) + sv.size();
+            }
+            static std::string_view decode(const char*& p) {
+                uint32_t len;
+                std::memcpy(&len, p, sizeof(len));
+                std::string_view sv(p + sizeof(len), len);
+                p += sizeof(len) + len;
+                return sv;
+            }
+        };
+
+        // 十六进制转储拷贝原始字节，后台解码时直接引用队列中的数据
+        template <>
+        struct ArgCodec<HexDump>
+        {
+            using Decoded = HexDump;
+            static size_t size(const HexDump& v) { return sizeof(uint32_t) + sizeof(uint64_t) + v.size; }
+            static char* encode(char* p, const HexDump& v) {
+                std::memcpy(p, &v.size, sizeof(v.size));
+                std::memcpy(p + sizeof(v.size), &v.total, sizeof(v.total));
+                p += sizeof(v.size) + sizeof(v.total);
+                std::memcpy(p, v.data, v.size);
+                return p + v.size;
+            }
+            static HexDump decode(const char*& p) {
+                HexDump v;
+                std::memcpy(&v.size, p, sizeof(v.size));
+                std::memcpy(&v.total, p + sizeof(v.size), sizeof(v.total));
+                p += sizeof(v.size) + sizeof(v.total);
+                v.data = reinterpret_cast<const uint8_t*>(p);
+                p += v.size;
+                return v;
+            }
+        };
+
+        // 其余类型通过 operator<< 在调用方转为字符串
+        template <typename T>
+        decltype(auto) prepareArg(const T& v)
+        {
+            using D = typename std::decay<T>::type;
+            if constexpr (is_string_arg<D>::value || is_trivial_arg<D>::value || std::is_same<D, HexDump>::value) {
+                return (v);
+            }
+            else {
+                std::ostringstream ss;
+                ss << v;
+                return ss.str();
+            }
+        }
+
+        using DecodeFn = void (*)(const char* payload, const Callsite* callsite, std::string& out);
+
+        // 后台队列中的记录类型：LOG 为日志消息，SPAN 后接一个 SpanEvent
+        enum class RECORDKIND : uint8_t
+        {
+            LOG,
+            SPAN
+        };
+
+        struct RecordHeader
+        {
+            int64_t         timestamp;
+            const Callsite* callsite;
+            DecodeFn        decode;
+            const ContextNode* context;   // 仅异步队列中的记录持有，写出后释放
+            uint8_t         level;
+            uint8_t         output;
+            uint8_t         clock;
+            uint8_t         kind;       // RECORDKIND
+            int32_t         tid;        // 写日志的线程
+        };
+
+        template <typename... Ts>
+        void decodeRecord(const char* p, const Callsite* callsite, std::string& out)
+        {
+            std::string_view pattern = ArgCodec<std::string_view>::decode(p);
+            std::tuple<typename ArgCodec<Ts>::Decoded...> values{ ArgCodec<Ts>::decode(p)... };
+            (void)p;
+            out = std::apply([&](auto&... v) { return formatCallsite(callsite, pattern, v...); }, values);
+        }
+
+        namespace
+        {
+            CompletionQueue completions_;   // 先于后台构造，后于后台析构
+            AsyncBackend    asyncBackend_;
+        }
+
+        // 参数须已经过 prepareArg
+        template <typename... Args>
+        size_t encodedSize(std::string_view pattern, const Args&... args)
+        {
+            return sizeof(RecordHeader) + ArgCodec<std::string_view>::size(pattern) +
+                (size_t(0) + ... + ArgCodec<stored_arg_t<Args>>::size(args));
+        }
+
+        template <typename... Args>
+        void encodeRecord(char* p, const LOGLEVEL level, const OUTPUT output, const Timestamp& timestamp,
+                          const Callsite* callsite, std::string_view pattern, const Args&... args)
+        {
+            RecordHeader h;
+            h.timestamp = timestamp.value;
+            h.clock = static_cast<uint8_t>(timestamp.clock);
+            h.callsite = callsite;
+            h.decode = &decodeRecord<stored_arg_t<Args>...>;
+            h.level = static_cast<uint8_t>(level);
+            h.output = static_cast<uint8_t>(output);
+            h.kind = static_cast<uint8_t>(RECORDKIND::LOG);
+            h.tid = static_cast<int32_t>(spanThreadId());
+            h.context = nullptr;
+            std::memcpy(p, &h, sizeof(h));
+            p = ArgCodec<std::string_view>::encode(p + sizeof(h), pattern);
+            ((p = ArgCodec<stored_arg_t<Args>>::encode(p, args)), ...);
+        }
+
+        template <typename... Args>
+        PUSH_RESULT pushRecord(AsyncBackend& backend, const LOGLEVEL level, const OUTPUT output,
+                               const Timestamp& timestamp, const Callsite* callsite, std::string_view pattern,
+                               const Args&... args)
+        {
+            return backend.push(encodedSize(pattern, args...), [&](char* p) {
+                encodeRecord(p, level, output, timestamp, callsite, pattern, args...);
+                // 诊断上下文只传指针，引用计数保证后台写出前节点不被释放
+                if (const ContextNode* context = currentContext()) {
+                    context->retain();
+                    std::memcpy(p + offsetof(RecordHeader, context), &context, sizeof(context));
+                }
+            });
+        }
+
+        void handleSpan(const SpanEvent& e);
+
+        // 记录入队到被后台取出的时间
+        uint64_t queueDelayNs(const Timestamp& ts)
+        {
+            if (ts.clock == CLOCK::TSC) {
+                uint64_t now = TscClock::now();
+                uint64_t then = static_cast<uint64_t>(ts.value);
+                return now > then ? TscClock::toNanoseconds(now - then) : 0;
+            }
+            int64_t delay = currentTimeNs() - ts.value;
+            return delay > 0 ? static_cast<uint64_t>(delay) : 0;
+        }
+
+        void asyncHandleRecord(const char* payload, size_t)
+        {
+            RecordHeader h;
+            std::memcpy(&h, payload, sizeof(h));
+            if (h.kind == static_cast<uint8_t>(RECORDKIND::SPAN)) {
+                SpanEvent e;
+                std::memcpy(&e, payload + sizeof(h), sizeof(e));
+                handleSpan(e);
+                return;
+            }
+            metrics_.recordQueueLatency(queueDelayNs(Timestamp{ h.timestamp, static_cast<CLOCK>(h.clock) }));
+            std::string s;
+            h.decode(payload + sizeof(h), h.callsite, s);
+            if (recordFilterPass(static_cast<LOGLEVEL>(h.level), h.callsite, s, h.context)) {
+                writeRecord(static_cast<LOGLEVEL>(h.level), Timestamp{ h.timestamp, static_cast<CLOCK>(h.clock) },
+                            h.callsite, s, static_cast<OUTPUT>(h.output), false, 0, h.tid, h.context);
+            }
+            if (h.context) {
+                h.context->release();
+            }
+        }
+
+        void asyncIdle()
+        {
+            std::cout.flush();
+            LogFileFlush();
+            traceWriter_.flush();
+        }
+
+        // 有序模式下的归并键：记录时间戳换算成的墙上时间
+        int64_t asyncOrderKey(const char* payload)
+        {
+            int64_t timestamp;
+            uint8_t clock;
+            std::memcpy(&timestamp, payload + offsetof(RecordHeader, timestamp), sizeof(timestamp));
+            std::memcpy(&clock, payload + offsetof(RecordHeader, clock), sizeof(clock));
+            return toWallNs(Timestamp{ timestamp, static_cast<CLOCK>(clock) });
+        }
+
+        // 启动异步后台线程，可指定 CPU / NUMA 节点亲和性、nice 值与调度策略；
+        // options.orderWindow 非 0 时后台按时间戳跨线程归并后再写出
+        bool LoggerAsyncStart(const BackendOptions& options = BackendOptions())
+        {
+            return asyncBackend_.start(options, asyncHandleRecord, asyncIdle, asyncOrderKey);
+        }
+
+        // 停止后台线程，返回前写出所有已入队的记录
+        void LoggerAsyncStop()
+        {
+            asyncBackend_.stop();
+        }
+
+        bool isAsyncOutput()
+        {
+            return asyncBackend_.running();
+        }
+
+        // 运行时调整后台线程的放置与调度，如 sched.cpu = 3 或 sched.numaNode = 1
+        bool LoggerBackendSchedSet(const SchedOptions& sched)
+        {
+            return asyncBackend_.applySched(sched);
+        }
+
+        // 后台线程的 CPU 时间与 NOTIFY 方式下的睡眠 / 唤醒次数
+        BackendStats LoggerBackendStats()
+        {
+            return asyncBackend_.stats();
+        }
+        //***************************************************************
+
+
+        //*SPAN ***************************************************************
+        // LOG_SCOPE / LOG_SPAN 在作用域开始与结束时各取一次时间戳，结束时把 SpanEvent 按值放入本线程的
+        // 异步队列（约一次日志入队的开销），耗时由后台线程换算并按调用点汇总；未启用异步模式时在调用线程汇总。
+        namespace
+        {
+            SpanAggregator    spanAggregator_;
+            std::atomic<bool> spanEnabled_{ true };
+            std::atomic<bool> spanLog_{ false };
+            TimerRegistry     timerRegistry_;
+            std::atomic<bool> timersEnabled_{ false };
+        }
+
+        void handleSpan(const SpanEvent& e)
+        {
+            uint64_t ticks = e.end > e.start ? static_cast<uint64_t>(e.end - e.start) : 0;
+            uint64_t ns = static_cast<CLOCK>(e.clock) == CLOCK::TSC ? TscClock::toNanoseconds(ticks) : ticks;
+            spanAggregator_.add(e.site, ns, e.depth);
+            const bool flushNow = !asyncBackend_.running();
+            if (traceWriter_.isOpen()) {
+                traceWriter_.span(e.site->name, e.site->function, e.site->line,
+                                  toWallNs(Timestamp{ e.start, static_cast<CLOCK>(e.clock) }), ns,
+                                  currentProcessId(), e.tid, e.depth, flushNow);
+            }
+            if (spanLog_.load(std::memory_order_relaxed)) {
+                writeRecord(LOGLEVEL::DEBUG, Timestamp{ e.start, static_cast<CLOCK>(e.clock) }, nullptr,
+                            format("[span] {} depth={} tid={} {}ns", e.site->name, e.depth, e.tid, ns), output_,
+                            flushNow, 0, e.tid);
+            }
+        }
+
+        void emitSpan(const SpanEvent& e)
+        {
+            if (asyncBackend_.running()) {
+                PUSH_RESULT pushed = asyncBackend_.push(sizeof(RecordHeader) + sizeof(SpanEvent), [&](char* p) {
+                    RecordHeader h{};
+                    h.timestamp = e.start;
+                    h.clock = e.clock;
+                    h.kind = static_cast<uint8_t>(RECORDKIND::SPAN);
+                    std::memcpy(p, &h, sizeof(h));
+                    std::memcpy(p + sizeof(h), &e, sizeof(e));
+                });
+                if (pushed == PUSH_RESULT::OK) {
+                    return;
+                }
+                if (pushed == PUSH_RESULT::DROPPED) {
+                    metrics_.countDropped();
+                    return;
+                }
+            }
+            handleSpan(e);
+        }
+
+        class ScopedSpan {
+        public:
+            explicit ScopedSpan(const SpanSite& s) {
+                if (spanEnabled_.load(std::memory_order_relaxed)) {
+                    site = &s;
+                    depth = spanDepth()++;
+                    start = stampNow();
+                }
+            }
+
+            ~ScopedSpan() {
+                if (site) {
+                    const Timestamp end = stampNow();
+                    --spanDepth();
+                    if (timersEnabled_.load(std::memory_order_relaxed)) {
+                        uint64_t ticks = end.value > start.value ? static_cast<uint64_t>(end.value - start.value) : 0;
+                        timerRegistry_.record(*site, start.clock == CLOCK::TSC ? TscClock::toNanoseconds(ticks) : ticks);
+                    }
+                    emitSpan(SpanEvent{ site, start.value, end.value, spanThreadId(), depth,
+                                        static_cast<uint8_t>(start.clock) });
+                }
+            }
+
+            ScopedSpan(const ScopedSpan&) = delete;
+            ScopedSpan& operator=(const ScopedSpan&) = delete;
+
+        private:
+            const SpanSite* site = nullptr;
+            uint32_t        depth = 0;
+            Timestamp       start{};
+        };
+
+        // 关闭后 LOG_SCOPE / LOG_SPAN 只剩一次原子读取
+        void LoggerSpanSet(const bool enable)
+        {
+            spanEnabled_.store(enable);
+        }
+
+        // 每个 span 结束时另写一条 DEBUG 日志
+        void LoggerSpanLogSet(const bool enable)
+        {
+            spanLog_.store(enable);
+        }
+
+        // 按总耗时排序的各调用点汇总；异步模式下只包含后台线程已处理的 span
+        std::vector<SpanStats> LoggerSpanStats()
+        {
+            return spanAggregator_.snapshot();
+        }
+
+        void LoggerSpanReset()
+        {
+            spanAggregator_.reset();
+        }
+
+        // 按 span 名称在调用线程记录耗时直方图（每次多一次无争用的直方图记录），供周期汇总与百分位查询
+        void LoggerTimerSet(const bool enable)
+        {
+            timersEnabled_.store(enable);
+        }
+
+        // 各计时器启动以来的累计统计（count / min / p50 / p99 / p999 / max，单位 ns）
+        std::vector<TimerSummary> LoggerTimerSnapshot()
+        {
+            return timerRegistry_.totals();
+        }
+
+        void LoggerTimerReset()
+        {
+            timerRegistry_.reset();
+        }
+        //***************************************************************
+
+
+        //*TRACE ***************************************************************
+        // 把 span 与日志写成 Chrome trace-event JSON，可在 chrome://tracing 或 ui.perfetto.dev 中按线程查看时间线。
+        // 异步模式下由后台线程写出，空闲时刷新；includeLogs 为 false 时只写 span。
+        bool LoggerTraceStart(const std::string& path, const bool includeLogs = true)
+        {
+            traceLogs_.store(includeLogs);
+            if (!traceWriter_.open(path)) {
+                std::cerr << "Error opening trace file: " << path << std::endl;
+                return false;
+            }
+            return true;
+        }
+
+        // 写出结尾并关闭；异步模式下先停止后台线程可保证已入队的记录都进入 trace
+        void LoggerTraceStop()
+        {
+            traceWriter_.close();
+        }
+        //***************************************************************
+
+
+        //*HEXDUMP ***************************************************************
+        // LOG_HEXDUMP 在调用方只拷贝原始字节（超过上限的部分截断），偏移/十六进制/ASCII 的排版在输出时完成
+        namespace
+        {
+            std::atomic<size_t> hexDumpLimit_{ 4096 };
+        }
+
+        HexDump hexDumpArg(const void* data, const size_t size)
+        {
+            size_t limit = hexDumpLimit_.load(std::memory_order_relaxed);
+            size_t kept = size < limit ? size : limit;
+            return HexDump{ static_cast<const uint8_t*>(data), static_cast<uint32_t>(kept), static_cast<uint64_t>(size) };
+        }
+
+        // 单条 LOG_HEXDUMP 记录保留的最大字节数
+        void LoggerHexDumpLimitSet(const size_t bytes)
+        {
+            hexDumpLimit_.store(bytes < UINT32_MAX ? bytes : UINT32_MAX);
+        }
+        //***************************************************************
+
+
+        //*SHARED ***************************************************************
+        // 多进程模式：各进程把记录写入共享内存中的队列，由创建者进程的收集线程统一格式化并写文件。
+        // 与收集者来自同一映像（fork 出的子进程）时按异步模式的编码传递参数，否则在本进程格式化为文本。
+#ifdef __linux__
+        struct SharedRecordHeader
+        {
+            int32_t pid;
+            uint8_t binary;
+            uint8_t reserved[3];
+        };
+
+        namespace
+        {
+            SharedRing      sharedRing_;
+            int             sharedPid_ = 0;
+            std::once_flag  sharedAtFork_;
+        }
+
+        // 收集者与生产者比较映像标识，相同则记录中的指针可直接使用
+        uint64_t sharedImage()
+        {
+            return imageIdentity(reinterpret_cast<const void*>(&sharedPid_));
+        }
+
+        template <typename... Args>
+        PUSH_RESULT pushSharedRecord(const LOGLEVEL level, const OUTPUT output, const Timestamp& timestamp,
+                                     const Callsite* callsite, std::string_view pattern, const Args&... args)
+        {
+            SharedRecordHeader sh{ sharedPid_, 1, {} };
+            const ContextNode* context = currentContext();
+            if (sharedRing_.binaryCompatible() && !context) {
+                return sharedRing_.push(sizeof(sh) + encodedSize(pattern, args...), [&](char* p) {
+                    std::memcpy(p, &sh, sizeof(sh));
+                    encodeRecord(p + sizeof(sh), level, output, timestamp, callsite, pattern, args...);
+                });
+            }
+            // 收集者无法解码本进程的参数或读取本进程的上下文，调用点、上下文与消息先格式化为文本
+            sh.binary = 0;
+            std::string text;
+            if (callsite) {
+                text = "[" + std::string(callsite->function) + ":" + std::to_string(callsite->line) + "] ";
+            }
+            if (context) {
+                text += "[" + std::string(context->text()) + "] ";
+            }
+            text += formatCallsite(callsite, pattern, args...);
+            return sharedRing_.push(sizeof(sh) + encodedSize(text), [&](char* p) {
+                std::memcpy(p, &sh, sizeof(sh));
+                encodeRecord(p + sizeof(sh), level, output, timestamp, nullptr, text);
+            });
+        }
+
+        // 已按异步格式编码的记录（如飞行记录器的历史）
+        PUSH_RESULT pushSharedEncoded(const char* record, size_t bytes)
+        {
+            RecordHeader h;
+            std::memcpy(&h, record, sizeof(h));
+            if (!sharedRing_.binaryCompatible()) {
+                std::string text;
+                h.decode(record + sizeof(h), h.callsite, text);
+                return pushSharedRecord(static_cast<LOGLEVEL>(h.level), static_cast<OUTPUT>(h.output),
+                                        Timestamp{ h.timestamp, static_cast<CLOCK>(h.clock) }, h.callsite, text);
+            }
+            SharedRecordHeader sh{ sharedPid_, 1, {} };
+            return sharedRing_.push(sizeof(sh) + bytes, [&](char* p) {
+                std::memcpy(p, &sh, sizeof(sh));
+                std::memcpy(p + sizeof(sh), record, bytes);
+            });
+        }
+
+        void sharedHandleRecord(const char* payload, size_t)
+        {
+            SharedRecordHeader sh;
+            std::memcpy(&sh, payload, sizeof(sh));
+            payload += sizeof(sh);
+            RecordHeader h;
+            std::memcpy(&h, payload, sizeof(h));
+            std::string s;
+            if (sh.binary) {
+                h.decode(payload + sizeof(h), h.callsite, s);
+            }
+            else {
+                const char* p = payload + sizeof(h);
+                s = std::string(ArgCodec<std::string_view>::decode(p));
+                h.callsite = nullptr;
+            }
+            writeRecord(static_cast<LOGLEVEL>(h.level), Timestamp{ h.timestamp, static_cast<CLOCK>(h.clock) },
+                        h.callsite, s, static_cast<OUTPUT>(h.output), false, sh.pid, h.tid);
+        }
+
+        // fork 前按加锁顺序持有日志模块的全部数据锁：分片锁先于文件锁，其余都是叶子锁（持有期间不再取别的锁）。
+        // 各组件启停用的控制锁在 join 工作线程期间一直持有，而工作线程需要上面这些锁，故不在此列；
+        // 独立的 Logger 实例各有自己的锁，也不在此列
+        void sharedForkLock()
+        {
+            logMutex.lock();
+            filterMutex_.lock();
+            shardMutex_.lock();
+            fileMutex.lock();
+            recentLog_.lockForFork();
+            traceWriter_.lockForFork();
+            socketSink_.lockForFork();
+            spanAggregator_.lockForFork();
+            timerRegistry_.lockForFork();
+            asyncBackend_.lockForFork();
+            completions_.lockForFork();
+            TscClock::lockForFork();
+        }
+
+        void sharedForkUnlock()
+        {
+            TscClock::unlockAfterFork();
+            completions_.unlockAfterFork();
+            asyncBackend_.unlockAfterFork();
+            timerRegistry_.unlockAfterFork();
+            spanAggregator_.unlockAfterFork();
+            socketSink_.unlockAfterFork();
+            traceWriter_.unlockAfterFork();
+            recentLog_.unlockAfterFork();
+            fileMutex.unlock();
+            shardMutex_.unlock();
+            filterMutex_.unlock();
+            logMutex.unlock();
+        }
+
+        // 子进程不会继承被其他线程锁住的互斥量，可直接走同步写出路径；子进程只作为生产者
+        void sharedRegisterAtFork()
+        {
+            std::call_once(sharedAtFork_, []() {
+                pthread_atfork(sharedForkLock, sharedForkUnlock, []() {
+                    sharedForkUnlock();
+                    sharedPid_ = getpid();
+                    sharedRing_.afterForkChild();
+                    asyncBackend_.abandonAfterFork();
+                    traceWriter_.abandonAfterFork();
+                    socketSink_.abandonAfterFork();
+                    recentServer_.abandonAfterFork();
+                    completions_.abandonAfterFork();
+                });
+            });
+        }
+
+        // 创建共享队列并在本进程启动收集线程，之后 fork 出的子进程的日志都交给本进程输出
+        bool LoggerSharedStart(const SharedOptions& options = SharedOptions())
+        {
+            sharedRegisterAtFork();
+            sharedPid_ = getpid();
+            return sharedRing_.create(options, sharedImage(), sharedHandleRecord, asyncIdle);
+        }
+
+        // 无亲缘关系的进程按名称加入已创建的共享队列
+        bool LoggerSharedAttach(const std::string& name)
+        {
+            sharedRegisterAtFork();
+            sharedPid_ = getpid();
+            return sharedRing_.attach(name, sharedImage());
+        }
+
+        // 收集者写出所有已入队的记录后删除共享段；生产者解除映射
+        void LoggerSharedStop()
+        {
+            sharedRing_.stop();
+        }
+
+        // 当前进程的日志写入共享队列
+        bool isSharedOutput()
+        {
+            return sharedRing_.producing();
+        }
+#else
+        template <typename... Args>
+        PUSH_RESULT pushSharedRecord(const LOGLEVEL, const OUTPUT, const Timestamp&, const Callsite*,
+                                     std::string_view, const Args&...)
+        {
+            return PUSH_RESULT::REJECTED;
+        }
+
+        PUSH_RESULT pushSharedEncoded(const char*, size_t)
+        {
+            return PUSH_RESULT::REJECTED;
+        }
+
+        void LoggerSharedStop() {}
+
+        bool isSharedOutput()
+        {
+            return false;
+        }
+#endif
+        //***************************************************************
+
+
+        //*FLIGHT RECORDER ***************************************************************
+        // 每个线程在内存中保留最近 N 条任意级别的记录（即使被 loglevel_ 过滤），
+        // 记录 ERROR 或主动调用 LoggerFlightRecorderDump() 时把本线程的历史写入日志文件。
+        namespace
+        {
+            std::atomic<bool>       flightEnabled_{ false };
+            std::atomic<bool>       flightDumpOnError_{ true };
+            std::atomic<size_t>     flightRecords_{ 0 };
+            std::atomic<size_t>     flightSlotBytes_{ 256 };
+            std::atomic<uint64_t>   flightGeneration_{ 0 };
+        }
+
+        FlightRecorder& localFlightRecorder()
+        {
+            thread_local FlightRecorder recorder;
+            uint64_t generation = flightGeneration_.load(std::memory_order_acquire);
+            if (recorder.generation != generation) {
+                recorder.configure(flightRecords_.load(), flightSlotBytes_.load());
+                recorder.generation = generation;
+            }
+            return recorder;
+        }
+
+        // records 为每线程保留的记录数，0 表示关闭；slotBytes 为单条记录的最大编码长度
+        void LoggerFlightRecorderSet(const size_t records, const size_t slotBytes = 256, const bool dumpOnError = true)
+        {
+            flightRecords_.store(records);
+            flightSlotBytes_.store(slotBytes < 64 ? 64 : slotBytes);
+            flightDumpOnError_.store(dumpOnError);
+            flightGeneration_.fetch_add(1, std::memory_order_release);
+            flightEnabled_.store(records != 0);
+        }
+
+        template <typename... Args>
+        void flightRecordPrepared(const LOGLEVEL level, const Callsite* callsite, std::string_view pattern,
+                                  const Args&... args)
+        {
+            FlightRecorder& recorder = localFlightRecorder();
+            const Timestamp timestamp = stampNow();
+            size_t bytes = encodedSize(pattern, args...);
+            if (char* slot = recorder.acquire(bytes)) {
+                encodeRecord(slot, level, OUTPUT::FILE, timestamp, callsite, pattern, args...);
+                return;
+            }
+            // 超出槽位的记录先格式化再截断保存
+            std::string text = formatCallsite(callsite, pattern, args...);
+            size_t room = recorder.slotBytes() - encodedSize(std::string_view());
+            if (text.size() > room) {
+                text.resize(room);
+            }
+            if (char* slot = recorder.acquire(encodedSize(text))) {
+                encodeRecord(slot, level, OUTPUT::FILE, timestamp, callsite, text);
+            }
+        }
+
+        template <typename... Args>
+        void flightRecord(const LOGLEVEL level, const Callsite* callsite, std::string_view pattern, Args &&...args)
+        {
+            flightRecordPrepared(level, callsite, pattern, prepareArg(args)...);
+        }
+
+        // 同步路径直接写文件，异步模式下按原编码拷贝进后台队列
+        void flightEmit(const char* record, size_t bytes)
+        {
+            PUSH_RESULT pushed = PUSH_RESULT::REJECTED;
+            if (isSharedOutput()) {
+                pushed = pushSharedEncoded(record, bytes);
+            }
+            else if (asyncBackend_.running()) {
+                pushed = asyncBackend_.push(bytes, [&](char* p) { std::memcpy(p, record, bytes); });
+            }
+            if (pushed == PUSH_RESULT::REJECTED) {
+                asyncHandleRecord(record, bytes);
+            }
+            else if (pushed == PUSH_RESULT::DROPPED) {
+                metrics_.countDropped();
+            }
+        }
+
+        void flightEmitText(const std::string& text)
+        {
+            std::vector<char> record(encodedSize(text));
+            encodeRecord(record.data(), LOGLEVEL::ERROR, OUTPUT::FILE, stampNow(), nullptr, text);
+            flightEmit(record.data(), record.size());
+        }
+
+        // 把调用线程的历史记录写入日志文件并清空
+        void LoggerFlightRecorderDump()
+        {
+            if (!flightEnabled_.load(std::memory_order_relaxed)) {
+                return;
+            }
+            FlightRecorder& recorder = localFlightRecorder();
+            if (recorder.size() == 0) {
+                return;
+            }
+            flightEmitText("==== flight recorder: " + std::to_string(recorder.size()) +
+                           " records of thread " + std::to_string(currentThreadId()) + " ====");
+            recorder.forEach([](const char* record, size_t bytes) { flightEmit(record, bytes); });
+            flightEmitText("==== flight recorder end ====");
+            recorder.clear();
+            if (!asyncBackend_.running() && !isSharedOutput()) {
+                LogFileFlush();
+            }
+        }
+
+        template <typename K, typename... Args>
+        void flightObserve(const LOGLEVEL level, const Callsite* callsite, const K& pattern, Args &&...args)
+        {
+            if (!flightEnabled_.load(std::memory_order_relaxed)) {
+                return;
+            }
+            if (level == LOGLEVEL::ERROR && flightDumpOnError_.load(std::memory_order_relaxed)) {
+                LoggerFlightRecorderDump();
+                return;
+            }
+            flightRecord(level, callsite, std::string_view(pattern), args...);
+        }
+        //***************************************************************
+
+        template <typename T, typename K, typename... Args>
+        void MACRO_LOG_OUTPUT(const LOGLEVEL level, T first, K pattern, Args &&...args)
+        {
+            if (isEnableOutput())
+            {
+                if (loglevel_ >= level)
+                {
+                    std::stringstream ss;
+                    ss << "[";
+                    ss << first;
+                    ss << "] ";
+                    ss << pattern;
+                    LOG_OUTPUT(level, ss.str(), args...);
+                }
             }
-            if (isFileOutput())
+        }
+
+        template <typename K, typename... Args>
+        void MACRO_LOG_OUTPUT(const LOGLEVEL level, const Callsite& callsite, K pattern, Args &&...args)
+        {
+            flightObserve(level, &callsite, pattern, args...);
+            if (isEnableOutput())
             {
-                std::stringstream sss;
-                sss << ss.str();
-                switch (level)
+                if (loglevel_ >= level &&
+                    (!filterActive_.load(std::memory_order_relaxed) || callsiteFilter(level, callsite) != FILTERMATCH::NO))
                 {
-                case LOGLEVEL::INFO:
-                    sss << "[I]";
-                    break;
-                case LOGLEVEL::WARNING:
-                    sss << "[W]";
-                    break;
-                case LOGLEVEL::ERROR:
-                    sss << "[E]";
-                    break;
-                case LOGLEVEL::DEBUG:
-                    sss << "[D]";
-                    break;
+                    LOG_OUTPUT(level, &callsite, pattern, args...);
+                }
+            }
+        }
+
+        template <typename... Args>
+        void LOG_OUTPUT(const LOGLEVEL level, const Callsite* callsite, std::string_view pattern, Args &&...args)
+        {
+            bool sampled = metrics_.shouldSample();
+            uint64_t start = sampled ? TscClock::now() : 0;
+
+            const OUTPUT output = output_;
+            const Timestamp timestamp = stampNow();
+            PUSH_RESULT pushed = PUSH_RESULT::REJECTED;
+            if (isSharedOutput()) {
+                pushed = pushSharedRecord(level, output, timestamp, callsite, pattern, prepareArg(args)...);
+            }
+            else if (asyncBackend_.running()) {
+                pushed = pushRecord(asyncBackend_, level, output, timestamp, callsite, pattern, prepareArg(args)...);
+            }
+            if (pushed == PUSH_RESULT::REJECTED) {
+                std::string s = formatCallsite(callsite, pattern, args...);
+                if (recordFilterPass(level, callsite, s, currentContext())) {
+                    writeRecord(level, timestamp, callsite, s, output, true, 0, spanThreadId(), currentContext());
                 }
-                sss << " ";
-                sss << s;
-                LogFileRotation(sss.str());
             }
+            else if (pushed == PUSH_RESULT::DROPPED) {
+                metrics_.countDropped();
+            }
+
+            if (sampled) {
+                metrics_.recordCallerLatency(TscClock::now() - start);
+            }
+        }
+
+        template <typename... Args>
+        void LOG_OUTPUT(const LOGLEVEL level, std::string_view pattern, Args &&...args)
+        {
+            LOG_OUTPUT(level, nullptr, pattern, args...);
         }
 
         template <typename T, typename... Args>
         void info(T pattern, Args &&...args)
         {
+            flightObserve(LOGLEVEL::INFO, nullptr, pattern, args...);
             if (loglevel_ >= LOGLEVEL::INFO && isEnableOutput())
                 LOG_OUTPUT(LOGLEVEL::INFO, pattern, args...);
         }
         template <typename T, typename... Args>
         void warning(T pattern, Args &&...args)
         {
+            flightObserve(LOGLEVEL::WARNING, nullptr, pattern, args...);
             if (loglevel_ >= LOGLEVEL::WARNING && isEnableOutput())
                 LOG_OUTPUT(LOGLEVEL::WARNING, pattern, args...);
         }
         template <typename T, typename... Args>
         void error(T pattern, Args &&...args)
         {
+            flightObserve(LOGLEVEL::ERROR, nullptr, pattern, args...);
             if (loglevel_ >= LOGLEVEL::ERROR && isEnableOutput())
                 LOG_OUTPUT(LOGLEVEL::ERROR, pattern, args...);
         }
         template <typename T, typename... Args>
         void debug(T pattern, Args &&...args)
         {
+            flightObserve(LOGLEVEL::DEBUG, nullptr, pattern, args...);
             if (loglevel_ >= LOGLEVEL::DEBUG && isEnableOutput())
                 LOG_OUTPUT(LOGLEVEL::DEBUG, pattern, args...);
         }
 
+        //*FLUSH ***************************************************************
+        // backend 上请求之前已提交的记录写出后，在完成线程上执行 persist 并完成请求
+        FlushRequest requestFlush(AsyncBackend& backend, std::function<void()> persist)
+        {
+            auto state = std::make_shared<FlushState>();
+            backend.requestDrain([state, persist]() {
+                completions_.post([state, persist]() {
+                    persist();
+                    state->complete();
+                });
+            });
+            return FlushRequest(state);
+        }
+
+        // 调用前已输出的日志全部写到终端与文件（内核缓冲区）后完成；
+        // 可 wait(timeout)，C++20 下可 co_await LoggerDrain()
+        FlushRequest LoggerDrain()
+        {
+            return requestFlush(asyncBackend_, []() {
+                LogFileFlush();
+                std::cout.flush();
+            });
+        }
+
+        // 同 LoggerDrain，并对日志文件 fdatasync，完成时已落盘
+        FlushRequest LoggerFlush()
+        {
+            return requestFlush(asyncBackend_, []() {
+                LogFileSync();
+                std::cout.flush();
+            });
+        }
+
+        // 阻塞到落盘或超时，超时返回 false，用于退出路径
+        bool LoggerFlush(const std::chrono::milliseconds timeout)
+        {
+            return LoggerFlush().wait(timeout);
+        }
+        //***************************************************************
+
+        //*INSTANCE ***************************************************************
+        // 独立的日志实例：自己的目录、单文件大小上限、级别、刷新策略与异步队列，
+        // 与全局日志及其他实例不共享锁、文件或后台线程。只输出到文件。
+        // 指标（metrics_）与完成线程（completions_）是进程级的，所有实例与全局日志共用。
+        enum class FLUSHPOLICY
+        {
+            BATCH,     // 缓冲区满或后台空闲时刷新，吞吐最高
+            RECORD,    // 每条写出后 flush 到内核
+            DURABLE    // 每条写出后 fdatasync；同步模式下返回时已落盘
+        };
+
+        struct LoggerOptions
+        {
+            std::string    dir = "./log";
+            long long      maxFileSize = 1024 * 1024 * 10;
+            LOGLEVEL       level = LOGLEVEL::INFO;
+            FLUSHPOLICY    flush = FLUSHPOLICY::RECORD;
+            FILEMODE       fileMode = FILEMODE::BUFFERED;
+            PRECISION      precision = PRECISION::MILLI;
+            bool           async = false;      // true 时使用自己的后台线程与每线程队列
+            BackendOptions backend;
+        };
+
+        namespace
+        {
+            std::atomic<uint32_t> instanceCount_{ 0 };
+        }
+
+        // 一组按大小轮转的日志文件，规则与 LogFileRotation 相同：每次运行一个时间戳目录，超过上限换新文件。
+        // 文件名为 <pid>_<实例序号>_<创建时间>.log，目录相同的实例（包括其他进程中的）不会写到同一个文件
+        class RotatingFile {
+        public:
+            void configure(const std::string& directory, long long maxBytes, FILEMODE mode) {
+                std::lock_guard<std::mutex> lock(mutex);
+                dir = directory;
+                endsWithSlash(dir);
+                maxSize = maxBytes;
+                file.setMode(mode);
+            }
+
+            void write(const std::string& msg, bool flushNow, bool durable, int64_t wallNs) {
+                std::lock_guard<std::mutex> lock(mutex);
+                if (cycleDir.empty()) {
+                    createDirectory(dir);
+                    cycleDir = dir + generateLogFileName() + "/";
+                    createDirectory(cycleDir);
+                }
+                if (!file.isOpen()) {
+                    file.initializeLogFile(cycleDir + tag + generateLogFileName() + ".log");
+                }
+                else if (file.size() > maxSize) {
+                    uint64_t start = TscClock::now();
+                    file.switchLogFile(cycleDir + tag + generateLogFileName() + ".log");
+                    metrics_.recordRotation(TscClock::now() - start);
+                }
+                file.logMessage(msg, flushNow && !durable, wallNs);
+                if (durable) {
+                    file.sync();
+                }
+            }
+
+            void flush() {
+                std::lock_guard<std::mutex> lock(mutex);
+                file.flush();
+            }
+
+            void sync() {
+                std::lock_guard<std::mutex> lock(mutex);
+                file.sync();
+            }
+
+            void close() {
+                std::lock_guard<std::mutex> lock(mutex);
+                file.close();
+            }
+
+        private:
+            std::mutex  mutex;
+            std::string dir;
+            std::string cycleDir;
+            long long   maxSize = 0;
+            FileLogger  file;
+            const std::string tag = std::to_string(getpid()) + "_" + std::to_string(instanceCount_.fetch_add(1)) + "_";
+        };
+
+        class Logger {
+        public:
+            explicit Logger(const LoggerOptions& opt) : options(opt), level(opt.level) {
+                file.configure(options.dir, options.maxFileSize, options.fileMode);
+                if (options.async) {
+                    backend.start(options.backend, [this](const char* payload, size_t) { handleRecord(payload); },
+                                  [this]() { file.flush(); });
+                }
+            }
+
+            // 等待仍在执行的 flush / drain 完成，它们引用本实例的文件
+            ~Logger() {
+                stop();
+                completions_.barrier();
+            }
+
+            Logger(const Logger&) = delete;
+            Logger& operator=(const Logger&) = delete;
+
+            bool enabled(const LOGLEVEL l) const {
+                return level.load(std::memory_order_relaxed) >= l;
+            }
+
+            void levelSet(const LOGLEVEL l) {
+                level.store(l, std::memory_order_relaxed);
+            }
+
+            template <typename... Args>
+            void output(const LOGLEVEL l, const Callsite& callsite, std::string_view pattern, const Args&... args) {
+                if (!enabled(l)) {
+                    return;
+                }
+                const Timestamp timestamp = stampNow();
+                PUSH_RESULT pushed = PUSH_RESULT::REJECTED;
+                if (backend.running()) {
+                    pushed = pushRecord(backend, l, OUTPUT::FILE, timestamp, &callsite, pattern, prepareArg(args)...);
+                }
+                if (pushed == PUSH_RESULT::REJECTED) {
+                    write(l, timestamp, &callsite, formatCallsite(&callsite, pattern, args...), currentContext(), true);
+                }
+                else if (pushed == PUSH_RESULT::DROPPED) {
+                    metrics_.countDropped();
+                }
+            }
+
+            // 调用前输出的记录写到文件（内核缓冲区）后完成
+            FlushRequest drain() {
+                return requestFlush(backend, [this]() { file.flush(); });
+            }
+
+            // 调用前输出的记录落盘后完成
+            FlushRequest flush() {
+                return requestFlush(backend, [this]() { file.sync(); });
+            }
+
+            bool flush(const std::chrono::milliseconds timeout) {
+                return flush().wait(timeout);
+            }
+
+            // 写出已入队的记录后停止后台线程并关闭文件；之后的记录在调用线程同步写出
+            void stop() {
+                backend.stop();
+                file.close();
+            }
+
+        private:
+            void write(const LOGLEVEL l, const Timestamp& timestamp, const Callsite* callsite, const std::string& s,
+                       const ContextNode* context, const bool flushNow) {
+                metrics_.countRecord(static_cast<size_t>(l), s.size());
+                const int64_t wallNs = toWallNs(timestamp);
+                const std::string line = fileLine(l, "[" + formatTimestamp(wallNs, options.precision) + "] ",
+                                                  recordWhere(0, callsite, context), s);
+                countCallsite(callsite, lineBytes(line.size()));
+                file.write(line, flushNow && options.flush != FLUSHPOLICY::BATCH, options.flush == FLUSHPOLICY::DURABLE,
+                           wallNs);
+            }
+
+            void handleRecord(const char* payload) {
+                RecordHeader h;
+                std::memcpy(&h, payload, sizeof(h));
+                std::string s;
+                h.decode(payload + sizeof(h), h.callsite, s);
+                write(static_cast<LOGLEVEL>(h.level), Timestamp{ h.timestamp, static_cast<CLOCK>(h.clock) }, h.callsite,
+                      s, h.context, true);
+                if (h.context) {
+                    h.context->release();
+                }
+            }
+
+            const LoggerOptions   options;
+            std::atomic<LOGLEVEL> level;
+            RotatingFile          file;
+            AsyncBackend          backend;
+        };
+        //***************************************************************
+
+        //*METRICS ***************************************************************
+        // 队列深度取自全局异步后台各线程队列的计数，调用方不维护共享的深度计数器
+        MetricsSnapshot LoggerMetricsSnapshot()
+        {
+            MetricsSnapshot snap = metrics_.snapshot(TscClock::nsPerTick());
+            snap.queueDepth = static_cast<int64_t>(asyncBackend_.queuedRecords());
+            snap.queuePeak = std::max(static_cast<int64_t>(asyncBackend_.queuedPeak()), snap.queueDepth);
+            return snap;
+        }
+
+        void LoggerMetricsReset()
+        {
+            metrics_.reset();
+            asyncBackend_.resetQueuedPeak();
+        }
+
+        // 每个线程每 everyN 次调用采样一次调用耗时，0 表示关闭采样
+        void LoggerMetricsSampleSet(const uint32_t everyN)
+        {
+            metrics_.setSampleEvery(everyN);
+        }
+
+        // 以 INFO 级别写回日志本身
+        void LoggerMetricsDump()
+        {
+            info("[metrics] {}", LoggerMetricsSnapshot().toString());
+        }
+
+        // span 汇总以 INFO 级别写回日志本身
+        void LoggerSpanDump()
+        {
+            info("[spans]{}", spanAggregator_.report());
+        }
+
+        // 以 JSON 行追加到指定文件
+        bool LoggerMetricsDumpToFile(const std::string& filePath)
+        {
+            std::ofstream out(filePath, std::ios::app);
+            if (!out.is_open()) {
+                std::cerr << "Error opening metrics file: " << filePath << std::endl;
+                return false;
+            }
+            out << "{\"timestamp\":\"" << getCurrentTimestamp() << "\",\"metrics\":"
+                << LoggerMetricsSnapshot().toJson() << "}" << std::endl;
+            return true;
+        }
+
+        class PeriodicReporter {
+        public:
+            ~PeriodicReporter() { stop(); }
+
+            void start(std::chrono::milliseconds interval, std::function<void()> report) {
+                stop();
+                std::lock_guard<std::mutex> lock(mtx);
+                running = true;
+                worker = std::thread([this, interval, report]() { run(interval, report); });
+            }
+
+            void stop() {
+                {
+                    std::lock_guard<std::mutex> lock(mtx);
+                    running = false;
+                }
+                cv.notify_all();
+                if (worker.joinable()) {
+                    worker.join();
+                }
+            }
+
+        private:
+            void run(std::chrono::milliseconds interval, const std::function<void()> report) {
+                std::unique_lock<std::mutex> lock(mtx);
+                while (running) {
+                    if (cv.wait_for(lock, interval, [this]() { return !running; })) {
+                        break;
+                    }
+                    lock.unlock();
+                    report();
+                    lock.lock();
+                }
+            }
+
+            std::thread worker;
+            std::mutex mtx;
+            std::condition_variable cv;
+            bool running = false;
+        };
+
+        namespace
+        {
+            PeriodicReporter metricsReporter_;
+            PeriodicReporter timerReporter_;
+        }
+
+        // 周期性输出指标，filePath 为空时写回日志本身
+        void LoggerMetricsReportStart(const std::chrono::milliseconds interval, const std::string& filePath = "")
+        {
+            metricsReporter_.start(interval, [filePath]() {
+                if (filePath.empty()) {
+                    LoggerMetricsDump();
+                }
+                else {
+                    LoggerMetricsDumpToFile(filePath);
+                }
+            });
+        }
+
+        void LoggerMetricsReportStop()
+        {
+            metricsReporter_.stop();
+        }
+
+        // 以 INFO 级别为本周期内有记录的每个计时器写一条汇总，并把本周期计入累计统计
+        void LoggerTimerDump()
+        {
+            for (const TimerSummary& t : timerRegistry_.collect()) {
+                info("[timer] {} count={} p50={}ns p99={}ns max={}ns", t.name, t.ns.count, t.ns.p50, t.ns.p99,
+                     t.ns.max);
+            }
+        }
+
+        // 每隔 interval 输出一次各计时器的本周期汇总，同时打开计时器统计
+        void LoggerTimerReportStart(const std::chrono::milliseconds interval)
+        {
+            LoggerTimerSet(true);
+            timerReporter_.start(interval, []() { LoggerTimerDump(); });
+        }
+
+        void LoggerTimerReportStop()
+        {
+            timerReporter_.stop();
+        }
+
+        struct CallsiteVolume
+        {
+            const Callsite* callsite;
+            uint64_t        records;
+            uint64_t        bytes;
+        };
+
+        // 写出字节数最多的 n 个调用点（LOG_* 语句），按字节数降序；total 返回所有调用点的总字节数
+        std::vector<CallsiteVolume> LoggerTopCallsites(const size_t n, uint64_t* total = nullptr)
+        {
+            std::vector<CallsiteVolume> all;
+            uint64_t sum = 0;
+            for (const Callsite* c = hitCallsites_.load(std::memory_order_acquire); c; c = c->hitNext) {
+                CallsiteVolume v{ c, c->hitRecords.load(std::memory_order_relaxed),
+                                  c->hitBytes.load(std::memory_order_relaxed) };
+                sum += v.bytes;
+                if (v.records != 0) {
+                    all.push_back(v);
+                }
+            }
+            const size_t keep = std::min(n, all.size());
+            std::partial_sort(all.begin(), all.begin() + static_cast<std::ptrdiff_t>(keep), all.end(),
+                              [](const CallsiteVolume& a, const CallsiteVolume& b) { return a.bytes > b.bytes; });
+            all.resize(keep);
+            if (total) {
+                *total = sum;
+            }
+            return all;
+        }
+
+        // 以 INFO 级别写出字节数最多的 n 个调用点及其占比
+        void LoggerTopCallsitesDump(const size_t n = 10)
+        {
+            uint64_t total = 0;
+            for (const CallsiteVolume& v : LoggerTopCallsites(n, &total)) {
+                // 累计字节数可能很大，占比按浮点计算，避免整数放大后溢出
+                info("[top] {}:{} {} records={} bytes={} share={:.1f}%", v.callsite->file, v.callsite->line,
+                     functionName(v.callsite->function), v.records, v.bytes,
+                     total ? 100.0 * static_cast<double>(v.bytes) / static_cast<double>(total) : 0.0);
+            }
+        }
+
+        // 计数清零，调用点仍保留在链表中
+        void LoggerCallsiteStatsReset()
+        {
+            for (const Callsite* c = hitCallsites_.load(std::memory_order_acquire); c; c = c->hitNext) {
+                c->hitRecords.store(0, std::memory_order_relaxed);
+                c->hitBytes.store(0, std::memory_order_relaxed);
+            }
+        }
+        //***************************************************************
+
     } // namespace log
 #define LOG_INFO(...) LOGGER_INFO(__VA_ARGS__)
 #define LOG_WARNING(...) LOGGER_WARNING(__VA_ARGS__)
 #define LOG_ERROR(...) LOGGER_ERROR(__VA_ARGS__)
 #define LOG_DEBUG(...) LOGGER_DEBUG(__VA_ARGS__)
 
-#define LOGGER_INFO(...) MACRO_LOG_OUTPUT(beiklive::LOG::LOGLEVEL::INFO, GET_FUNCTION_NAME(), __VA_ARGS__)
-#define LOGGER_WARNING(...) MACRO_LOG_OUTPUT(beiklive::LOG::LOGLEVEL::WARNING, GET_FUNCTION_NAME(), __VA_ARGS__)
-#define LOGGER_ERROR(...) MACRO_LOG_OUTPUT(beiklive::LOG::LOGLEVEL::ERROR, GET_FUNCTION_NAME(), __VA_ARGS__)
-#define LOGGER_DEBUG(...) MACRO_LOG_OUTPUT(beiklive::LOG::LOGLEVEL::DEBUG, GET_FUNCTION_NAME(), __VA_ARGS__)
+#define LOGGER_INFO(...) LOG_CALLSITE_OUTPUT(beiklive::LOG::LOGLEVEL::INFO, __VA_ARGS__)
+#define LOGGER_WARNING(...) LOG_CALLSITE_OUTPUT(beiklive::LOG::LOGLEVEL::WARNING, __VA_ARGS__)
+#define LOGGER_ERROR(...) LOG_CALLSITE_OUTPUT(beiklive::LOG::LOGLEVEL::ERROR, __VA_ARGS__)
+#define LOGGER_DEBUG(...) LOG_CALLSITE_OUTPUT(beiklive::LOG::LOGLEVEL::DEBUG, __VA_ARGS__)
+
+#define LOG_CONCAT_IMPL_(a, b) a##b
+#define LOG_CONCAT_(a, b) LOG_CONCAT_IMPL_(a, b)
+
+// 记录从此处到所在作用域结束的耗时
+#define LOG_SCOPE(name) \
+    static const beiklive::LOG::SpanSite LOG_CONCAT_(logSpanSite_, __LINE__){ name, __PRETTY_FUNCTION__, __FILE__, __LINE__ }; \
+    beiklive::LOG::ScopedSpan LOG_CONCAT_(logSpan_, __LINE__)(LOG_CONCAT_(logSpanSite_, __LINE__))
+
+// 记录紧随其后的语句或代码块的耗时：LOG_SPAN("parse") { ... }
+#define LOG_SPAN(name) \
+    if (static const beiklive::LOG::SpanSite logSpanSite_{ name, __PRETTY_FUNCTION__, __FILE__, __LINE__ }; false) {} \
+    else if (beiklive::LOG::ScopedSpan logSpan_(logSpanSite_); false) {} \
+    else
+
+// 以 hexdump -C 的布局输出一段二进制数据：LOG_HEXDUMP(beiklive::LOG::LOGLEVEL::DEBUG, buf, len)
+#define LOG_HEXDUMP(level, data, size) LOG_CALLSITE_OUTPUT(level, "{}", beiklive::LOG::hexDumpArg(data, size))
+
+// 每个调用点一份静态描述，避免每条日志都拼接函数名与行号；
+// 字符串字面量格式串在编译期解析为 FormatProgram 并检查占位符，运行时不再解析说明符；
+// std::string、const char* 等运行时格式串没有编译期程序（format 为空），按原来的方式在运行时解析
+#define LOG_PATTERN_(pattern, ...) pattern
+#define LOG_LITERAL_PATTERN_(...) \
+    (__builtin_constant_p(beiklive::LOG::literalPattern(LOG_PATTERN_(__VA_ARGS__, ""))) \
+         ? beiklive::LOG::literalPattern(LOG_PATTERN_(__VA_ARGS__, "")) \
+         : nullptr)
+#define LOG_CALLSITE_DEFINE_(...) \
+    static constexpr const char* logLiteral_ = LOG_LITERAL_PATTERN_(__VA_ARGS__); \
+    static_assert(decltype(beiklive::LOG::patternArgCount(__VA_ARGS__))::value == 0 || \
+                      beiklive::LOG::checkFormat(logLiteral_), \
+                  "log pattern fields must be {} or {:spec}; names, indexes and malformed specs are not supported"); \
+    static constexpr auto logSteps_ = \
+        beiklive::LOG::compileFormat<beiklive::LOG::countFormatSteps(logLiteral_)>(logLiteral_); \
+    static constexpr beiklive::LOG::FormatProgram logFormat_{ logLiteral_, logSteps_.steps, logSteps_.count }; \
+    static const beiklive::LOG::Callsite logCallsite_{ __PRETTY_FUNCTION__, __FILE__, __LINE__, \
+                                                       logLiteral_ ? &logFormat_ : nullptr }
+#define LOG_CALLSITE_OUTPUT(level, ...) \
+    do { \
+        LOG_CALLSITE_DEFINE_(__VA_ARGS__); \
+        MACRO_LOG_OUTPUT(level, logCallsite_, __VA_ARGS__); \
+    } while (0)
+
+// 写入独立的日志实例：LOG_INFO_TO(accessLog, "GET {} {}", path, status)
+#define LOG_CALLSITE_TO(logger, level, ...) \
+    do { \
+        if ((logger).enabled(level)) { \
+            LOG_CALLSITE_DEFINE_(__VA_ARGS__); \
+            (logger).output(level, logCallsite_, __VA_ARGS__); \
+        } \
+    } while (0)
+#define LOG_INFO_TO(logger, ...) LOG_CALLSITE_TO(logger, beiklive::LOG::LOGLEVEL::INFO, __VA_ARGS__)
+#define LOG_WARNING_TO(logger, ...) LOG_CALLSITE_TO(logger, beiklive::LOG::LOGLEVEL::WARNING, __VA_ARGS__)
+#define LOG_ERROR_TO(logger, ...) LOG_CALLSITE_TO(logger, beiklive::LOG::LOGLEVEL::ERROR, __VA_ARGS__)
+#define LOG_DEBUG_TO(logger, ...) LOG_CALLSITE_TO(logger, beiklive::LOG::LOGLEVEL::DEBUG, __VA_ARGS__)
 
 } // namespace beiklive
 
@@ -0,0 +1,610 @@
+// Copyright (c) RealCoolEngineer. 2024. All rights reserved.
+// Author: beiklive
+// Date: 2024-04-15
+#ifndef INC_LOG_BACKEND_HH_
+#define INC_LOG_BACKEND_HH_
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <functional>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <utility>
+#include <vector>
+#include "log_ring.hh"
+#include "log_sched.hh"
+#include "log_wake.hh"
+#ifdef __linux__
+#include <ctime>
+#include <pthread.h>
+#endif
+
+namespace beiklive
+{
+    namespace LOG
+    {
+        struct BackendOptions
+        {
+            size_t ringCapacity = 1 << 20;      // 每个生产者线程的环形队列字节数，须为 2 的幂
+            bool   blockWhenFull = true;         // 队列满时等待，false 则丢弃并计数
+            bool   numaLocalRings = true;        // 队列内存分配在生产者所在的 NUMA 节点
+            size_t batchSize = 256;              // 每轮从单个队列取出的最大记录数
+            std::chrono::microseconds idleSleep{ 100 };   // POLL：空闲时的轮询间隔
+            WAKEMODE wake = WAKEMODE::POLL;      // 后台得知有新记录的方式
+            uint32_t wakeBatch = 32;             // NOTIFY：后台睡眠后累计多少条记录才唤醒
+            std::chrono::microseconds wakeTimeout{ 1000 };   // NOTIFY：最长睡眠时间，即不足一批时的延迟上限
+            std::chrono::microseconds orderWindow{ 0 };   // 非 0 时按时间戳跨线程归并，记录至少延迟这么久写出
+            SchedOptions sched;                  // 后台线程的亲和性 / nice / 调度策略
+        };
+
+        // 后台线程的运行统计，用于比较不同唤醒方式的 CPU 占用
+        struct BackendStats
+        {
+            uint64_t cpuNs = 0;      // 后台线程消耗的 CPU 时间（本次或最近一次运行）
+            uint64_t sleeps = 0;     // NOTIFY：进入睡眠的次数
+            uint64_t wakeups = 0;    // NOTIFY：生产者发起的唤醒次数（系统调用次数）
+        };
+
+        enum class PUSH_RESULT
+        {
+            OK,
+            REJECTED,   // 后台未运行或记录过大，调用方应走同步路径
+            DROPPED     // 队列已满且不等待
+        };
+
+        // 单个生产者线程持有的队列；内存分配失败时 memory 为空，该线程的记录走同步路径
+        struct ThreadRing
+        {
+            ThreadRing(size_t capacity, bool numaLocal)
+                : numaNode(numaLocal ? currentNumaNode() : -1),
+                  tid(currentThreadId()),
+                  bytes(capacity),
+                  memory(static_cast<char*>(numaAlloc(capacity, numaNode))),
+                  ring(memory, capacity) {}
+
+            ~ThreadRing() { numaFree(memory, bytes); }
+
+            const int    numaNode;
+            const long   tid;
+            const size_t bytes;
+            char* const  memory;
+            SpscRing     ring;
+            std::atomic<bool> pushing{ false };
+            std::atomic<bool> retired{ false };
+            std::atomic<uint64_t> pushedRecords{ 0 };               // 只由生产者写
+            alignas(64) std::atomic<uint64_t> poppedRecords{ 0 };   // 只由后台写
+
+            // 已提交未写出的记录数；先读消费计数，结果不会为负
+            uint64_t queued() const {
+                uint64_t popped = poppedRecords.load(std::memory_order_acquire);
+                return pushedRecords.load(std::memory_order_acquire) - popped;
+            }
+        };
+
+        // 异步后台：生产者写入各自线程的 SPSC 队列，后台线程统一取出并交给 handler 输出
+        class AsyncBackend {
+        public:
+            using RecordHandler = std::function<void(const char* payload, size_t bytes)>;
+            using IdleHandler = std::function<void()>;
+            // 记录的时间戳（Unix 纪元纳秒），用于按时间顺序归并
+            using OrderKey = int64_t (*)(const char* payload);
+
+            AsyncBackend() : id(nextId()) {}
+            ~AsyncBackend() { stop(); }
+
+            AsyncBackend(const AsyncBackend&) = delete;
+            AsyncBackend& operator=(const AsyncBackend&) = delete;
+
+            bool start(const BackendOptions& opt, RecordHandler onRecord, IdleHandler onIdle, OrderKey key = nullptr) {
+                std::lock_guard<std::mutex> lock(controlMutex);
+                if (worker.joinable()) {
+                    return false;
+                }
+                if (opt.ringCapacity < 4096 || (opt.ringCapacity & (opt.ringCapacity - 1)) != 0) {
+                    std::cerr << "Invalid ring capacity: " << opt.ringCapacity << std::endl;
+                    return false;
+                }
+                options = opt;
+                options.wakeBatch = std::max<uint32_t>(options.wakeBatch, 1);
+                signal.resetCounts();
+                handler = std::move(onRecord);
+                idleHandler = std::move(onIdle);
+                orderKey = options.orderWindow.count() > 0 ? key : nullptr;
+                workerActive.store(true, std::memory_order_seq_cst);
+                accepting.store(true, std::memory_order_seq_cst);
+                worker = std::thread([this]() { run(); });
+                return true;
+            }
+
+            // 停止接收新记录，排空所有队列后返回
+            void stop() {
+                std::lock_guard<std::mutex> lock(controlMutex);
+                accepting.store(false, std::memory_order_seq_cst);
+                signal.notify();
+                if (worker.joinable()) {
+                    worker.join();
+                }
+            }
+
+            bool running() const {
+                return accepting.load(std::memory_order_relaxed);
+            }
+
+            // 运行时调整后台线程的放置与调度
+            bool applySched(const SchedOptions& sched) {
+                std::lock_guard<std::mutex> lock(controlMutex);
+                if (!worker.joinable()) {
+                    options.sched = sched;
+                    return true;
+                }
+#ifdef __linux__
+                std::string errors = applySchedOptions(worker.native_handle(), workerTid.load(), sched);
+                if (!errors.empty()) {
+                    std::cerr << "Backend sched failed: " << errors << std::endl;
+                    return false;
+                }
+                options.sched = sched;
+                return true;
+#else
+                return false;
+#endif
+            }
+
+            // fork 出的子进程中后台线程并不存在：停止接收，并放弃线程对象以免析构时 join
+            void abandonAfterFork() {
+                accepting.store(false, std::memory_order_seq_cst);
+                workerActive.store(false, std::memory_order_seq_cst);
+                abandonThreadAfterFork(worker);
+            }
+
+            // fork 前持有队列登记与 drain 请求的锁，子进程不会继承被其他线程持有的锁
+            void lockForFork() {
+                registryMutex.lock();
+                drainMutex.lock();
+            }
+
+            void unlockAfterFork() {
+                drainMutex.unlock();
+                registryMutex.unlock();
+            }
+
+            // 生产者：encode(char*) 向预留的 bytes 字节写入记录
+            template <typename Encoder>
+            PUSH_RESULT push(size_t bytes, Encoder&& encode) {
+                if (!accepting.load(std::memory_order_acquire)) {
+                    return PUSH_RESULT::REJECTED;
+                }
+                ThreadRing* r = localRing();
+                r->pushing.store(true, std::memory_order_seq_cst);
+                if (!accepting.load(std::memory_order_seq_cst) || !r->memory || bytes > r->ring.maxPayload()) {
+                    r->pushing.store(false, std::memory_order_release);
+                    return PUSH_RESULT::REJECTED;
+                }
+                char* p = r->ring.reserve(bytes);
+                while (!p) {
+                    if (!options.blockWhenFull) {
+                        r->pushing.store(false, std::memory_order_release);
+                        return PUSH_RESULT::DROPPED;
+                    }
+                    signal.notify();
+                    std::this_thread::yield();
+                    p = r->ring.reserve(bytes);
+                }
+                encode(p);
+                // 计数先于发布，后台取出时计数已包含这条记录
+                r->pushedRecords.store(r->pushedRecords.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+                r->ring.commit();
+                // 后台醒着时这里只是一次读；睡眠时累计到 wakeBatch 条或本队列过半才唤醒
+                if (options.wake == WAKEMODE::NOTIFY && signal.asleep()) {
+                    if (r->ring.usedBytes() >= r->bytes / 2) {
+                        signal.notify();
+                    }
+                    else {
+                        signal.arrive(options.wakeBatch);
+                    }
+                }
+                r->pushing.store(false, std::memory_order_release);
+                return PUSH_RESULT::OK;
+            }
+
+            // 请求时各队列已提交的记录全部交给 handler 后，在后台线程上调用 done；
+            // 后台未运行时直接在调用线程上调用。正在写入、尚未提交的记录不在此列
+            void requestDrain(std::function<void()> done) {
+                DrainRequest request;
+                request.done = std::move(done);
+                {
+                    std::lock_guard<std::mutex> lock(registryMutex);
+                    for (auto& r : registry) {
+                        uint64_t target = r->ring.producedPosition();
+                        if (r->ring.consumedPosition() < target) {
+                            request.targets.emplace_back(r, target);
+                        }
+                    }
+                }
+                {
+                    std::lock_guard<std::mutex> lock(drainMutex);
+                    if (workerActive.load(std::memory_order_seq_cst)) {
+                        drainRequests.push_back(std::move(request));
+                        drainPending.store(true, std::memory_order_seq_cst);
+                        request.done = nullptr;
+                    }
+                }
+                if (request.done) {
+                    request.done();
+                    return;
+                }
+                signal.notify();
+            }
+
+            BackendStats stats() {
+                BackendStats s;
+                s.cpuNs = lastCpuNs.load(std::memory_order_relaxed);
+#ifdef __linux__
+                std::lock_guard<std::mutex> lock(controlMutex);
+                clockid_t cid;
+                struct timespec ts;
+                if (worker.joinable() && pthread_getcpuclockid(worker.native_handle(), &cid) == 0 &&
+                    clock_gettime(cid, &ts) == 0) {
+                    s.cpuNs = static_cast<uint64_t>(ts.tv_sec) * 1000000000ull + static_cast<uint64_t>(ts.tv_nsec);
+                }
+#endif
+                s.sleeps = signal.sleepCount();
+                s.wakeups = signal.wakeupCount();
+                return s;
+            }
+
+            // 各队列中已提交、尚未交给 handler 的记录数，由各队列自己的生产 / 消费计数相减得到，
+            // 写入路径上没有跨线程共享的计数器
+            uint64_t queuedRecords() {
+                std::lock_guard<std::mutex> lock(registryMutex);
+                uint64_t n = 0;
+                for (auto& r : registry) {
+                    n += r->queued();
+                }
+                return n;
+            }
+
+            // 后台每轮取记录前观察到的最大积压
+            uint64_t queuedPeak() const {
+                return peakQueued.load(std::memory_order_relaxed);
+            }
+
+            void resetQueuedPeak() {
+                peakQueued.store(0, std::memory_order_relaxed);
+            }
+
+            // 当前注册的生产者队列数量
+            size_t producerCount() {
+                std::lock_guard<std::mutex> lock(registryMutex);
+                return registry.size();
+            }
+
+        private:
+            struct DrainRequest
+            {
+                std::vector<std::pair<std::shared_ptr<ThreadRing>, uint64_t>> targets;   // 队列及需要消费到的位置
+                std::function<void()> done;
+            };
+
+            // 有序模式下某个队列的队首
+            struct Head
+            {
+                int64_t key;
+                size_t  ring;
+                bool operator<(const Head& o) const { return key > o.key; }   // std 堆为大顶堆，取反得到最早的在堆顶
+            };
+
+            struct RingCache
+            {
+                std::vector<std::pair<uint64_t, std::shared_ptr<ThreadRing>>> entries;
+                uint64_t    lastId = 0;
+                ThreadRing* last = nullptr;
+
+                ~RingCache() {
+                    for (auto& e : entries) {
+                        e.second->retired.store(true, std::memory_order_release);
+                    }
+                }
+            };
+
+            static uint64_t nextId() {
+                static std::atomic<uint64_t> counter{ 0 };
+                return ++counter;
+            }
+
+            ThreadRing* localRing() {
+                thread_local RingCache cache;
+                if (cache.lastId == id) {
+                    return cache.last;
+                }
+                for (auto& e : cache.entries) {
+                    if (e.first == id) {
+                        cache.lastId = id;
+                        cache.last = e.second.get();
+                        return cache.last;
+                    }
+                }
+                auto ring = std::make_shared<ThreadRing>(options.ringCapacity, options.numaLocalRings);
+                {
+                    std::lock_guard<std::mutex> lock(registryMutex);
+                    registry.push_back(ring);
+                    registryVersion.fetch_add(1, std::memory_order_seq_cst);
+                }
+                cache.entries.emplace_back(id, ring);
+                cache.lastId = id;
+                cache.last = ring.get();
+                return cache.last;
+            }
+
+            void refreshRings() {
+                uint64_t version = registryVersion.load(std::memory_order_seq_cst);
+                if (version == seenVersion) {
+                    return;
+                }
+                std::lock_guard<std::mutex> lock(registryMutex);
+                rings = registry;
+                seenVersion = registryVersion.load(std::memory_order_relaxed);
+            }
+
+            // 回收线程已退出且已排空的队列
+            void reapRetired() {
+                std::lock_guard<std::mutex> lock(registryMutex);
+                size_t before = registry.size();
+                for (size_t i = 0; i < registry.size();) {
+                    ThreadRing& r = *registry[i];
+                    if (r.retired.load(std::memory_order_acquire) && r.ring.empty()) {
+                        registry[i] = registry.back();
+                        registry.pop_back();
+                    }
+                    else {
+                        ++i;
+                    }
+                }
+                if (registry.size() != before) {
+                    registryVersion.fetch_add(1, std::memory_order_release);
+                }
+            }
+
+            void popRecord(ThreadRing& r) {
+                r.ring.pop();
+                r.poppedRecords.store(r.poppedRecords.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+            }
+
+            void observeQueued() {
+                uint64_t n = 0;
+                for (auto& r : rings) {
+                    n += r->queued();
+                }
+                if (n > peakQueued.load(std::memory_order_relaxed)) {
+                    peakQueued.store(n, std::memory_order_relaxed);
+                }
+            }
+
+            size_t drainOnce() {
+                size_t total = 0;
+                for (auto& r : rings) {
+                    size_t n = 0;
+                    size_t bytes = 0;
+                    while (n < options.batchSize) {
+                        const char* p = r->ring.front(&bytes);
+                        if (!p) {
+                            break;
+                        }
+                        handler(p, bytes);
+                        popRecord(*r);
+                        ++n;
+                    }
+                    total += n;
+                }
+                return total;
+            }
+
+            // 有序模式：各队列的队首放入最小堆，只写出早于 now - orderWindow 的记录。
+            // 生产者从取时间戳到提交的间隔小于窗口时，输出严格按时间排序；
+            // 停止时、某个队列过半时，以及时间戳超前 now + orderWindow（系统时钟回拨）时不再等待。
+            size_t drainOrdered() {
+                heads.clear();
+                bool urgent = !accepting.load(std::memory_order_seq_cst);
+                for (size_t i = 0; i < rings.size(); ++i) {
+                    ThreadRing& r = *rings[i];
+                    if (const char* p = r.ring.front()) {
+                        heads.push_back(Head{ orderKey(p), i });
+                        urgent = urgent || r.ring.usedBytes() >= r.bytes / 2;
+                    }
+                }
+                std::make_heap(heads.begin(), heads.end());
+                const int64_t now = std::chrono::duration_cast<std::chrono::nanoseconds>(
+                    std::chrono::system_clock::now().time_since_epoch()).count();
+                const int64_t window = std::chrono::duration_cast<std::chrono::nanoseconds>(options.orderWindow).count();
+                const size_t limit = options.batchSize * std::max<size_t>(rings.size(), 1);
+                size_t n = 0;
+                heldUntil = 0;
+                while (!heads.empty() && n < limit) {
+                    const Head head = heads.front();
+                    if (!urgent && head.key > now - window && head.key <= now + window) {
+                        heldUntil = head.key + window;
+                        break;
+                    }
+                    std::pop_heap(heads.begin(), heads.end());
+                    heads.pop_back();
+                    SpscRing& ring = rings[head.ring]->ring;
+                    size_t bytes = 0;
+                    handler(ring.front(&bytes), bytes);
+                    popRecord(*rings[head.ring]);
+                    ++n;
+                    if (const char* p = ring.front()) {
+                        heads.push_back(Head{ orderKey(p), head.ring });
+                        std::push_heap(heads.begin(), heads.end());
+                    }
+                }
+                return n;
+            }
+
+            // 完成已满足的 drain 请求；finishing 时后台即将退出，队列均已排空
+            void serviceDrains(bool finishing) {
+                std::vector<std::function<void()>> ready;
+                {
+                    std::lock_guard<std::mutex> lock(drainMutex);
+                    if (finishing) {
+                        workerActive.store(false, std::memory_order_seq_cst);
+                    }
+                    for (size_t i = 0; i < drainRequests.size();) {
+                        DrainRequest& request = drainRequests[i];
+                        bool satisfied = finishing || std::all_of(request.targets.begin(), request.targets.end(),
+                            [](const auto& t) { return t.first->ring.consumedPosition() >= t.second; });
+                        if (satisfied) {
+                            ready.push_back(std::move(request.done));
+                            drainRequests[i] = std::move(drainRequests.back());
+                            drainRequests.pop_back();
+                        }
+                        else {
+                            ++i;
+                        }
+                    }
+                    drainPending.store(!drainRequests.empty(), std::memory_order_seq_cst);
+                }
+                for (auto& done : ready) {
+                    done();
+                }
+            }
+
+            bool quiescent() {
+                for (auto& r : rings) {
+                    if (r->pushing.load(std::memory_order_seq_cst) || !r->ring.empty()) {
+                        return false;
+                    }
+                }
+                return true;
+            }
+
+            void run() {
+                workerTid.store(currentThreadId());
+#ifdef __linux__
+                std::string errors = applySchedOptions(pthread_self(), workerTid.load(), options.sched);
+                if (!errors.empty()) {
+                    std::cerr << "Backend sched failed: " << errors << std::endl;
+                }
+#endif
+                auto lastReap = std::chrono::steady_clock::now();
+                bool drained = true;
+                for (;;) {
+                    refreshRings();
+                    observeQueued();
+                    size_t n = orderKey ? drainOrdered() : drainOnce();
+                    if (drainPending.load(std::memory_order_acquire)) {
+                        serviceDrains(false);
+                    }
+                    if (n != 0) {
+                        drained = false;
+                        continue;
+                    }
+                    // 忙等时只在一段写入结束后调用一次，其余方式每次空闲都调用
+                    if (idleHandler && (options.wake != WAKEMODE::SPIN || !drained)) {
+                        idleHandler();
+                    }
+                    drained = true;
+                    if (!accepting.load(std::memory_order_seq_cst)) {
+                        refreshRings();
+                        if (quiescent()) {
+                            break;
+                        }
+                        continue;
+                    }
+                    auto now = std::chrono::steady_clock::now();
+                    if (now - lastReap > std::chrono::seconds(1)) {
+                        reapRetired();
+                        lastReap = now;
+                    }
+                    if (heldUntil != 0) {
+                        waitForWindow();
+                        continue;
+                    }
+                    waitForRecords();
+                }
+                if (idleHandler) {
+                    idleHandler();
+                }
+                serviceDrains(true);
+#ifdef __linux__
+                struct timespec ts;
+                if (clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts) == 0) {
+                    lastCpuNs.store(static_cast<uint64_t>(ts.tv_sec) * 1000000000ull + static_cast<uint64_t>(ts.tv_nsec),
+                                    std::memory_order_relaxed);
+                }
+#endif
+            }
+
+            // 有记录在等待归并窗口：新到的记录只会更晚，睡到最早的一条到期即可
+            void waitForWindow() {
+                if (options.wake == WAKEMODE::SPIN) {
+                    cpuRelax();
+                    return;
+                }
+                const int64_t now = std::chrono::duration_cast<std::chrono::nanoseconds>(
+                    std::chrono::system_clock::now().time_since_epoch()).count();
+                std::chrono::nanoseconds remaining(std::max<int64_t>(heldUntil - now, 0));
+                std::this_thread::sleep_for(std::min<std::chrono::nanoseconds>(remaining, options.orderWindow));
+            }
+
+            void waitForRecords() {
+                switch (options.wake) {
+                    case WAKEMODE::SPIN:
+                        for (int i = 0; i < 16; ++i) {
+                            cpuRelax();
+                        }
+                        break;
+                    case WAKEMODE::NOTIFY: {
+                        // 声明睡眠后再查一次：生产者在此之前提交的记录或正在写入的队列都会被看到
+                        uint32_t s = signal.prepare();
+                        refreshRings();
+                        if (!quiescent() || !accepting.load(std::memory_order_seq_cst) ||
+                            drainPending.load(std::memory_order_seq_cst)) {
+                            signal.cancel();
+                            break;
+                        }
+                        signal.wait(s, options.wakeTimeout);
+                        break;
+                    }
+                    default:
+                        std::this_thread::sleep_for(options.idleSleep);
+                        break;
+                }
+            }
+
+            const uint64_t id;
+            BackendOptions options;
+            RecordHandler handler;
+            IdleHandler idleHandler;
+
+            std::mutex controlMutex;
+            std::thread worker;
+            std::atomic<long> workerTid{ -1 };
+            alignas(64) std::atomic<bool> accepting{ false };
+            WakeSignal signal;
+            std::atomic<uint64_t> lastCpuNs{ 0 };
+            std::atomic<uint64_t> peakQueued{ 0 };
+
+            std::mutex drainMutex;
+            std::vector<DrainRequest> drainRequests;
+            std::atomic<bool> drainPending{ false };
+            std::atomic<bool> workerActive{ false };    // 后台线程仍会处理 drain 请求
+
+            std::mutex registryMutex;
+            std::vector<std::shared_ptr<ThreadRing>> registry;
+            std::atomic<uint64_t> registryVersion{ 0 };
+
+            // 后台线程独占
+            std::vector<std::shared_ptr<ThreadRing>> rings;
+            uint64_t seenVersion = UINT64_MAX;
+            OrderKey orderKey = nullptr;
+            std::vector<Head> heads;
+            int64_t heldUntil = 0;      // 有序模式下最早一条被窗口挡住的记录的到期时间
+        };
+
+    } // namespace LOG
+} // namespace beiklive
+
+#endif  // INC_LOG_BACKEND_HH_
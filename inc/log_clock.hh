@@ -0,0 +1,190 @@
+// Copyright (c) RealCoolEngineer. 2024. All rights reserved.
+// Author: beiklive
+// Date: 2024-04-08
+#ifndef INC_LOG_CLOCK_HH_
+#define INC_LOG_CLOCK_HH_
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <mutex>
+#include <thread>
+#if defined(__x86_64__) || defined(__i386__)
+#include <cpuid.h>
+#include <x86intrin.h>
+#endif
+
+namespace beiklive
+{
+    namespace LOG
+    {
+        inline int64_t steadyNowNs()
+        {
+            return std::chrono::duration_cast<std::chrono::nanoseconds>(
+                std::chrono::steady_clock::now().time_since_epoch()).count();
+        }
+
+        inline int64_t systemNowNs()
+        {
+            return std::chrono::duration_cast<std::chrono::nanoseconds>(
+                std::chrono::system_clock::now().time_since_epoch()).count();
+        }
+
+        // 读取 CPU 时间戳计数器，不支持的平台退化为 steady_clock 纳秒
+        inline uint64_t rdtsc()
+        {
+#if defined(__x86_64__) || defined(__i386__)
+            return __rdtsc();
+#elif defined(__aarch64__)
+            uint64_t v;
+            asm volatile("mrs %0, cntvct_el0" : "=r"(v));
+            return v;
+#else
+            return static_cast<uint64_t>(steadyNowNs());
+#endif
+        }
+
+        // CPUID 0x80000007 EDX bit 8：TSC 频率恒定且不随 C/P 状态停止
+        inline bool detectInvariantTsc()
+        {
+#if defined(__x86_64__) || defined(__i386__)
+            unsigned eax = 0, ebx = 0, ecx = 0, edx = 0;
+            if (__get_cpuid(0x80000000, &eax, &ebx, &ecx, &edx) == 0 || eax < 0x80000007) {
+                return false;
+            }
+            if (__get_cpuid(0x80000007, &eax, &ebx, &ecx, &edx) == 0) {
+                return false;
+            }
+            return (edx & (1u << 8)) != 0;
+#elif defined(__aarch64__)
+            return true;   // 通用定时器频率固定
+#else
+            return false;
+#endif
+        }
+
+        // 基于 TSC 的时钟：取值只需一次 rdtsc，换算成墙上时间由后台按校准参数完成。
+        // TSC 不是 invariant 时退化为 steady_clock 纳秒，换算逻辑不变（每 tick 1ns）。
+        class TscClock {
+        public:
+            static bool usingTsc() {
+                static const bool invariant = detectInvariantTsc();
+                return invariant;
+            }
+
+            static uint64_t now() {
+                return usingTsc() ? rdtsc() : static_cast<uint64_t>(steadyNowNs());
+            }
+
+            // 每个 tick 对应的纳秒数，首次调用时相对进程启动时的锚点校准（不足 10ms 时补足）
+            static double nsPerTick() {
+                double ratio = state().ratio.load(std::memory_order_acquire);
+                return ratio > 0 ? ratio : calibrate();
+            }
+
+            static uint64_t toNanoseconds(uint64_t ticks) {
+                return static_cast<uint64_t>(static_cast<double>(ticks) * nsPerTick());
+            }
+
+            // tick 换算为 Unix 纪元纳秒
+            static int64_t toWallNs(uint64_t ticks) {
+                double ratio = nsPerTick();
+                State& s = state();
+                for (;;) {
+                    uint32_t seq = s.seq.load(std::memory_order_acquire);
+                    if (seq & 1) {
+                        continue;
+                    }
+                    uint64_t baseTicks = s.baseTicks.load(std::memory_order_relaxed);
+                    int64_t baseWall = s.baseWallNs.load(std::memory_order_relaxed);
+                    std::atomic_thread_fence(std::memory_order_acquire);
+                    if (s.seq.load(std::memory_order_relaxed) != seq) {
+                        continue;
+                    }
+                    int64_t delta = static_cast<int64_t>(ticks - baseTicks);
+                    return baseWall + static_cast<int64_t>(static_cast<double>(delta) * ratio);
+                }
+            }
+
+            // 重新对齐墙上时间锚点，修正与系统时钟（NTP 调整）之间的累计漂移
+            static void resync() {
+                State& s = state();
+                std::lock_guard<std::mutex> lock(s.writeMutex);
+                uint64_t ticks = now();
+                int64_t wall = systemNowNs();
+                s.seq.fetch_add(1, std::memory_order_acq_rel);
+                s.baseTicks.store(ticks, std::memory_order_relaxed);
+                s.baseWallNs.store(wall, std::memory_order_relaxed);
+                s.seq.fetch_add(1, std::memory_order_release);
+            }
+
+            // 距上次对齐超过一秒时重新对齐，ticks 取自调用方已有的时间戳，不额外读时钟
+            static void maybeResync(uint64_t ticks) {
+                State& s = state();
+                uint64_t last = s.lastResyncTicks.load(std::memory_order_relaxed);
+                uint64_t interval = static_cast<uint64_t>(1e9 / nsPerTick());
+                if (ticks > last && ticks - last > interval &&
+                    s.lastResyncTicks.compare_exchange_strong(last, ticks, std::memory_order_relaxed)) {
+                    resync();
+                }
+            }
+
+            // fork 前持有锚点的写锁
+            static void lockForFork() { state().writeMutex.lock(); }
+            static void unlockAfterFork() { state().writeMutex.unlock(); }
+
+            // 建立启动锚点，后续校准以此为起点，无需额外等待
+            static void anchor() {
+                state();
+            }
+
+            static double calibrate() {
+                State& s = state();
+                std::lock_guard<std::mutex> lock(s.writeMutex);
+                double ratio = s.ratio.load(std::memory_order_acquire);
+                if (ratio > 0) {
+                    return ratio;
+                }
+                if (!usingTsc()) {
+                    ratio = 1.0;
+                }
+                else {
+                    int64_t elapsed = steadyNowNs() - s.startSteadyNs;
+                    if (elapsed < 10000000) {
+                        std::this_thread::sleep_for(std::chrono::nanoseconds(10000000 - elapsed));
+                    }
+                    uint64_t ticks = rdtsc();
+                    int64_t ns = steadyNowNs() - s.startSteadyNs;
+                    ratio = ticks > s.startTicks ? static_cast<double>(ns) / static_cast<double>(ticks - s.startTicks) : 1.0;
+                }
+                s.ratio.store(ratio, std::memory_order_release);
+                return ratio;
+            }
+
+        private:
+            struct State
+            {
+                State()
+                    : startTicks(now()), startSteadyNs(steadyNowNs()),
+                      baseTicks(startTicks), baseWallNs(systemNowNs()), lastResyncTicks(startTicks) {}
+
+                const uint64_t startTicks;
+                const int64_t  startSteadyNs;
+                std::atomic<double>   ratio{ 0.0 };
+                std::atomic<uint32_t> seq{ 0 };
+                std::atomic<uint64_t> baseTicks;
+                std::atomic<int64_t>  baseWallNs;
+                std::atomic<uint64_t> lastResyncTicks;
+                std::mutex writeMutex;
+            };
+
+            static State& state() {
+                static State s;
+                return s;
+            }
+        };
+
+    } // namespace LOG
+} // namespace beiklive
+
+#endif  // INC_LOG_CLOCK_HH_
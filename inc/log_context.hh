@@ -0,0 +1,103 @@
+// Copyright (c) RealCoolEngineer. 2024. All rights reserved.
+// Author: beiklive
+// Date: 2024-05-24
+#ifndef INC_LOG_CONTEXT_HH_
+#define INC_LOG_CONTEXT_HH_
+
+#include <atomic>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <new>
+#include <string>
+#include <string_view>
+#include "log_format.hh"
+
+namespace beiklive
+{
+    namespace LOG
+    {
+        // 线程当前的诊断上下文：所有活动键值渲染成的一段文本（"req_id=42 user=bob"），创建后不再修改。
+        // 每次进入 LogContext 作用域生成一个节点，记录只持有节点指针和一次引用计数，
+        // 异步后台写出后释放，因此作用域提前结束也不影响尚未写出的记录。
+        class ContextNode {
+        public:
+            static ContextNode* create(const ContextNode* parent, std::string_view key, std::string_view value) {
+                size_t base = parent ? parent->length + 1 : 0;
+                size_t length = base + key.size() + 1 + value.size();
+                void* memory = std::malloc(sizeof(ContextNode) + length);
+                if (!memory) {
+                    throw std::bad_alloc();
+                }
+                ContextNode* node = new (memory) ContextNode(static_cast<uint32_t>(length));
+                char* p = node->data();
+                if (parent) {
+                    std::memcpy(p, parent->data(), parent->length);
+                    p[parent->length] = ' ';
+                    p += base;
+                }
+                std::memcpy(p, key.data(), key.size());
+                p[key.size()] = '=';
+                std::memcpy(p + key.size() + 1, value.data(), value.size());
+                return node;
+            }
+
+            void retain() const {
+                refs.fetch_add(1, std::memory_order_relaxed);
+            }
+
+            void release() const {
+                if (refs.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+                    this->~ContextNode();
+                    std::free(const_cast<ContextNode*>(this));
+                }
+            }
+
+            std::string_view text() const { return std::string_view(data(), length); }
+
+        private:
+            explicit ContextNode(uint32_t n) : refs(1), length(n) {}
+
+            char* data() const {
+                return reinterpret_cast<char*>(const_cast<ContextNode*>(this) + 1);
+            }
+
+            mutable std::atomic<uint32_t> refs;
+            uint32_t length;
+        };
+
+        inline const ContextNode*& currentContext()
+        {
+            thread_local const ContextNode* node = nullptr;
+            return node;
+        }
+
+        // LogContext ctx{ "req_id", id }; 作用域内本线程写出的每条日志都带上 [req_id=...]，可嵌套
+        class LogContext {
+        public:
+            template <typename T>
+            LogContext(std::string_view key, const T& value) {
+                std::string text;
+                formatArg(text, value);
+                previous = currentContext();
+                node = ContextNode::create(previous, key, text);
+                currentContext() = node;
+            }
+
+            ~LogContext() {
+                currentContext() = previous;
+                node->release();
+            }
+
+            LogContext(const LogContext&) = delete;
+            LogContext& operator=(const LogContext&) = delete;
+
+        private:
+            const ContextNode* previous;
+            const ContextNode* node;
+        };
+
+    } // namespace LOG
+} // namespace beiklive
+
+#endif  // INC_LOG_CONTEXT_HH_
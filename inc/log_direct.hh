@@ -0,0 +1,258 @@
+// Copyright (c) RealCoolEngineer. 2024. All rights reserved.
+// Author: beiklive
+// Date: 2024-04-26
+#ifndef INC_LOG_DIRECT_HH_
+#define INC_LOG_DIRECT_HH_
+
+#ifndef _WIN32
+
+#include <condition_variable>
+#include <cerrno>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace beiklive
+{
+    namespace LOG
+    {
+        // 绕过页缓存的日志文件写入器：以 O_DIRECT 打开，按 4KB 对齐的块写入。
+        // 两块缓冲区交替使用，一块由 I/O 线程写盘时另一块继续接收数据。
+        // flush 时末尾不足一块的数据补零写出后 ftruncate 回真实长度，并保留在缓冲区中继续追加。
+        // 文件系统不支持 O_DIRECT 时退化为普通写入，并在写出后丢弃对应的页缓存。
+        class DirectFileWriter {
+        public:
+            static constexpr size_t BLOCK = 4096;
+
+            explicit DirectFileWriter(size_t bufferBytes = 1 << 20)
+                : capacity(roundUp(bufferBytes < BLOCK ? BLOCK : bufferBytes)) {
+                for (auto& b : buffers) {
+                    void* p = nullptr;
+                    if (posix_memalign(&p, BLOCK, capacity) != 0) {
+                        p = nullptr;
+                    }
+                    b.data = static_cast<char*>(p);
+                }
+                io = std::thread([this]() { ioLoop(); });
+            }
+
+            ~DirectFileWriter() {
+                close();
+                {
+                    std::lock_guard<std::mutex> lock(ioMutex);
+                    stopping = true;
+                }
+                ioCv.notify_all();
+                io.join();
+                for (auto& b : buffers) {
+                    std::free(b.data);
+                }
+            }
+
+            DirectFileWriter(const DirectFileWriter&) = delete;
+            DirectFileWriter& operator=(const DirectFileWriter&) = delete;
+
+            // 追加方式打开，已有文件末尾不足一块的部分读回缓冲区
+            bool open(const std::string& path) {
+                close();
+                if (!buffers[0].data || !buffers[1].data) {
+                    return false;
+                }
+                directIo = true;
+#ifdef O_DIRECT
+                fd = ::open(path.c_str(), O_WRONLY | O_CREAT | O_CLOEXEC | O_DIRECT, 0644);
+                if (fd < 0 && errno == EINVAL) {
+                    directIo = false;
+                    fd = ::open(path.c_str(), O_WRONLY | O_CREAT | O_CLOEXEC, 0644);
+                }
+#else
+                directIo = false;
+                fd = ::open(path.c_str(), O_WRONLY | O_CREAT | O_CLOEXEC, 0644);
+#endif
+                if (fd < 0) {
+                    std::perror(std::string("Error opening direct log file: " + path).c_str());
+                    return false;
+                }
+                struct stat st;
+                long long existing = fstat(fd, &st) == 0 ? static_cast<long long>(st.st_size) : 0;
+                active = 0;
+                buffers[0].used = 0;
+                fileOffset = existing & ~static_cast<long long>(BLOCK - 1);
+                size_t tail = static_cast<size_t>(existing - fileOffset);
+                if (tail > 0) {
+                    int rfd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+                    ssize_t n = rfd >= 0 ? pread(rfd, buffers[0].data, tail, fileOffset) : -1;
+                    if (rfd >= 0) {
+                        ::close(rfd);
+                    }
+                    if (n != static_cast<ssize_t>(tail)) {
+                        // 读不回尾部就无法按块对齐续写，放弃打开以免覆盖已有内容
+                        std::perror(std::string("Error reading direct log file tail: " + path).c_str());
+                        ::close(fd);
+                        fd = -1;
+                        return false;
+                    }
+                    buffers[0].used = tail;
+                }
+                dirty = false;
+                return true;
+            }
+
+            bool isOpen() const { return fd >= 0; }
+            bool usingDirectIo() const { return directIo; }
+
+            // 文件的逻辑长度（含尚在缓冲区中的数据）
+            long long size() const {
+                return fileOffset + static_cast<long long>(buffers[active].used);
+            }
+
+            void write(const char* data, size_t len) {
+                while (len > 0) {
+                    Buffer& b = buffers[active];
+                    size_t n = capacity - b.used;
+                    if (n > len) {
+                        n = len;
+                    }
+                    std::memcpy(b.data + b.used, data, n);
+                    b.used += n;
+                    data += n;
+                    len -= n;
+                    dirty = true;
+                    if (b.used == capacity) {
+                        submit(b, fileOffset);
+                        fileOffset += static_cast<long long>(capacity);
+                        active ^= 1;
+                        buffers[active].used = 0;
+                    }
+                }
+            }
+
+            void flush() {
+                if (fd < 0 || !dirty) {
+                    return;
+                }
+                waitIdle();
+                Buffer& b = buffers[active];
+                if (b.used > 0) {
+                    size_t padded = roundUp(b.used);
+                    std::memset(b.data + b.used, 0, padded - b.used);
+                    writeAt(b.data, padded, fileOffset);
+                    if (ftruncate(fd, fileOffset + static_cast<long long>(b.used)) != 0) {
+                        std::perror("Error truncating direct log file");
+                    }
+                    size_t full = b.used & ~(BLOCK - 1);
+                    if (full > 0) {
+                        std::memmove(b.data, b.data + full, b.used - full);
+                        fileOffset += static_cast<long long>(full);
+                        b.used -= full;
+                    }
+                }
+                dirty = false;
+            }
+
+            void close() {
+                if (fd < 0) {
+                    return;
+                }
+                flush();
+                ::close(fd);
+                fd = -1;
+            }
+
+        private:
+            struct Buffer
+            {
+                char*  data = nullptr;
+                size_t used = 0;
+            };
+
+            static size_t roundUp(size_t n) {
+                return (n + BLOCK - 1) & ~(BLOCK - 1);
+            }
+
+            bool writeAt(const char* data, size_t len, long long offset) {
+                while (len > 0) {
+                    ssize_t n = pwrite(fd, data, len, offset);
+                    if (n < 0) {
+                        if (errno == EINTR) {
+                            continue;
+                        }
+                        std::perror("Error writing direct log file");
+                        return false;
+                    }
+                    if (!directIo) {
+#ifdef __linux__
+                        sync_file_range(fd, offset, n, SYNC_FILE_RANGE_WAIT_BEFORE | SYNC_FILE_RANGE_WRITE |
+                                        SYNC_FILE_RANGE_WAIT_AFTER);
+#endif
+#ifdef POSIX_FADV_DONTNEED
+                        posix_fadvise(fd, offset, n, POSIX_FADV_DONTNEED);
+#endif
+                    }
+                    data += n;
+                    len -= static_cast<size_t>(n);
+                    offset += n;
+                }
+                return true;
+            }
+
+            // 交给 I/O 线程写出；返回时另一块缓冲区已写完，可以复用
+            void submit(Buffer& b, long long offset) {
+                std::unique_lock<std::mutex> lock(ioMutex);
+                ioCv.wait(lock, [this]() { return pending == nullptr; });
+                pending = &b;
+                pendingOffset = offset;
+                ioCv.notify_all();
+            }
+
+            void waitIdle() {
+                std::unique_lock<std::mutex> lock(ioMutex);
+                ioCv.wait(lock, [this]() { return pending == nullptr; });
+            }
+
+            void ioLoop() {
+                std::unique_lock<std::mutex> lock(ioMutex);
+                for (;;) {
+                    ioCv.wait(lock, [this]() { return pending != nullptr || stopping; });
+                    if (pending == nullptr) {
+                        return;
+                    }
+                    Buffer* b = pending;
+                    long long offset = pendingOffset;
+                    lock.unlock();
+                    writeAt(b->data, capacity, offset);
+                    lock.lock();
+                    pending = nullptr;
+                    ioCv.notify_all();
+                }
+            }
+
+            const size_t capacity;
+            Buffer    buffers[2];
+            int       active = 0;
+            int       fd = -1;
+            bool      directIo = true;
+            bool      dirty = false;
+            long long fileOffset = 0;
+
+            std::thread io;
+            std::mutex ioMutex;
+            std::condition_variable ioCv;
+            Buffer*   pending = nullptr;
+            long long pendingOffset = 0;
+            bool      stopping = false;
+        };
+
+    } // namespace LOG
+} // namespace beiklive
+
+#endif  // _WIN32
+
+#endif  // INC_LOG_DIRECT_HH_
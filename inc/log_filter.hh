@@ -0,0 +1,453 @@
+// Copyright (c) RealCoolEngineer. 2024. All rights reserved.
+// Author: beiklive
+// Date: 2024-05-31
+#ifndef INC_LOG_FILTER_HH_
+#define INC_LOG_FILTER_HH_
+
+#include <charconv>
+#include <cstdint>
+#include <regex>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace beiklive
+{
+    namespace LOG
+    {
+        // 三值判定：只知道调用点信息时，依赖消息或字段的条件为 MAYBE
+        enum class FILTERMATCH : uint8_t
+        {
+            NO,
+            YES,
+            MAYBE
+        };
+
+        // __PRETTY_FUNCTION__ 中的限定函数名："void net::Conn::read(int)" -> "net::Conn::read"
+        inline std::string_view functionName(std::string_view pretty)
+        {
+            int depth = 0;
+            size_t open = pretty.size();
+            for (size_t i = 0; i < pretty.size(); ++i) {
+                char c = pretty[i];
+                if (c == '<') {
+                    ++depth;
+                }
+                else if (c == '>') {
+                    --depth;
+                }
+                else if (c == '(' && depth == 0) {
+                    open = i;
+                    break;
+                }
+            }
+            size_t begin = 0;
+            depth = 0;
+            for (size_t i = open; i > 0; --i) {
+                char c = pretty[i - 1];
+                if (c == '>') {
+                    ++depth;
+                }
+                else if (c == '<') {
+                    --depth;
+                }
+                else if ((c == ' ' || c == '*' || c == '&') && depth == 0) {
+                    begin = i;
+                    break;
+                }
+            }
+            return pretty.substr(begin, open - begin);
+        }
+
+        // '*' 匹配任意串，'?' 匹配单个字符
+        inline bool globMatch(std::string_view pattern, std::string_view text)
+        {
+            size_t p = 0, t = 0;
+            size_t star = std::string_view::npos, resume = 0;
+            while (t < text.size()) {
+                if (p < pattern.size() && (pattern[p] == '?' || pattern[p] == text[t])) {
+                    ++p;
+                    ++t;
+                }
+                else if (p < pattern.size() && pattern[p] == '*') {
+                    star = p++;
+                    resume = t;
+                }
+                else if (star != std::string_view::npos) {
+                    p = star + 1;
+                    t = ++resume;
+                }
+                else {
+                    return false;
+                }
+            }
+            while (p < pattern.size() && pattern[p] == '*') {
+                ++p;
+            }
+            return p == pattern.size();
+        }
+
+        // 编译后的过滤表达式，例如 `func:net::* && latency>10ms`、`level:WARNING || msg~"timeout \d+"`。
+        //   func:GLOB / file:GLOB   调用点的限定函数名 / 源文件
+        //   level:NAME              不低于该级别（ERROR、WARNING、INFO、DEBUG）
+        //   msg:TEXT / msg~REGEX    消息包含子串 / 匹配正则
+        //   KEY op VALUE            诊断上下文或消息中的 KEY=VALUE 字段，op 为 = != > >= < <= ~；
+        //                           数值可带 ns/us/ms/s 单位，一侧无单位时按另一侧的单位比较
+        // 条件之间用空格或 && 连接，|| 优先级更低，支持 ! 与括号；值含空格时加双引号。
+        class LogFilter {
+        public:
+            // 失败时返回 false，error 为出错位置说明
+            bool compile(std::string_view text, std::string* error = nullptr) {
+                nodes.clear();
+                regexes.clear();
+                src = text;
+                pos = 0;
+                failure.clear();
+                try {
+                    root = parseOr();
+                    skipSpace();
+                    if (failure.empty() && pos != src.size()) {
+                        fail("unexpected input");
+                    }
+                }
+                catch (const std::regex_error& e) {
+                    fail(std::string("bad regex: ") + e.what());
+                }
+                if (!failure.empty()) {
+                    if (error) {
+                        *error = failure;
+                    }
+                    nodes.clear();
+                    return false;
+                }
+                return true;
+            }
+
+            // 只用调用点信息判定，结果可按调用点缓存
+            FILTERMATCH matchStatic(int level, std::string_view function, std::string_view file) const {
+                Record r{ level, function, file, {}, {}, false };
+                return eval(root, r);
+            }
+
+            bool match(int level, std::string_view function, std::string_view file, std::string_view message,
+                       std::string_view context) const {
+                Record r{ level, function, file, message, context, true };
+                return eval(root, r) == FILTERMATCH::YES;
+            }
+
+        private:
+            enum class KIND : uint8_t { AND, OR, NOT, FUNC, FILE, LEVEL, MSG, MSG_REGEX, FIELD };
+            enum class OP : uint8_t { EQ, NE, GT, GE, LT, LE, REGEX };
+
+            struct Node
+            {
+                KIND        kind;
+                OP          op = OP::EQ;
+                int         lhs = -1;        // 子节点；LEVEL 为级别；正则为 regexes 下标
+                int         rhs = -1;
+                std::string key;
+                std::string value;
+                double      number = 0;
+                double      scale = 0;       // 单位换算到纳秒的系数，0 表示无单位
+                bool        numeric = false;
+            };
+
+            struct Record
+            {
+                int              level;
+                std::string_view function;
+                std::string_view file;
+                std::string_view message;
+                std::string_view context;
+                bool             dynamic;    // false 时消息与字段未知
+            };
+
+            static FILTERMATCH fromBool(bool b) { return b ? FILTERMATCH::YES : FILTERMATCH::NO; }
+
+            FILTERMATCH eval(int index, const Record& r) const {
+                const Node& n = nodes[static_cast<size_t>(index)];
+                switch (n.kind) {
+                    case KIND::AND: {
+                        FILTERMATCH a = eval(n.lhs, r);
+                        if (a == FILTERMATCH::NO) {
+                            return a;
+                        }
+                        FILTERMATCH b = eval(n.rhs, r);
+                        return b == FILTERMATCH::YES ? a : b;
+                    }
+                    case KIND::OR: {
+                        FILTERMATCH a = eval(n.lhs, r);
+                        if (a == FILTERMATCH::YES) {
+                            return a;
+                        }
+                        FILTERMATCH b = eval(n.rhs, r);
+                        return b == FILTERMATCH::NO ? a : b;
+                    }
+                    case KIND::NOT: {
+                        FILTERMATCH a = eval(n.lhs, r);
+                        return a == FILTERMATCH::MAYBE ? a : fromBool(a == FILTERMATCH::NO);
+                    }
+                    case KIND::FUNC:
+                        return fromBool(globMatch(n.value, r.function));
+                    case KIND::FILE:
+                        return fromBool(globMatch(n.value, r.file));
+                    case KIND::LEVEL:
+                        return fromBool(r.level <= n.lhs);
+                    default:
+                        break;
+                }
+                if (!r.dynamic) {
+                    return FILTERMATCH::MAYBE;
+                }
+                switch (n.kind) {
+                    case KIND::MSG:
+                        return fromBool(r.message.find(n.value) != std::string_view::npos);
+                    case KIND::MSG_REGEX:
+                        return fromBool(std::regex_search(r.message.begin(), r.message.end(),
+                                                          regexes[static_cast<size_t>(n.lhs)]));
+                    default: {
+                        std::string_view v;
+                        if (!findField(r.context, n.key, &v) && !findField(r.message, n.key, &v)) {
+                            return fromBool(n.op == OP::NE);
+                        }
+                        return fromBool(compare(n, v));
+                    }
+                }
+            }
+
+            bool compare(const Node& n, std::string_view v) const {
+                if (n.op == OP::REGEX) {
+                    return std::regex_search(v.begin(), v.end(), regexes[static_cast<size_t>(n.lhs)]);
+                }
+                double number = 0, scale = 0;
+                if (!n.numeric || !parseNumber(v, &number, &scale)) {
+                    bool equal = v == n.value;
+                    return n.op == OP::EQ ? equal : n.op == OP::NE ? !equal : false;
+                }
+                double lhs = number * (scale != 0 ? scale : (n.scale != 0 ? n.scale : 1));
+                double rhs = n.number * (n.scale != 0 ? n.scale : (scale != 0 ? scale : 1));
+                switch (n.op) {
+                    case OP::EQ: return lhs == rhs;
+                    case OP::NE: return lhs != rhs;
+                    case OP::GT: return lhs > rhs;
+                    case OP::GE: return lhs >= rhs;
+                    case OP::LT: return lhs < rhs;
+                    default: return lhs <= rhs;
+                }
+            }
+
+            static bool isKeyChar(char c) {
+                return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || (c >= '0' && c <= '9') || c == '_' ||
+                       c == '.' || c == '-';
+            }
+
+            // text 中以 key= 开头（前一个字符不属于键名）的字段值
+            static bool findField(std::string_view text, std::string_view key, std::string_view* value) {
+                for (size_t at = text.find(key); at != std::string_view::npos; at = text.find(key, at + 1)) {
+                    size_t eq = at + key.size();
+                    if ((at != 0 && isKeyChar(text[at - 1])) || eq >= text.size() || text[eq] != '=') {
+                        continue;
+                    }
+                    size_t end = eq + 1;
+                    while (end < text.size() && text[end] != ' ' && text[end] != ',' && text[end] != ';' &&
+                           text[end] != ')' && text[end] != ']') {
+                        ++end;
+                    }
+                    *value = text.substr(eq + 1, end - eq - 1);
+                    return true;
+                }
+                return false;
+            }
+
+            static bool parseNumber(std::string_view text, double* number, double* scale) {
+                const char* end = text.data() + text.size();
+                auto result = std::from_chars(text.data(), end, *number);
+                if (result.ec != std::errc()) {
+                    return false;
+                }
+                std::string_view unit(result.ptr, static_cast<size_t>(end - result.ptr));
+                if (unit.empty()) *scale = 0;
+                else if (unit == "ns") *scale = 1;
+                else if (unit == "us") *scale = 1e3;
+                else if (unit == "ms") *scale = 1e6;
+                else if (unit == "s") *scale = 1e9;
+                else return false;
+                return true;
+            }
+
+            void fail(std::string message) {
+                if (failure.empty()) {
+                    failure = message + " at offset " + std::to_string(pos);
+                }
+            }
+
+            void skipSpace() {
+                while (pos < src.size() && (src[pos] == ' ' || src[pos] == '\t')) {
+                    ++pos;
+                }
+            }
+
+            bool consume(std::string_view token) {
+                skipSpace();
+                if (src.substr(pos, token.size()) == token) {
+                    pos += token.size();
+                    return true;
+                }
+                return false;
+            }
+
+            int add(Node n) {
+                nodes.push_back(std::move(n));
+                return static_cast<int>(nodes.size() - 1);
+            }
+
+            int join(KIND kind, int lhs, int rhs) {
+                Node n;
+                n.kind = kind;
+                n.lhs = lhs;
+                n.rhs = rhs;
+                return add(std::move(n));
+            }
+
+            int parseOr() {
+                int lhs = parseAnd();
+                while (failure.empty() && consume("||")) {
+                    lhs = join(KIND::OR, lhs, parseAnd());
+                }
+                return lhs;
+            }
+
+            int parseAnd() {
+                int lhs = parseUnary();
+                for (;;) {
+                    skipSpace();
+                    if (!failure.empty() || pos >= src.size() || src[pos] == ')' || src.substr(pos, 2) == "||") {
+                        return lhs;
+                    }
+                    consume("&&");
+                    lhs = join(KIND::AND, lhs, parseUnary());
+                }
+            }
+
+            int parseUnary() {
+                if (consume("!")) {
+                    return join(KIND::NOT, parseUnary(), -1);
+                }
+                if (consume("(")) {
+                    int inner = parseOr();
+                    if (!consume(")")) {
+                        fail("expected ')'");
+                    }
+                    return inner;
+                }
+                return parseTerm();
+            }
+
+            // 双引号内的值支持 \" 转义，否则读到空白或 ')'
+            std::string parseValue() {
+                skipSpace();
+                std::string value;
+                if (pos < src.size() && src[pos] == '"') {
+                    for (++pos; pos < src.size() && src[pos] != '"'; ++pos) {
+                        if (src[pos] == '\\' && pos + 1 < src.size() && src[pos + 1] == '"') {
+                            ++pos;
+                        }
+                        value += src[pos];
+                    }
+                    if (pos >= src.size()) {
+                        fail("unterminated string");
+                    }
+                    ++pos;
+                    return value;
+                }
+                while (pos < src.size() && src[pos] != ' ' && src[pos] != '\t' && src[pos] != ')') {
+                    value += src[pos++];
+                }
+                if (value.empty()) {
+                    fail("expected value");
+                }
+                return value;
+            }
+
+            int parseTerm() {
+                skipSpace();
+                size_t start = pos;
+                while (pos < src.size() && isKeyChar(src[pos])) {
+                    ++pos;
+                }
+                std::string key(src.substr(start, pos - start));
+                if (key.empty()) {
+                    fail("expected condition");
+                    return -1;
+                }
+                Node n;
+                if (pos < src.size() && src[pos] == ':' && (key == "func" || key == "file" || key == "level" ||
+                                                            key == "msg")) {
+                    ++pos;
+                    n.value = parseValue();
+                    n.kind = key == "func" ? KIND::FUNC : key == "file" ? KIND::FILE : key == "msg" ? KIND::MSG
+                                                                                                    : KIND::LEVEL;
+                    if (n.kind == KIND::LEVEL) {
+                        static const char* const names[] = { "ERROR", "WARNING", "INFO", "DEBUG" };
+                        for (int i = 0; i < 4; ++i) {
+                            if (n.value == names[i]) {
+                                n.lhs = i;
+                            }
+                        }
+                        if (n.lhs < 0) {
+                            fail("unknown level '" + n.value + "'");
+                        }
+                    }
+                    return add(std::move(n));
+                }
+                if (key == "msg" && pos < src.size() && src[pos] == '~') {
+                    ++pos;
+                    n.kind = KIND::MSG_REGEX;
+                    n.lhs = addRegex(parseValue());
+                    return add(std::move(n));
+                }
+                n.kind = KIND::FIELD;
+                n.key = key;
+                if (consume(">=")) n.op = OP::GE;
+                else if (consume("<=")) n.op = OP::LE;
+                else if (consume("!=")) n.op = OP::NE;
+                else if (consume(">")) n.op = OP::GT;
+                else if (consume("<")) n.op = OP::LT;
+                else if (consume("=")) n.op = OP::EQ;
+                else if (consume("~")) n.op = OP::REGEX;
+                else {
+                    fail("expected operator after '" + key + "'");
+                    return -1;
+                }
+                n.value = parseValue();
+                if (n.op == OP::REGEX) {
+                    n.lhs = addRegex(n.value);
+                }
+                else {
+                    n.numeric = parseNumber(n.value, &n.number, &n.scale);
+                    if (!n.numeric && n.op != OP::EQ && n.op != OP::NE) {
+                        fail("'" + key + "' needs a numeric value");
+                    }
+                }
+                return add(std::move(n));
+            }
+
+            int addRegex(const std::string& pattern) {
+                regexes.emplace_back(pattern, std::regex::ECMAScript | std::regex::optimize);
+                return static_cast<int>(regexes.size() - 1);
+            }
+
+            std::vector<Node>       nodes;
+            std::vector<std::regex> regexes;
+            int                     root = -1;
+
+            // 仅编译期间使用
+            std::string_view        src;
+            size_t                  pos = 0;
+            std::string             failure;
+        };
+
+    } // namespace LOG
+} // namespace beiklive
+
+#endif  // INC_LOG_FILTER_HH_
@@ -0,0 +1,77 @@
+// Copyright (c) RealCoolEngineer. 2024. All rights reserved.
+// Author: beiklive
+// Date: 2024-04-19
+#ifndef INC_LOG_FLIGHT_HH_
+#define INC_LOG_FLIGHT_HH_
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+namespace beiklive
+{
+    namespace LOG
+    {
+        // 线程私有的飞行记录器：固定数量、固定大小的槽位循环覆盖，
+        // 只保存编码后的记录（按值拷贝的参数），需要时再格式化输出。
+        class FlightRecorder {
+        public:
+            void configure(size_t records, size_t slotBytes) {
+                slotSize = (slotBytes + 7) & ~size_t(7);
+                capacity = records;
+                storage.reset(records ? new uint64_t[records * slotSize / sizeof(uint64_t)] : nullptr);
+                lengths.assign(records, 0);
+                clear();
+            }
+
+            // 取下一个槽位写入 bytes 字节，超过槽位大小时返回 nullptr
+            char* acquire(size_t bytes) {
+                if (capacity == 0 || bytes > slotSize) {
+                    return nullptr;
+                }
+                size_t index = next;
+                next = (next + 1) % capacity;
+                if (used < capacity) {
+                    ++used;
+                }
+                lengths[index] = static_cast<uint32_t>(bytes);
+                return slot(index);
+            }
+
+            // 从最旧到最新依次访问
+            template <typename F>
+            void forEach(F&& fn) const {
+                size_t first = (next + capacity - used) % (capacity ? capacity : 1);
+                for (size_t i = 0; i < used; ++i) {
+                    size_t index = (first + i) % capacity;
+                    fn(static_cast<const char*>(slot(index)), static_cast<size_t>(lengths[index]));
+                }
+            }
+
+            void clear() {
+                next = 0;
+                used = 0;
+            }
+
+            size_t size() const { return used; }
+            size_t slotBytes() const { return slotSize; }
+            uint64_t generation = 0;
+
+        private:
+            char* slot(size_t index) const {
+                return reinterpret_cast<char*>(storage.get()) + index * slotSize;
+            }
+
+            std::unique_ptr<uint64_t[]> storage;
+            std::vector<uint32_t> lengths;
+            size_t capacity = 0;
+            size_t slotSize = 0;
+            size_t next = 0;
+            size_t used = 0;
+        };
+
+    } // namespace LOG
+} // namespace beiklive
+
+#endif  // INC_LOG_FLIGHT_HH_
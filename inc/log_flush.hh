@@ -0,0 +1,168 @@
+// Copyright (c) RealCoolEngineer. 2024. All rights reserved.
+// Author: beiklive
+// Date: 2024-05-30
+#ifndef INC_LOG_FLUSH_HH_
+#define INC_LOG_FLUSH_HH_
+
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <utility>
+#include "log_sched.hh"
+#if __cplusplus >= 202002L && __has_include(<coroutine>)
+#include <coroutine>
+#define BEIKLIVE_LOG_COROUTINES 1
+#endif
+
+namespace beiklive
+{
+    namespace LOG
+    {
+        // 在独立线程上执行完成回调：落盘和恢复协程都不占用后台写线程，也不在调用方线程上重入
+        class CompletionQueue {
+        public:
+            ~CompletionQueue() {
+                {
+                    std::lock_guard<std::mutex> lock(mutex);
+                    stopping = true;
+                }
+                cv.notify_all();
+                if (worker.joinable()) {
+                    worker.join();
+                }
+            }
+
+            void post(std::function<void()> task) {
+                {
+                    std::lock_guard<std::mutex> lock(mutex);
+                    tasks.push_back(std::move(task));
+                    if (!worker.joinable()) {
+                        worker = std::thread([this]() { run(); });
+                    }
+                }
+                cv.notify_one();
+            }
+
+            // 等待此前投递的任务执行完；在完成线程上调用时直接返回
+            void barrier() {
+                {
+                    std::lock_guard<std::mutex> lock(mutex);
+                    if (!worker.joinable() || worker.get_id() == std::this_thread::get_id()) {
+                        return;
+                    }
+                }
+                std::mutex m;
+                std::condition_variable reachedCv;
+                bool reached = false;
+                post([&]() {
+                    std::lock_guard<std::mutex> lock(m);
+                    reached = true;
+                    reachedCv.notify_one();
+                });
+                std::unique_lock<std::mutex> lock(m);
+                reachedCv.wait(lock, [&]() { return reached; });
+            }
+
+            void lockForFork() { mutex.lock(); }
+            void unlockAfterFork() { mutex.unlock(); }
+
+            // fork 出的子进程中完成线程并不存在：丢弃父进程未执行的任务，下次投递时重新创建线程
+            void abandonAfterFork() {
+                abandonThreadAfterFork(worker);
+                tasks.clear();
+            }
+
+        private:
+            void run() {
+                std::unique_lock<std::mutex> lock(mutex);
+                for (;;) {
+                    cv.wait(lock, [this]() { return stopping || !tasks.empty(); });
+                    if (tasks.empty()) {
+                        return;
+                    }
+                    std::function<void()> task = std::move(tasks.front());
+                    tasks.pop_front();
+                    lock.unlock();
+                    task();
+                    lock.lock();
+                }
+            }
+
+            std::mutex mutex;
+            std::condition_variable cv;
+            std::deque<std::function<void()>> tasks;
+            std::thread worker;
+            bool stopping = false;
+        };
+
+        struct FlushState
+        {
+            std::mutex mutex;
+            std::condition_variable cv;
+            bool done = false;
+            std::function<void()> waiter;   // 挂起的协程
+
+            void complete() {
+                std::function<void()> resume;
+                {
+                    std::lock_guard<std::mutex> lock(mutex);
+                    done = true;
+                    resume = std::move(waiter);
+                }
+                cv.notify_all();
+                if (resume) {
+                    resume();
+                }
+            }
+        };
+
+        // 一次 flush / drain 请求：创建时记下各队列已提交的位置，此前入队的记录全部写出
+        // （flush 还要落盘）后完成。可阻塞等待，C++20 下也可以 co_await，协程在完成线程上恢复。
+        class [[nodiscard]] FlushRequest {
+        public:
+            explicit FlushRequest(std::shared_ptr<FlushState> s) : state(std::move(s)) {}
+
+            bool done() const {
+                std::lock_guard<std::mutex> lock(state->mutex);
+                return state->done;
+            }
+
+            // 超时返回 false，请求仍会在之后完成
+            bool wait(std::chrono::milliseconds timeout) const {
+                std::unique_lock<std::mutex> lock(state->mutex);
+                return state->cv.wait_for(lock, timeout, [this]() { return state->done; });
+            }
+
+            void wait() const {
+                std::unique_lock<std::mutex> lock(state->mutex);
+                state->cv.wait(lock, [this]() { return state->done; });
+            }
+
+#ifdef BEIKLIVE_LOG_COROUTINES
+            bool await_ready() const { return done(); }
+
+            // 已完成时返回 false，协程不挂起
+            bool await_suspend(std::coroutine_handle<> handle) {
+                std::lock_guard<std::mutex> lock(state->mutex);
+                if (state->done) {
+                    return false;
+                }
+                state->waiter = [handle]() { handle.resume(); };
+                return true;
+            }
+
+            void await_resume() const {}
+#endif
+
+        private:
+            std::shared_ptr<FlushState> state;
+        };
+
+    } // namespace LOG
+} // namespace beiklive
+
+#endif  // INC_LOG_FLUSH_HH_
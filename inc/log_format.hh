@@ -0,0 +1,601 @@
+// Copyright (c) RealCoolEngineer. 2024. All rights reserved.
+// Author: beiklive
+// Date: 2024-05-13
+#ifndef INC_LOG_FORMAT_HH_
+#define INC_LOG_FORMAT_HH_
+
+#include <charconv>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <limits>
+#include <sstream>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <type_traits>
+#include <utility>
+
+namespace beiklive
+{
+    namespace LOG
+    {
+        // 参数格式化：内置类型用 to_chars 或手写的转换直接追加到输出缓冲，
+        // 只有用户类型才经过 operator<<（复用线程私有的 ostringstream）。
+        template <typename T, typename = void>
+        struct is_streamable : std::false_type {};
+
+        template <typename T>
+        struct is_streamable<T, decltype(void(std::declval<std::ostream&>() << std::declval<const T&>()))>
+            : std::true_type {};
+
+        template <typename T>
+        struct StreamFormatter
+        {
+            static void write(std::string& out, const T& v) {
+                static_assert(is_streamable<T>::value, "log argument type has no operator<<");
+                thread_local std::ostringstream ss;
+                ss.str(std::string());
+                ss.clear();
+                ss << v;
+                out += ss.str();
+            }
+        };
+
+        template <typename T, typename Enable = void>
+        struct Formatter : StreamFormatter<T> {};
+
+        template <typename T>
+        inline void appendInteger(std::string& out, T v, int base = 10)
+        {
+            char buf[72];
+            auto r = std::to_chars(buf, buf + sizeof(buf), v, base);
+            out.append(buf, static_cast<size_t>(r.ptr - buf));
+        }
+
+        // 最短往返表示
+        template <typename T>
+        inline void appendFloat(std::string& out, T v)
+        {
+            char buf[64];
+#if defined(__cpp_lib_to_chars) && __cpp_lib_to_chars >= 201611L
+            auto r = std::to_chars(buf, buf + sizeof(buf), v);
+            out.append(buf, static_cast<size_t>(r.ptr - buf));
+#else
+            int n = std::snprintf(buf, sizeof(buf), "%.*g", std::numeric_limits<T>::max_digits10,
+                                  static_cast<double>(v));
+            out.append(buf, n > 0 ? static_cast<size_t>(n) : 0);
+#endif
+        }
+
+        // 与 ostream 一致：bool 输出 0/1，字符类型输出字符本身
+        template <>
+        struct Formatter<bool>
+        {
+            static void write(std::string& out, bool v) { out += v ? '1' : '0'; }
+        };
+
+        template <typename T>
+        struct Formatter<T, typename std::enable_if<std::is_same<T, char>::value || std::is_same<T, signed char>::value ||
+                                                    std::is_same<T, unsigned char>::value>::type>
+        {
+            static void write(std::string& out, T v) { out += static_cast<char>(v); }
+        };
+
+        template <typename T>
+        struct Formatter<T, typename std::enable_if<std::is_integral<T>::value && !std::is_same<T, bool>::value &&
+                                                    !std::is_same<T, char>::value && !std::is_same<T, signed char>::value &&
+                                                    !std::is_same<T, unsigned char>::value>::type>
+        {
+            static void write(std::string& out, T v) { appendInteger(out, v); }
+        };
+
+        template <typename T>
+        struct Formatter<T, typename std::enable_if<std::is_floating_point<T>::value>::type>
+        {
+            static void write(std::string& out, T v) { appendFloat(out, v); }
+        };
+
+        template <>
+        struct Formatter<std::string_view>
+        {
+            static void write(std::string& out, std::string_view v) { out.append(v.data(), v.size()); }
+        };
+
+        template <>
+        struct Formatter<std::string>
+        {
+            static void write(std::string& out, const std::string& v) { out += v; }
+        };
+
+        template <>
+        struct Formatter<const char*>
+        {
+            static void write(std::string& out, const char* v) { out += v ? v : "(null)"; }
+        };
+
+        template <>
+        struct Formatter<char*> : Formatter<const char*> {};
+
+        template <size_t N>
+        struct Formatter<char[N]>
+        {
+            static void write(std::string& out, const char (&v)[N]) { out += std::string_view(v); }
+        };
+
+        // 其他指针按十六进制地址输出
+        template <typename T>
+        struct Formatter<T*, typename std::enable_if<!std::is_same<typename std::remove_cv<T>::type, char>::value>::type>
+        {
+            static void write(std::string& out, const T* v) {
+                out += "0x";
+                appendInteger(out, reinterpret_cast<uintptr_t>(v), 16);
+            }
+        };
+
+        template <>
+        struct Formatter<std::nullptr_t>
+        {
+            static void write(std::string& out, std::nullptr_t) { out += "0x0"; }
+        };
+
+        // libstdc++/libc++ 的 thread::id 即 native handle，按整数输出与 operator<< 一致
+        template <>
+        struct Formatter<std::thread::id>
+        {
+            static void write(std::string& out, const std::thread::id& v) {
+                if constexpr (sizeof(std::thread::id) == sizeof(uint64_t) &&
+                              std::is_trivially_copyable<std::thread::id>::value) {
+                    if (v == std::thread::id()) {
+                        out += "thread::id of a non-executing thread";
+                        return;
+                    }
+                    uint64_t n;
+                    std::memcpy(&n, &v, sizeof(n));
+                    appendInteger(out, n);
+                }
+                else {
+                    StreamFormatter<std::thread::id>::write(out, v);
+                }
+            }
+        };
+
+        // 没有 operator<< 的枚举按底层整数输出
+        template <typename T>
+        struct Formatter<T, typename std::enable_if<std::is_enum<T>::value && !is_streamable<T>::value>::type>
+        {
+            static void write(std::string& out, T v) {
+                appendInteger(out, static_cast<typename std::underlying_type<T>::type>(v));
+            }
+        };
+
+        template <typename T>
+        inline void formatArg(std::string& out, const T& v)
+        {
+            Formatter<typename std::remove_cv<T>::type>::write(out, v);
+        }
+
+        //*FORMAT SPEC ***************************************************************
+        // 占位符语法 {[:[[fill]align][sign][#][0][width][.precision][type]]}，参数按出现顺序依次使用；
+        // {{ 与 }} 输出单个花括号。LOG_* 宏在编译期把字面量格式串解析为 FormatStep 序列，运行时只按步骤执行，
+        // 带名称或序号的占位符、无法完整解析的说明符在编译期报错；运行时格式串不做检查，名称被忽略。
+        struct FormatSpec
+        {
+            char fill = ' ';
+            char align = 0;         // '<' '>' '^'，0 为默认（数值右对齐，其余左对齐）
+            char sign = 0;          // '+' ' ' '-'
+            char type = 0;          // d x X o b B c / f F e E g G / s p
+            bool alternate = false; // '#'：0x / 0b / 0 前缀
+            bool zeroPad = false;
+            bool present = false;   // 占位符中带有 ':' 说明符
+            bool malformed = false; // 说明符有未能解析的内容或未知的类型
+            int  width = 0;
+            int  precision = -1;
+        };
+
+        // 先输出 pattern 中的一段原文，再（有占位符时）格式化下一个参数
+        struct FormatStep
+        {
+            uint32_t   literalBegin = 0;
+            uint32_t   literalLength = 0;
+            uint32_t   fieldBegin = 0;      // 占位符原文，参数不足时原样输出
+            uint32_t   fieldLength = 0;
+            bool       hasField = false;
+            bool       named = false;       // '{' 与 ':' 之间有名称或序号
+            FormatSpec spec;
+        };
+
+        struct FormatProgram
+        {
+            const char*       pattern;
+            const FormatStep* steps;
+            uint32_t          count;
+        };
+
+        constexpr size_t patternLength(const char* p)
+        {
+            size_t n = 0;
+            while (p && p[n] != '\0') {
+                ++n;
+            }
+            return n;
+        }
+
+        constexpr bool isAlign(char c)
+        {
+            return c == '<' || c == '>' || c == '^';
+        }
+
+        constexpr bool isFormatType(char c)
+        {
+            for (const char* t = "dxXobBcfFeEgGsp"; *t != '\0'; ++t) {
+                if (*t == c) {
+                    return true;
+                }
+            }
+            return false;
+        }
+
+        constexpr FormatSpec parseFormatSpec(const char* s, size_t len)
+        {
+            FormatSpec spec;
+            spec.present = true;
+            size_t pos = 0;
+            if (len >= 2 && isAlign(s[1])) {
+                spec.fill = s[0];
+                spec.align = s[1];
+                pos = 2;
+            }
+            else if (len >= 1 && isAlign(s[0])) {
+                spec.align = s[0];
+                pos = 1;
+            }
+            if (pos < len && (s[pos] == '+' || s[pos] == '-' || s[pos] == ' ')) {
+                spec.sign = s[pos++];
+            }
+            if (pos < len && s[pos] == '#') {
+                spec.alternate = true;
+                ++pos;
+            }
+            if (pos < len && s[pos] == '0') {
+                spec.zeroPad = true;
+                ++pos;
+            }
+            while (pos < len && s[pos] >= '0' && s[pos] <= '9') {
+                spec.width = spec.width * 10 + (s[pos++] - '0');
+            }
+            if (pos < len && s[pos] == '.') {
+                spec.precision = 0;
+                ++pos;
+                spec.malformed = pos == len || s[pos] < '0' || s[pos] > '9';
+                while (pos < len && s[pos] >= '0' && s[pos] <= '9') {
+                    spec.precision = spec.precision * 10 + (s[pos++] - '0');
+                }
+            }
+            if (pos < len) {
+                spec.type = s[pos++];
+                spec.malformed = spec.malformed || !isFormatType(spec.type);
+            }
+            spec.malformed = spec.malformed || pos < len;
+            return spec;
+        }
+
+        // 从 pos 处解析下一步，pattern 已结束时返回 false；没有闭合的 '{' 按原文处理
+        constexpr bool nextFormatStep(const char* p, size_t len, size_t& pos, FormatStep& step)
+        {
+            if (pos >= len) {
+                return false;
+            }
+            step = FormatStep();
+            step.literalBegin = static_cast<uint32_t>(pos);
+            size_t i = pos;
+            while (i < len) {
+                char c = p[i];
+                if ((c == '{' || c == '}') && i + 1 < len && p[i + 1] == c) {
+                    step.literalLength = static_cast<uint32_t>(i + 1 - pos);
+                    pos = i + 2;
+                    return true;
+                }
+                if (c == '{') {
+                    size_t close = i + 1;
+                    while (close < len && p[close] != '}') {
+                        ++close;
+                    }
+                    if (close == len) {
+                        break;
+                    }
+                    size_t colon = i + 1;
+                    while (colon < close && p[colon] != ':') {
+                        ++colon;
+                    }
+                    if (colon < close) {
+                        step.spec = parseFormatSpec(p + colon + 1, close - colon - 1);
+                    }
+                    step.literalLength = static_cast<uint32_t>(i - pos);
+                    step.fieldBegin = static_cast<uint32_t>(i);
+                    step.fieldLength = static_cast<uint32_t>(close + 1 - i);
+                    step.hasField = true;
+                    step.named = colon > i + 1;
+                    pos = close + 1;
+                    return true;
+                }
+                ++i;
+            }
+            step.literalLength = static_cast<uint32_t>(len - pos);
+            pos = len;
+            return true;
+        }
+
+        constexpr size_t countFormatSteps(const char* p)
+        {
+            size_t len = patternLength(p);
+            size_t pos = 0;
+            size_t n = 0;
+            FormatStep step;
+            while (nextFormatStep(p, len, pos, step)) {
+                ++n;
+            }
+            return n;
+        }
+
+        // 字面量格式串中每个占位符都是 {} 或 {:说明符}，且说明符能完整解析
+        constexpr bool checkFormat(const char* p)
+        {
+            size_t len = patternLength(p);
+            size_t pos = 0;
+            FormatStep step;
+            while (nextFormatStep(p, len, pos, step)) {
+                if (step.hasField && (step.named || step.spec.malformed)) {
+                    return false;
+                }
+            }
+            return true;
+        }
+
+        // 只有字符串字面量能在编译期解析；std::string、const char* 等返回空指针，交给运行时解析
+        template <typename T>
+        constexpr const char* literalPattern(const T&)
+        {
+            return nullptr;
+        }
+
+        template <size_t N>
+        constexpr const char* literalPattern(const char (&pattern)[N])
+        {
+            return pattern;
+        }
+
+        // 仅用于 decltype：格式串之后的参数个数
+        template <typename P, typename... Args>
+        std::integral_constant<size_t, sizeof...(Args)> patternArgCount(P&&, Args&&...);
+
+        template <size_t N>
+        struct FormatSteps
+        {
+            FormatStep steps[N ? N : 1] = {};
+            uint32_t   count = 0;
+        };
+
+        template <size_t N>
+        constexpr FormatSteps<N> compileFormat(const char* p)
+        {
+            FormatSteps<N> r;
+            size_t len = patternLength(p);
+            size_t pos = 0;
+            FormatStep step;
+            while (nextFormatStep(p, len, pos, step)) {
+                r.steps[r.count++] = step;
+            }
+            return r;
+        }
+
+        // 按宽度与对齐补齐：prefix 为符号与进制前缀，补 0 时插在 prefix 与正文之间
+        inline void appendPadded(std::string& out, std::string_view prefix, std::string_view body,
+                                 const FormatSpec& spec, char defaultAlign)
+        {
+            size_t length = prefix.size() + body.size();
+            size_t pad = spec.width > 0 && static_cast<size_t>(spec.width) > length ? spec.width - length : 0;
+            if (pad && spec.zeroPad && spec.align == 0) {
+                out.append(prefix.data(), prefix.size());
+                out.append(pad, '0');
+                out.append(body.data(), body.size());
+                return;
+            }
+            char align = spec.align ? spec.align : defaultAlign;
+            size_t before = align == '>' ? pad : align == '^' ? pad / 2 : 0;
+            out.append(before, spec.fill);
+            out.append(prefix.data(), prefix.size());
+            out.append(body.data(), body.size());
+            out.append(pad - before, spec.fill);
+        }
+
+        inline void upperCase(char* begin, char* end)
+        {
+            for (char* p = begin; p != end; ++p) {
+                if (*p >= 'a' && *p <= 'z') {
+                    *p = static_cast<char>(*p - 'a' + 'A');
+                }
+            }
+        }
+
+        template <typename T>
+        inline void appendIntegerSpec(std::string& out, T v, const FormatSpec& spec)
+        {
+            using U = typename std::make_unsigned<T>::type;
+            bool negative = false;
+            U magnitude = static_cast<U>(v);
+            if constexpr (std::is_signed<T>::value) {
+                if (v < 0) {
+                    negative = true;
+                    magnitude = static_cast<U>(U(0) - magnitude);
+                }
+            }
+            int base = 10;
+            const char* alt = "";
+            switch (spec.type) {
+            case 'x': base = 16; alt = "0x"; break;
+            case 'X': base = 16; alt = "0X"; break;
+            case 'o': base = 8; alt = "0"; break;
+            case 'b': base = 2; alt = "0b"; break;
+            case 'B': base = 2; alt = "0B"; break;
+            default: break;
+            }
+            char digits[72];
+            auto r = std::to_chars(digits, digits + sizeof(digits), magnitude, base);
+            if (spec.type == 'X') {
+                upperCase(digits, r.ptr);
+            }
+            char prefix[4];
+            size_t n = 0;
+            if (negative) {
+                prefix[n++] = '-';
+            }
+            else if (spec.sign == '+' || spec.sign == ' ') {
+                prefix[n++] = spec.sign;
+            }
+            if (spec.alternate) {
+                for (const char* a = alt; *a; ++a) {
+                    prefix[n++] = *a;
+                }
+            }
+            appendPadded(out, std::string_view(prefix, n), std::string_view(digits, static_cast<size_t>(r.ptr - digits)),
+                         spec, '>');
+        }
+
+        template <typename T>
+        inline void appendFloatSpec(std::string& out, T v, const FormatSpec& spec)
+        {
+            char buf[512];
+            char* end = buf;
+#if defined(__cpp_lib_to_chars) && __cpp_lib_to_chars >= 201611L
+            std::to_chars_result r{};
+            switch (spec.type) {
+            case 'f': case 'F':
+                r = std::to_chars(buf, buf + sizeof(buf), v, std::chars_format::fixed, spec.precision < 0 ? 6 : spec.precision);
+                break;
+            case 'e': case 'E':
+                r = std::to_chars(buf, buf + sizeof(buf), v, std::chars_format::scientific, spec.precision < 0 ? 6 : spec.precision);
+                break;
+            case 'g': case 'G':
+                r = std::to_chars(buf, buf + sizeof(buf), v, std::chars_format::general, spec.precision < 0 ? 6 : spec.precision);
+                break;
+            default:
+                r = spec.precision < 0 ? std::to_chars(buf, buf + sizeof(buf), v)
+                                       : std::to_chars(buf, buf + sizeof(buf), v, std::chars_format::general, spec.precision);
+                break;
+            }
+            end = r.ec == std::errc() ? r.ptr : buf;
+#else
+            char format[8] = { '%', '.', '*', spec.type ? spec.type : 'g', '\0' };
+            int n = std::snprintf(buf, sizeof(buf), format,
+                                  spec.precision < 0 ? (spec.type ? 6 : std::numeric_limits<T>::max_digits10) : spec.precision,
+                                  static_cast<double>(v));
+            end = buf + (n > 0 && static_cast<size_t>(n) < sizeof(buf) ? n : 0);
+#endif
+            if (spec.type == 'F' || spec.type == 'E' || spec.type == 'G') {
+                upperCase(buf, end);
+            }
+            const char* body = buf;
+            char prefix[1];
+            size_t n = 0;
+            if (body != end && *body == '-') {
+                prefix[n++] = '-';
+                ++body;
+            }
+            else if (spec.sign == '+' || spec.sign == ' ') {
+                prefix[n++] = spec.sign;
+            }
+            appendPadded(out, std::string_view(prefix, n), std::string_view(body, static_cast<size_t>(end - body)),
+                         spec, '>');
+        }
+
+        // 按说明符格式化单个参数；没有说明符时直接走 Formatter
+        template <typename T>
+        inline void formatArgSpec(std::string& out, const T& v, const FormatSpec& spec)
+        {
+            using D = typename std::remove_cv<T>::type;
+            if (!spec.present) {
+                formatArg(out, v);
+            }
+            else if constexpr (std::is_integral<D>::value && !std::is_same<D, bool>::value) {
+                bool isChar = std::is_same<D, char>::value || std::is_same<D, signed char>::value ||
+                              std::is_same<D, unsigned char>::value;
+                if ((isChar && spec.type == 0) || spec.type == 'c') {
+                    char c = static_cast<char>(v);
+                    appendPadded(out, std::string_view(), std::string_view(&c, 1), spec, '<');
+                }
+                else {
+                    appendIntegerSpec(out, v, spec);
+                }
+            }
+            else if constexpr (std::is_floating_point<D>::value) {
+                appendFloatSpec(out, v, spec);
+            }
+            else if constexpr (std::is_pointer<D>::value &&
+                               !std::is_same<typename std::remove_cv<typename std::remove_pointer<D>::type>::type, char>::value) {
+                FormatSpec hex = spec;
+                hex.type = spec.type == 'X' ? 'X' : 'x';
+                hex.alternate = true;
+                appendIntegerSpec(out, reinterpret_cast<uintptr_t>(v), hex);
+            }
+            else {
+                std::string text;
+                formatArg(text, v);
+                std::string_view body(text);
+                if (spec.precision >= 0 && body.size() > static_cast<size_t>(spec.precision)) {
+                    body = body.substr(0, static_cast<size_t>(spec.precision));
+                }
+                appendPadded(out, std::string_view(), body, spec, '<');
+            }
+        }
+
+        // 执行编译期生成的程序；参数用完后剩余的占位符原样保留，多余的参数忽略
+        template <typename... Args>
+        inline void formatProgram(std::string& out, const FormatProgram& program, const Args&... args)
+        {
+            uint32_t i = 0;
+            auto emit = [&](const auto& arg) {
+                while (i < program.count) {
+                    const FormatStep& s = program.steps[i++];
+                    out.append(program.pattern + s.literalBegin, s.literalLength);
+                    if (s.hasField) {
+                        formatArgSpec(out, arg, s.spec);
+                        return;
+                    }
+                }
+            };
+            (emit(args), ...);
+            for (; i < program.count; ++i) {
+                const FormatStep& s = program.steps[i];
+                out.append(program.pattern + s.literalBegin, s.literalLength);
+                out.append(program.pattern + s.fieldBegin, s.hasField ? s.fieldLength : 0);
+            }
+        }
+
+        // 运行时格式串：边解析边输出，语义与 formatProgram 相同
+        template <typename... Args>
+        inline void formatTo(std::string& out, std::string_view pattern, const Args&... args)
+        {
+            size_t pos = 0;
+            FormatStep s;
+            auto emit = [&](const auto& arg) {
+                while (nextFormatStep(pattern.data(), pattern.size(), pos, s)) {
+                    out.append(pattern.data() + s.literalBegin, s.literalLength);
+                    if (s.hasField) {
+                        formatArgSpec(out, arg, s.spec);
+                        return;
+                    }
+                }
+            };
+            (emit(args), ...);
+            while (nextFormatStep(pattern.data(), pattern.size(), pos, s)) {
+                out.append(pattern.data() + s.literalBegin, s.literalLength);
+                out.append(pattern.data() + s.fieldBegin, s.hasField ? s.fieldLength : 0);
+            }
+        }
+        //***************************************************************
+
+    } // namespace LOG
+} // namespace beiklive
+
+#endif  // INC_LOG_FORMAT_HH_
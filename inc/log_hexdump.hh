@@ -0,0 +1,127 @@
+// Copyright (c) RealCoolEngineer. 2024. All rights reserved.
+// Author: beiklive
+// Date: 2024-05-27
+#ifndef INC_LOG_HEXDUMP_HH_
+#define INC_LOG_HEXDUMP_HH_
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include "log_format.hh"
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+namespace beiklive
+{
+    namespace LOG
+    {
+        // LOG_HEXDUMP 的参数：size 为实际记录的字节数，total 为调用方给出的原始长度
+        struct HexDump
+        {
+            const uint8_t* data;
+            uint32_t       size;
+            uint64_t       total;
+        };
+
+        // 16 字节编码为 32 个小写十六进制字符，以及 16 个 ASCII 列字符（不可打印的显示为 '.'）
+        inline void hexEncode16(const uint8_t* src, char* hex, char* ascii)
+        {
+#if defined(__SSE2__)
+            const __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src));
+            const __m128i mask = _mm_set1_epi8(0x0f);
+            const __m128i hi = _mm_and_si128(_mm_srli_epi16(v, 4), mask);
+            const __m128i lo = _mm_and_si128(v, mask);
+            // 半字节 n 映射为 '0' + n，n > 9 时再加 'a' - '0' - 10
+            const __m128i nine = _mm_set1_epi8(9);
+            const __m128i zero = _mm_set1_epi8('0');
+            const __m128i letter = _mm_set1_epi8('a' - '0' - 10);
+            const __m128i hiChar = _mm_add_epi8(_mm_add_epi8(hi, zero), _mm_and_si128(_mm_cmpgt_epi8(hi, nine), letter));
+            const __m128i loChar = _mm_add_epi8(_mm_add_epi8(lo, zero), _mm_and_si128(_mm_cmpgt_epi8(lo, nine), letter));
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(hex), _mm_unpacklo_epi8(hiChar, loChar));
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(hex + 16), _mm_unpackhi_epi8(hiChar, loChar));
+            // 有符号比较下 0x80 以上为负数，只有 0x20..0x7e 可打印
+            const __m128i printable = _mm_and_si128(_mm_cmpgt_epi8(v, _mm_set1_epi8(0x1f)),
+                                                    _mm_cmplt_epi8(v, _mm_set1_epi8(0x7f)));
+            const __m128i shown = _mm_or_si128(_mm_and_si128(printable, v), _mm_andnot_si128(printable, _mm_set1_epi8('.')));
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(ascii), shown);
+#else
+            static const char DIGITS[] = "0123456789abcdef";
+            for (int i = 0; i < 16; ++i) {
+                hex[2 * i] = DIGITS[src[i] >> 4];
+                hex[2 * i + 1] = DIGITS[src[i] & 0x0f];
+                ascii[i] = (src[i] >= 0x20 && src[i] < 0x7f) ? static_cast<char>(src[i]) : '.';
+            }
+#endif
+        }
+
+        // hexdump -C 的布局：偏移、两组各 8 字节的十六进制、|ASCII|，行之间以 '\n' 分隔
+        inline void appendHexDump(std::string& out, const uint8_t* data, size_t size)
+        {
+            static const char DIGITS[] = "0123456789abcdef";
+            const size_t LINE = 78;
+            size_t lines = (size + 15) / 16;
+            size_t begin = out.size();
+            out.resize(begin + lines * (LINE + 1) - (lines ? 1 : 0));
+            char* p = &out[begin];
+            for (size_t offset = 0; offset < size; offset += 16) {
+                char hex[32];
+                char ascii[16];
+                size_t n = size - offset < 16 ? size - offset : 16;
+                if (n == 16) {
+                    hexEncode16(data + offset, hex, ascii);
+                }
+                else {
+                    uint8_t tail[16] = {};
+                    std::memcpy(tail, data + offset, n);
+                    hexEncode16(tail, hex, ascii);
+                }
+                for (int i = 7; i >= 0; --i) {
+                    p[7 - i] = DIGITS[(offset >> (4 * i)) & 0x0f];
+                }
+                std::memset(p + 8, ' ', LINE - 8);
+                char* h = p + 10;
+                for (size_t i = 0; i < n; ++i) {
+                    h[0] = hex[2 * i];
+                    h[1] = hex[2 * i + 1];
+                    h += i == 7 ? 4 : 3;
+                }
+                p[60] = '|';
+                std::memcpy(p + 61, ascii, n);
+                p[61 + n] = '|';
+                p += 62 + n;
+                if (n < 16) {
+                    // 最后一行较短，去掉多余的空白
+                    out.resize(static_cast<size_t>(p - out.data()));
+                    return;
+                }
+                if (offset + 16 < size) {
+                    *p++ = '\n';
+                }
+            }
+        }
+
+        template <>
+        struct Formatter<HexDump>
+        {
+            static void write(std::string& out, const HexDump& v) {
+                out += "hexdump ";
+                appendInteger(out, v.total);
+                out += " bytes";
+                if (v.size < v.total) {
+                    out += " (first ";
+                    appendInteger(out, v.size);
+                    out += ")";
+                }
+                if (v.size) {
+                    out += '\n';
+                    appendHexDump(out, v.data, v.size);
+                }
+            }
+        };
+
+    } // namespace LOG
+} // namespace beiklive
+
+#endif  // INC_LOG_HEXDUMP_HH_
@@ -0,0 +1,164 @@
+// Copyright (c) RealCoolEngineer. 2024. All rights reserved.
+// Author: beiklive
+// Date: 2024-05-06
+#ifndef INC_LOG_INDEX_HH_
+#define INC_LOG_INDEX_HH_
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace beiklive
+{
+    namespace LOG
+    {
+        // 日志文件的时间索引：按固定秒数分桶，记录每个桶第一条日志在文件中的字节偏移。
+        // 桶只在出现更晚的时间时追加，因此某个时刻之后的日志不会出现在其桶偏移之前；
+        // 多线程写入造成的少量乱序由查询时的 slack 覆盖。
+        // 文件格式：8 字节 "BKLIDX01"，uint32 桶宽（秒），uint32 保留，随后为 {int64 秒, int64 偏移} 数组。
+        class TimeIndex {
+        public:
+            struct Entry
+            {
+                int64_t second;
+                int64_t offset;
+            };
+
+            static constexpr char MAGIC[8] = { 'B', 'K', 'L', 'I', 'D', 'X', '0', '1' };
+
+            explicit TimeIndex(uint32_t intervalSeconds = 1)
+                : interval(intervalSeconds ? intervalSeconds : 1) {}
+
+            // 记录一条日志：wallNs 为 Unix 纪元纳秒，offset 为该日志在文件中的起始位置
+            void observe(int64_t wallNs, int64_t offset) {
+                int64_t second = wallNs / 1000000000;
+                if (wallNs < 0 && wallNs % 1000000000 != 0) {
+                    --second;
+                }
+                int64_t bucket = second - ((second % interval) + interval) % interval;
+                if (entries.empty() || bucket > entries.back().second) {
+                    entries.push_back(Entry{ bucket, offset });
+                }
+            }
+
+            // 覆盖 [fromSecond, toSecond] 的字节范围 [begin, end)，end 为 -1 表示直到文件末尾；
+            // 返回 false 表示文件中没有该时间段的日志
+            bool range(int64_t fromSecond, int64_t toSecond, int64_t slackSeconds,
+                       int64_t* begin, int64_t* end) const {
+                if (entries.empty() || fromSecond > toSecond) {
+                    return false;
+                }
+                auto first = std::find_if(entries.begin(), entries.end(), [&](const Entry& e) {
+                    return e.second + static_cast<int64_t>(interval) > fromSecond;
+                });
+                if (first == entries.end() || first->second > toSecond) {
+                    return false;
+                }
+                int64_t limit = toSecond > INT64_MAX - slackSeconds ? INT64_MAX : toSecond + slackSeconds;
+                auto last = std::find_if(first, entries.end(), [&](const Entry& e) {
+                    return e.second > limit;
+                });
+                *begin = first->offset;
+                *end = last == entries.end() ? -1 : last->offset;
+                return true;
+            }
+
+            bool save(const std::string& path) const {
+                std::string tmp = path + ".tmp";
+                {
+                    std::ofstream out(tmp, std::ios::binary | std::ios::trunc);
+                    if (!out.is_open()) {
+                        return false;
+                    }
+                    uint32_t header[2] = { interval, 0 };
+                    out.write(MAGIC, sizeof(MAGIC));
+                    out.write(reinterpret_cast<const char*>(header), sizeof(header));
+                    out.write(reinterpret_cast<const char*>(entries.data()),
+                              static_cast<std::streamsize>(entries.size() * sizeof(Entry)));
+                    if (!out) {
+                        return false;
+                    }
+                }
+                return std::rename(tmp.c_str(), path.c_str()) == 0;
+            }
+
+            bool load(const std::string& path) {
+                entries.clear();
+                std::ifstream in(path, std::ios::binary);
+                char magic[sizeof(MAGIC)];
+                uint32_t header[2];
+                if (!in.read(magic, sizeof(magic)) || std::memcmp(magic, MAGIC, sizeof(MAGIC)) != 0 ||
+                    !in.read(reinterpret_cast<char*>(header), sizeof(header)) || header[0] == 0) {
+                    return false;
+                }
+                interval = header[0];
+                Entry e;
+                while (in.read(reinterpret_cast<char*>(&e), sizeof(e))) {
+                    entries.push_back(e);
+                }
+                return true;
+            }
+
+            void clear() { entries.clear(); }
+            bool empty() const { return entries.empty(); }
+            uint32_t intervalSeconds() const { return interval; }
+            const std::vector<Entry>& data() const { return entries; }
+
+        private:
+            uint32_t interval;
+            std::vector<Entry> entries;
+        };
+
+        // 运行目录与文件名都以创建时间（%Y%m%d_%H_%M_%S_mmm，21 个字符）命名，时间在文件名末尾，
+        // 前面可能带有 shard_<pid>_<tid>_、<pid>_<实例序号>_ 等前缀。
+        // 先按运行目录、再按文件名中的时间排序，与输入目录的路径及文件名前缀无关
+        constexpr size_t LOG_STAMP_LENGTH = 21;
+
+        inline std::string logNameStamp(const std::string& name)
+        {
+            return name.size() > LOG_STAMP_LENGTH ? name.substr(name.size() - LOG_STAMP_LENGTH) : name;
+        }
+
+        inline bool logFileBefore(const std::string& a, const std::string& b)
+        {
+            const std::filesystem::path pa(a);
+            const std::filesystem::path pb(b);
+            const std::string ca = pa.parent_path().filename().string();
+            const std::string cb = pb.parent_path().filename().string();
+            if (ca != cb) {
+                return ca < cb;
+            }
+            const std::string sa = logNameStamp(pa.stem().string());
+            const std::string sb = logNameStamp(pb.stem().string());
+            if (sa != sb) {
+                return sa < sb;
+            }
+            return a < b;
+        }
+
+        // 日志目录下按时间顺序排列的 .log 文件
+        inline std::vector<std::string> listLogFiles(const std::vector<std::string>& dirs)
+        {
+            std::vector<std::string> files;
+            for (const auto& dir : dirs) {
+                std::error_code ec;
+                for (auto& entry : std::filesystem::recursive_directory_iterator(dir, ec)) {
+                    if (entry.is_regular_file() && entry.path().extension() == ".log") {
+                        files.push_back(entry.path().string());
+                    }
+                }
+            }
+            std::sort(files.begin(), files.end(), logFileBefore);
+            return files;
+        }
+
+    } // namespace LOG
+} // namespace beiklive
+
+#endif  // INC_LOG_INDEX_HH_
@@ -0,0 +1,374 @@
+// Copyright (c) RealCoolEngineer. 2024. All rights reserved.
+// Author: beiklive
+// Date: 2024-04-08
+#ifndef INC_LOG_METRICS_HH_
+#define INC_LOG_METRICS_HH_
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <sstream>
+#include <string>
+#include <thread>
+
+namespace beiklive
+{
+    namespace LOG
+    {
+        // 与 LOGLEVEL 的枚举顺序一致
+        constexpr size_t LEVEL_COUNT = 4;
+        constexpr const char* LEVEL_NAMES[LEVEL_COUNT] = { "ERROR", "WARNING", "INFO", "DEBUG" };
+
+        enum class SINK
+        {
+            CONSOLE,
+            FILE,
+            SOCKET,
+            COUNT
+        };
+        constexpr size_t SINK_COUNT = static_cast<size_t>(SINK::COUNT);
+        constexpr const char* SINK_NAMES[SINK_COUNT] = { "console", "file", "socket" };
+
+        // HDR 风格直方图: 每个 2 的幂区间线性划分为 32 个子桶，相对误差约 3%
+        class LatencyHistogram {
+        public:
+            static constexpr int SUB_BUCKET_BITS = 5;
+            static constexpr uint64_t SUB_BUCKETS = 1ull << SUB_BUCKET_BITS;
+            static constexpr int MAX_SHIFT = 42;
+            static constexpr size_t BUCKET_COUNT = SUB_BUCKETS + (MAX_SHIFT + 1) * SUB_BUCKETS;
+
+            LatencyHistogram() { reset(); }
+
+            static size_t indexOf(uint64_t value) {
+                if (value < SUB_BUCKETS) {
+                    return static_cast<size_t>(value);
+                }
+                int msb = 63 - __builtin_clzll(value);
+                int shift = msb - SUB_BUCKET_BITS;
+                if (shift > MAX_SHIFT) {
+                    return BUCKET_COUNT - 1;
+                }
+                uint64_t top = value >> shift;
+                return static_cast<size_t>(SUB_BUCKETS + shift * SUB_BUCKETS + (top - SUB_BUCKETS));
+            }
+
+            // 桶内最大值，用于百分位估计（偏保守）
+            static uint64_t upperBoundOf(size_t index) {
+                if (index < SUB_BUCKETS) {
+                    return index;
+                }
+                uint64_t shift = (index - SUB_BUCKETS) / SUB_BUCKETS;
+                uint64_t top = SUB_BUCKETS + (index - SUB_BUCKETS) % SUB_BUCKETS;
+                return ((top + 1) << shift) - 1;
+            }
+
+            void record(uint64_t value) {
+                counts[indexOf(value)].fetch_add(1, std::memory_order_relaxed);
+                total.fetch_add(1, std::memory_order_relaxed);
+                sum.fetch_add(value, std::memory_order_relaxed);
+                uint64_t cur = maxValue.load(std::memory_order_relaxed);
+                while (value > cur && !maxValue.compare_exchange_weak(cur, value, std::memory_order_relaxed)) {}
+                cur = minValue.load(std::memory_order_relaxed);
+                while (value < cur && !minValue.compare_exchange_weak(cur, value, std::memory_order_relaxed)) {}
+            }
+
+            void merge(const LatencyHistogram& other) {
+                for (size_t i = 0; i < BUCKET_COUNT; ++i) {
+                    uint64_t c = other.counts[i].load(std::memory_order_relaxed);
+                    if (c) {
+                        counts[i].fetch_add(c, std::memory_order_relaxed);
+                    }
+                }
+                total.fetch_add(other.count(), std::memory_order_relaxed);
+                sum.fetch_add(other.sum.load(std::memory_order_relaxed), std::memory_order_relaxed);
+                uint64_t v = other.maxValue.load(std::memory_order_relaxed);
+                uint64_t cur = maxValue.load(std::memory_order_relaxed);
+                while (v > cur && !maxValue.compare_exchange_weak(cur, v, std::memory_order_relaxed)) {}
+                v = other.minValue.load(std::memory_order_relaxed);
+                cur = minValue.load(std::memory_order_relaxed);
+                while (v < cur && !minValue.compare_exchange_weak(cur, v, std::memory_order_relaxed)) {}
+            }
+
+            // 把计数移入 dst 并清零，可与 record 并发：每个桶的计数不会丢失或重复
+            void drainInto(LatencyHistogram& dst) {
+                uint64_t n = 0;
+                for (size_t i = 0; i < BUCKET_COUNT; ++i) {
+                    uint64_t c = counts[i].exchange(0, std::memory_order_relaxed);
+                    if (c) {
+                        dst.counts[i].fetch_add(c, std::memory_order_relaxed);
+                        n += c;
+                    }
+                }
+                if (n == 0) {
+                    return;
+                }
+                total.fetch_sub(n, std::memory_order_relaxed);
+                dst.total.fetch_add(n, std::memory_order_relaxed);
+                uint64_t v = sum.exchange(0, std::memory_order_relaxed);
+                dst.sum.fetch_add(v, std::memory_order_relaxed);
+                v = maxValue.exchange(0, std::memory_order_relaxed);
+                uint64_t cur = dst.maxValue.load(std::memory_order_relaxed);
+                while (v > cur && !dst.maxValue.compare_exchange_weak(cur, v, std::memory_order_relaxed)) {}
+                v = minValue.exchange(UINT64_MAX, std::memory_order_relaxed);
+                cur = dst.minValue.load(std::memory_order_relaxed);
+                while (v < cur && !dst.minValue.compare_exchange_weak(cur, v, std::memory_order_relaxed)) {}
+            }
+
+            void reset() {
+                for (auto& c : counts) {
+                    c.store(0, std::memory_order_relaxed);
+                }
+                total.store(0, std::memory_order_relaxed);
+                sum.store(0, std::memory_order_relaxed);
+                maxValue.store(0, std::memory_order_relaxed);
+                minValue.store(UINT64_MAX, std::memory_order_relaxed);
+            }
+
+            uint64_t count() const { return total.load(std::memory_order_relaxed); }
+            uint64_t max() const { return maxValue.load(std::memory_order_relaxed); }
+            uint64_t min() const { return count() ? minValue.load(std::memory_order_relaxed) : 0; }
+            double mean() const {
+                uint64_t n = count();
+                return n ? static_cast<double>(sum.load(std::memory_order_relaxed)) / n : 0.0;
+            }
+
+            // q 取值 [0, 1]
+            uint64_t percentile(double q) const {
+                uint64_t n = count();
+                if (n == 0) {
+                    return 0;
+                }
+                uint64_t rank = static_cast<uint64_t>(q * n);
+                if (rank >= n) {
+                    rank = n - 1;
+                }
+                uint64_t seen = 0;
+                for (size_t i = 0; i < BUCKET_COUNT; ++i) {
+                    seen += counts[i].load(std::memory_order_relaxed);
+                    if (seen > rank) {
+                        uint64_t upper = upperBoundOf(i);
+                        return upper < max() ? upper : max();
+                    }
+                }
+                return max();
+            }
+
+        private:
+            std::array<std::atomic<uint64_t>, BUCKET_COUNT> counts;
+            std::atomic<uint64_t> total;
+            std::atomic<uint64_t> sum;
+            std::atomic<uint64_t> maxValue;
+            std::atomic<uint64_t> minValue;
+        };
+
+        struct LatencySummary
+        {
+            uint64_t count = 0;
+            uint64_t min = 0;
+            uint64_t p50 = 0;
+            uint64_t p99 = 0;
+            uint64_t p999 = 0;
+            uint64_t max = 0;
+            double   mean = 0.0;
+
+            // scale 把直方图的原始单位换算为输出单位（如 TSC tick -> ns）
+            static LatencySummary of(const LatencyHistogram& h, double scale = 1.0) {
+                LatencySummary s;
+                s.count = h.count();
+                s.min = scaled(h.min(), scale);
+                s.p50 = scaled(h.percentile(0.50), scale);
+                s.p99 = scaled(h.percentile(0.99), scale);
+                s.p999 = scaled(h.percentile(0.999), scale);
+                s.max = scaled(h.max(), scale);
+                s.mean = h.mean() * scale;
+                return s;
+            }
+
+        private:
+            static uint64_t scaled(uint64_t v, double scale) {
+                return static_cast<uint64_t>(static_cast<double>(v) * scale);
+            }
+        };
+
+        struct MetricsSnapshot
+        {
+            std::array<uint64_t, LEVEL_COUNT> levelRecords{};
+            std::array<uint64_t, LEVEL_COUNT> levelBytes{};
+            std::array<uint64_t, SINK_COUNT>  sinkRecords{};
+            std::array<uint64_t, SINK_COUNT>  sinkBytes{};
+            int64_t  queueDepth = 0;         // 异步队列中待写出的记录数，取快照时由各队列的计数得到
+            int64_t  queuePeak = 0;          // 后台观察到的最大积压
+            uint64_t dropped = 0;
+            uint64_t rotations = 0;
+            LatencySummary callerLatencyNs;
+            LatencySummary queueLatencyNs;   // 异步模式下记录从入队到被后台取出的时间
+            LatencySummary rotationNs;
+            LatencySummary flushNs;
+
+            std::string toString() const {
+                std::stringstream ss;
+                ss << "records{";
+                for (size_t i = 0; i < LEVEL_COUNT; ++i) {
+                    ss << (i ? " " : "") << LEVEL_NAMES[i] << "=" << levelRecords[i] << "/" << levelBytes[i] << "B";
+                }
+                ss << "} sinks{";
+                for (size_t i = 0; i < SINK_COUNT; ++i) {
+                    ss << (i ? " " : "") << SINK_NAMES[i] << "=" << sinkRecords[i] << "/" << sinkBytes[i] << "B";
+                }
+                ss << "} queue=" << queueDepth << " peak=" << queuePeak
+                   << " dropped=" << dropped << " rotations=" << rotations;
+                appendSummary(ss, " caller_ns", callerLatencyNs);
+                appendSummary(ss, " queue_ns", queueLatencyNs);
+                appendSummary(ss, " rotation_ns", rotationNs);
+                appendSummary(ss, " flush_ns", flushNs);
+                return ss.str();
+            }
+
+            std::string toJson() const {
+                std::stringstream ss;
+                ss << "{\"levels\":{";
+                for (size_t i = 0; i < LEVEL_COUNT; ++i) {
+                    ss << (i ? "," : "") << "\"" << LEVEL_NAMES[i] << "\":{\"records\":" << levelRecords[i]
+                       << ",\"bytes\":" << levelBytes[i] << "}";
+                }
+                ss << "},\"sinks\":{";
+                for (size_t i = 0; i < SINK_COUNT; ++i) {
+                    ss << (i ? "," : "") << "\"" << SINK_NAMES[i] << "\":{\"records\":" << sinkRecords[i]
+                       << ",\"bytes\":" << sinkBytes[i] << "}";
+                }
+                ss << "},\"queue_depth\":" << queueDepth << ",\"queue_peak\":" << queuePeak
+                   << ",\"dropped\":" << dropped << ",\"rotations\":" << rotations;
+                appendSummaryJson(ss, "caller_latency_ns", callerLatencyNs);
+                appendSummaryJson(ss, "queue_latency_ns", queueLatencyNs);
+                appendSummaryJson(ss, "rotation_ns", rotationNs);
+                appendSummaryJson(ss, "flush_ns", flushNs);
+                ss << "}";
+                return ss.str();
+            }
+
+        private:
+            static void appendSummary(std::stringstream& ss, const char* name, const LatencySummary& s) {
+                ss << name << "{n=" << s.count << " p50=" << s.p50 << " p99=" << s.p99
+                   << " p999=" << s.p999 << " max=" << s.max << "}";
+            }
+
+            static void appendSummaryJson(std::stringstream& ss, const char* name, const LatencySummary& s) {
+                ss << ",\"" << name << "\":{\"count\":" << s.count << ",\"min\":" << s.min
+                   << ",\"mean\":" << s.mean << ",\"p50\":" << s.p50 << ",\"p99\":" << s.p99
+                   << ",\"p999\":" << s.p999 << ",\"max\":" << s.max << "}";
+            }
+        };
+
+        // 日志模块自身的运行指标，计数器按线程分片以避免多线程争用同一缓存行
+        class LoggerMetrics {
+        public:
+            static constexpr size_t SHARDS = 16;
+
+            void countRecord(size_t level, size_t bytes) {
+                Shard& s = shard();
+                s.levelRecords[level].fetch_add(1, std::memory_order_relaxed);
+                s.levelBytes[level].fetch_add(bytes, std::memory_order_relaxed);
+            }
+
+            void countSink(SINK sink, size_t bytes) {
+                Shard& s = shard();
+                size_t i = static_cast<size_t>(sink);
+                s.sinkRecords[i].fetch_add(1, std::memory_order_relaxed);
+                s.sinkBytes[i].fetch_add(bytes, std::memory_order_relaxed);
+            }
+
+            void countDropped(uint64_t n = 1) {
+                dropped.fetch_add(n, std::memory_order_relaxed);
+            }
+
+            // 每个线程每 sampleEvery 次调用采样一次调用方耗时
+            bool shouldSample() {
+                thread_local uint32_t counter = 0;
+                uint32_t every = sampleEvery.load(std::memory_order_relaxed);
+                return every != 0 && (++counter % every) == 0;
+            }
+
+            void setSampleEvery(uint32_t every) {
+                sampleEvery.store(every, std::memory_order_relaxed);
+            }
+
+            // 耗时以 TSC tick 记录，生产者侧不做换算
+            void recordCallerLatency(uint64_t ticks) { callerLatency.record(ticks); }
+            void recordRotation(uint64_t ticks) {
+                rotations.fetch_add(1, std::memory_order_relaxed);
+                rotationLatency.record(ticks);
+            }
+            void recordFlush(uint64_t ticks) { flushLatency.record(ticks); }
+            // 只由后台线程记录，已换算为纳秒
+            void recordQueueLatency(uint64_t ns) { queueLatency.record(ns); }
+
+            // nsPerTick 为 TSC 校准系数
+            MetricsSnapshot snapshot(double nsPerTick = 1.0) const {
+                MetricsSnapshot snap;
+                for (const Shard& s : shards) {
+                    for (size_t i = 0; i < LEVEL_COUNT; ++i) {
+                        snap.levelRecords[i] += s.levelRecords[i].load(std::memory_order_relaxed);
+                        snap.levelBytes[i] += s.levelBytes[i].load(std::memory_order_relaxed);
+                    }
+                    for (size_t i = 0; i < SINK_COUNT; ++i) {
+                        snap.sinkRecords[i] += s.sinkRecords[i].load(std::memory_order_relaxed);
+                        snap.sinkBytes[i] += s.sinkBytes[i].load(std::memory_order_relaxed);
+                    }
+                }
+                snap.dropped = dropped.load(std::memory_order_relaxed);
+                snap.rotations = rotations.load(std::memory_order_relaxed);
+                snap.callerLatencyNs = LatencySummary::of(callerLatency, nsPerTick);
+                snap.queueLatencyNs = LatencySummary::of(queueLatency);
+                snap.rotationNs = LatencySummary::of(rotationLatency, nsPerTick);
+                snap.flushNs = LatencySummary::of(flushLatency, nsPerTick);
+                return snap;
+            }
+
+            void reset() {
+                for (Shard& s : shards) {
+                    for (size_t i = 0; i < LEVEL_COUNT; ++i) {
+                        s.levelRecords[i].store(0, std::memory_order_relaxed);
+                        s.levelBytes[i].store(0, std::memory_order_relaxed);
+                    }
+                    for (size_t i = 0; i < SINK_COUNT; ++i) {
+                        s.sinkRecords[i].store(0, std::memory_order_relaxed);
+                        s.sinkBytes[i].store(0, std::memory_order_relaxed);
+                    }
+                }
+                dropped.store(0, std::memory_order_relaxed);
+                rotations.store(0, std::memory_order_relaxed);
+                callerLatency.reset();
+                queueLatency.reset();
+                rotationLatency.reset();
+                flushLatency.reset();
+            }
+
+        private:
+            struct alignas(64) Shard
+            {
+                std::array<std::atomic<uint64_t>, LEVEL_COUNT> levelRecords{};
+                std::array<std::atomic<uint64_t>, LEVEL_COUNT> levelBytes{};
+                std::array<std::atomic<uint64_t>, SINK_COUNT>  sinkRecords{};
+                std::array<std::atomic<uint64_t>, SINK_COUNT>  sinkBytes{};
+            };
+
+            Shard& shard() {
+                thread_local size_t index = std::hash<std::thread::id>()(std::this_thread::get_id()) % SHARDS;
+                return shards[index];
+            }
+
+            std::array<Shard, SHARDS> shards;
+            alignas(64) std::atomic<uint64_t> dropped{ 0 };
+            std::atomic<uint64_t> rotations{ 0 };
+            std::atomic<uint32_t> sampleEvery{ 8 };
+            LatencyHistogram callerLatency;
+            LatencyHistogram queueLatency;
+            LatencyHistogram rotationLatency;
+            LatencyHistogram flushLatency;
+        };
+
+    } // namespace LOG
+} // namespace beiklive
+
+#endif  // INC_LOG_METRICS_HH_
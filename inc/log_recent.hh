@@ -0,0 +1,341 @@
+// Copyright (c) RealCoolEngineer. 2024. All rights reserved.
+// Author: beiklive
+// Date: 2024-06-02
+#ifndef INC_LOG_RECENT_HH_
+#define INC_LOG_RECENT_HH_
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <climits>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <functional>
+#include <iostream>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+#ifdef __linux__
+#include <poll.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#include "log_socket.hh"
+#endif
+
+namespace beiklive
+{
+    namespace LOG
+    {
+        // 对最近记录的查询条件
+        struct RecentQuery
+        {
+            int         maxLevel = 3;           // 不低于该级别（LOGLEVEL 数值越小越严重）
+            int64_t     fromNs = INT64_MIN;     // Unix 纪元纳秒，闭区间
+            int64_t     toNs = INT64_MAX;
+            std::string contains;               // 为空时不按内容过滤
+            size_t      limit = 0;              // 只取最新的 limit 条，0 表示全部
+
+            // 解析一行请求："level=W since=60s grep=connection reset"。
+            // 可用的键：level=E|W|I|D，since=<数值><s|m|h>，from= / to= 为 Unix 秒（可带小数），
+            // limit=N，grep= 取到行尾（可含空格）
+            static bool parse(std::string_view text, int64_t nowNs, RecentQuery* query, std::string* error) {
+                RecentQuery q;
+                while (!text.empty()) {
+                    size_t skip = text.find_first_not_of(" \t\r\n");
+                    if (skip == std::string_view::npos) {
+                        break;
+                    }
+                    text.remove_prefix(skip);
+                    if (text.compare(0, 5, "grep=") == 0) {
+                        std::string_view rest = text.substr(5);
+                        size_t end = rest.find_last_not_of(" \t\r\n");
+                        q.contains = std::string(rest.substr(0, end == std::string_view::npos ? 0 : end + 1));
+                        break;
+                    }
+                    size_t end = std::min(text.find_first_of(" \t\r\n"), text.size());
+                    std::string_view token = text.substr(0, end);
+                    text.remove_prefix(end);
+                    size_t eq = token.find('=');
+                    std::string key(token.substr(0, eq));
+                    std::string value(eq == std::string_view::npos ? std::string_view() : token.substr(eq + 1));
+                    char* tail = nullptr;
+                    if (key == "level") {
+                        const char* letters = "EWID";
+                        const char* at = value.empty() ? nullptr : std::strchr(letters, value[0]);
+                        if (!at) {
+                            return fail(error, "bad level " + value);
+                        }
+                        q.maxLevel = static_cast<int>(at - letters);
+                    }
+                    else if (key == "since") {
+                        double amount = std::strtod(value.c_str(), &tail);
+                        double unit = *tail == 'h' ? 3600 : *tail == 'm' ? 60 : 1;
+                        if (tail == value.c_str() || (*tail != '\0' && std::strchr("smh", *tail) == nullptr)) {
+                            return fail(error, "bad since " + value);
+                        }
+                        q.fromNs = nowNs - static_cast<int64_t>(amount * unit * 1e9);
+                    }
+                    else if (key == "from" || key == "to") {
+                        double seconds = std::strtod(value.c_str(), &tail);
+                        if (tail == value.c_str() || *tail != '\0') {
+                            return fail(error, "bad " + key + " " + value);
+                        }
+                        (key == "from" ? q.fromNs : q.toNs) = static_cast<int64_t>(seconds * 1e9);
+                    }
+                    else if (key == "limit") {
+                        q.limit = static_cast<size_t>(std::strtoull(value.c_str(), &tail, 10));
+                        if (tail == value.c_str() || *tail != '\0') {
+                            return fail(error, "bad limit " + value);
+                        }
+                    }
+                    else {
+                        return fail(error, "unknown key " + key);
+                    }
+                }
+                *query = q;
+                return true;
+            }
+
+        private:
+            static bool fail(std::string* error, const std::string& message) {
+                if (error) {
+                    *error = message;
+                }
+                return false;
+            }
+        };
+
+        // 最近记录的内存索引：固定大小的字节环，新记录覆盖最旧的记录。
+        // 每条为 16 字节头加一行日志文本，按 16 字节对齐且不跨越环尾，环尾放不下时写一个回绕标记。
+        class RecentLog {
+        public:
+            // bytes 为 0 时关闭并释放内存；非 0 时至少 MIN_CAPACITY，容量不变时保留已有的记录
+            void configure(size_t bytes) {
+                std::lock_guard<std::mutex> lock(mutex);
+                bytes = bytes == 0 ? 0 : std::max(bytes / ALIGN * ALIGN, MIN_CAPACITY);
+                if (bytes == buffer.size()) {
+                    active.store(bytes != 0, std::memory_order_relaxed);
+                    return;
+                }
+                buffer.assign(bytes, 0);
+                buffer.shrink_to_fit();
+                head = tail = 0;
+                records = 0;
+                active.store(bytes != 0, std::memory_order_relaxed);
+            }
+
+            bool enabled() const { return active.load(std::memory_order_relaxed); }
+
+            // fork 前持有环的锁，子进程不会继承一把被其他线程锁住的互斥量
+            void lockForFork() { mutex.lock(); }
+            void unlockAfterFork() { mutex.unlock(); }
+
+            void append(int64_t wallNs, int level, std::string_view line) {
+                std::lock_guard<std::mutex> lock(mutex);
+                const size_t capacity = buffer.size();
+                if (capacity == 0) {
+                    return;
+                }
+                line = line.substr(0, std::min(line.size(), capacity / 4));   // 过长的行截断
+                const size_t size = alignUp(sizeof(Header) + line.size());
+                size_t offset = static_cast<size_t>(head % capacity);
+                if (offset + size > capacity) {
+                    reserve(capacity - offset);
+                    writeHeader(offset, Header{ 0, WRAP, 0, {} });
+                    head += capacity - offset;
+                    offset = 0;
+                }
+                reserve(size);
+                writeHeader(offset, Header{ wallNs, static_cast<uint32_t>(line.size()), static_cast<uint8_t>(level), {} });
+                std::memcpy(buffer.data() + offset + sizeof(Header), line.data(), line.size());
+                head += size;
+                ++records;
+            }
+
+            // 按时间顺序（即写入顺序）取出满足条件的行
+            std::vector<std::string> query(const RecentQuery& q) const {
+                std::vector<std::string> out;
+                std::lock_guard<std::mutex> lock(mutex);
+                const size_t capacity = buffer.size();
+                for (uint64_t pos = tail; pos < head;) {
+                    size_t offset = static_cast<size_t>(pos % capacity);
+                    Header h;
+                    std::memcpy(&h, buffer.data() + offset, sizeof(h));
+                    if (h.length == WRAP) {
+                        pos += capacity - offset;
+                        continue;
+                    }
+                    pos += alignUp(sizeof(Header) + h.length);
+                    if (h.level > q.maxLevel || h.wallNs < q.fromNs || h.wallNs > q.toNs) {
+                        continue;
+                    }
+                    std::string_view line(buffer.data() + offset + sizeof(Header), h.length);
+                    if (!q.contains.empty() && line.find(q.contains) == std::string_view::npos) {
+                        continue;
+                    }
+                    out.emplace_back(line);
+                }
+                if (q.limit != 0 && out.size() > q.limit) {
+                    out.erase(out.begin(), out.end() - static_cast<std::ptrdiff_t>(q.limit));
+                }
+                return out;
+            }
+
+            // 当前保留的记录数
+            size_t size() const {
+                std::lock_guard<std::mutex> lock(mutex);
+                return records;
+            }
+
+        private:
+            static constexpr size_t ALIGN = 16;
+            static constexpr uint32_t WRAP = UINT32_MAX;
+
+            struct Header
+            {
+                int64_t  wallNs;
+                uint32_t length;    // WRAP 表示此处到环尾为空
+                uint8_t  level;
+                uint8_t  reserved[3];
+            };
+            static_assert(sizeof(Header) == ALIGN, "record header must be one alignment unit");
+            // 单条记录最长为容量的 1/4 加头部与对齐，环至少要能放下它与一个回绕标记
+            static constexpr size_t MIN_CAPACITY = 4 * (sizeof(Header) + ALIGN);
+
+            static size_t alignUp(size_t n) { return (n + ALIGN - 1) / ALIGN * ALIGN; }
+
+            void writeHeader(size_t offset, const Header& h) {
+                std::memcpy(buffer.data() + offset, &h, sizeof(h));
+            }
+
+            // 淘汰最旧的记录，直到能再写入 bytes 字节
+            void reserve(size_t bytes) {
+                const size_t capacity = buffer.size();
+                while (head + bytes - tail > capacity) {
+                    size_t offset = static_cast<size_t>(tail % capacity);
+                    Header h;
+                    std::memcpy(&h, buffer.data() + offset, sizeof(h));
+                    if (h.length == WRAP) {
+                        tail += capacity - offset;
+                    }
+                    else {
+                        tail += alignUp(sizeof(Header) + h.length);
+                        --records;
+                    }
+                }
+            }
+
+            mutable std::mutex mutex;
+            std::vector<char>  buffer;
+            uint64_t           head = 0;     // 单调递增的写入位置
+            uint64_t           tail = 0;     // 最旧记录的位置
+            size_t             records = 0;
+            std::atomic<bool>  active{ false };
+        };
+
+#ifdef __linux__
+        // 本地查询端点：每个连接发送一行请求，返回匹配的日志行后关闭连接。
+        //   echo "level=W since=60s" | nc -U /run/app/log.query
+        class RecentServer {
+        public:
+            using Handler = std::function<std::string(std::string_view request)>;
+
+            ~RecentServer() { stop(); }
+
+            // 已在 path 上监听时不做任何事；换用新路径时新端点就绪后才关闭旧端点，失败时保持原样
+            bool start(const std::string& path, Handler onRequest) {
+                if (worker.joinable() && path == socketPath) {
+                    return true;
+                }
+                std::string error;
+                int fd = openEndpoint("unix:" + path, true, &error);
+                if (fd < 0) {
+                    std::cerr << "Error listening on " << error << std::endl;
+                    return false;
+                }
+                stop();
+                listenFd = fd;
+                socketPath = path;
+                handler = std::move(onRequest);
+                stopping.store(false, std::memory_order_relaxed);
+                worker = std::thread([this]() { run(); });
+                return true;
+            }
+
+            void stop() {
+                stopping.store(true, std::memory_order_relaxed);
+                if (worker.joinable()) {
+                    worker.join();
+                }
+                if (listenFd >= 0) {
+                    ::close(listenFd);
+                    listenFd = -1;
+                    ::unlink(socketPath.c_str());
+                }
+            }
+
+            // fork 出的子进程中服务线程并不存在；监听套接字仍归父进程所有，不删除其路径
+            void abandonAfterFork() {
+                abandonThreadAfterFork(worker);
+                if (listenFd >= 0) {
+                    ::close(listenFd);
+                    listenFd = -1;
+                }
+            }
+
+        private:
+            // 读到换行或对端关闭写端为止，最多等待 1 秒
+            static std::string readRequest(int fd) {
+                std::string request;
+                char chunk[512];
+                struct pollfd p{ fd, POLLIN, 0 };
+                while (request.find('\n') == std::string::npos && request.size() < 4096 && ::poll(&p, 1, 1000) > 0) {
+                    ssize_t n = ::read(fd, chunk, sizeof(chunk));
+                    if (n <= 0) {
+                        break;
+                    }
+                    request.append(chunk, static_cast<size_t>(n));
+                }
+                return request.substr(0, request.find('\n'));
+            }
+
+            void run() {
+                while (!stopping.load(std::memory_order_relaxed)) {
+                    struct pollfd p{ listenFd, POLLIN, 0 };
+                    if (::poll(&p, 1, 50) <= 0) {
+                        continue;
+                    }
+                    int fd = ::accept4(listenFd, nullptr, nullptr, SOCK_CLOEXEC);
+                    if (fd < 0) {
+                        continue;
+                    }
+                    std::string response = handler(readRequest(fd));
+                    const char* data = response.data();
+                    size_t left = response.size();
+                    while (left > 0) {
+                        ssize_t w = ::send(fd, data, left, MSG_NOSIGNAL);
+                        if (w <= 0) {
+                            break;
+                        }
+                        data += w;
+                        left -= static_cast<size_t>(w);
+                    }
+                    ::close(fd);
+                }
+            }
+
+            int listenFd = -1;
+            std::string socketPath;
+            Handler handler;
+            std::thread worker;
+            std::atomic<bool> stopping{ false };
+        };
+#endif
+
+    } // namespace LOG
+} // namespace beiklive
+
+#endif  // INC_LOG_RECENT_HH_
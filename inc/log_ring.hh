@@ -0,0 +1,152 @@
+// Copyright (c) RealCoolEngineer. 2024. All rights reserved.
+// Author: beiklive
+// Date: 2024-04-15
+#ifndef INC_LOG_RING_HH_
+#define INC_LOG_RING_HH_
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+namespace beiklive
+{
+    namespace LOG
+    {
+        // 单生产者/单消费者的变长字节环形队列。
+        // 每条记录前有 8 字节帧头（长度 + 填充标记），记录按 8 字节对齐且在内存中连续；
+        // 尾部放不下时写入填充帧并回绕到开头。
+        class SpscRing {
+        public:
+            static constexpr size_t FRAME_HEADER = 8;
+
+            // 生产者/消费者共享的读写位置，可放在共享内存中供不同进程各自建立视图
+            struct Cursor
+            {
+                alignas(64) std::atomic<uint64_t> head{ 0 };
+                alignas(64) std::atomic<uint64_t> tail{ 0 };
+            };
+
+            // capacity 必须是 2 的幂，memory 由调用方持有；shared 为空时使用内部的 Cursor
+            SpscRing(char* memory, size_t capacity, Cursor* shared = nullptr)
+                : buffer(memory), cap(capacity), mask(capacity - 1), cursor(shared ? shared : &own) {
+                writePos = pendingPos = cachedHead = cursor->head.load(std::memory_order_acquire);
+                readPos = cachedTail = cursor->tail.load(std::memory_order_acquire);
+            }
+
+            SpscRing(const SpscRing&) = delete;
+            SpscRing& operator=(const SpscRing&) = delete;
+
+            static size_t alignUp(size_t n) { return (n + 7) & ~size_t(7); }
+
+            // 单条记录允许的最大负载
+            size_t maxPayload() const { return cap / 2 - FRAME_HEADER; }
+
+            // 生产者：预留 bytes 字节的连续空间，空间不足返回 nullptr
+            char* reserve(size_t bytes) {
+                size_t frame = alignUp(bytes + FRAME_HEADER);
+                if (frame > cap / 2) {
+                    return nullptr;
+                }
+                uint64_t pos = writePos;
+                size_t offset = static_cast<size_t>(pos & mask);
+                size_t contiguous = cap - offset;
+                size_t need = frame > contiguous ? contiguous + frame : frame;
+                if (cap - (pos - cachedTail) < need) {
+                    cachedTail = cursor->tail.load(std::memory_order_acquire);
+                    if (cap - (pos - cachedTail) < need) {
+                        return nullptr;
+                    }
+                }
+                if (frame > contiguous) {
+                    writeFrameHeader(offset, static_cast<uint32_t>(contiguous), 1);
+                    pos += contiguous;
+                    offset = 0;
+                }
+                writeFrameHeader(offset, static_cast<uint32_t>(frame), 0);
+                pendingPos = pos + frame;
+                return buffer + offset + FRAME_HEADER;
+            }
+
+            // 生产者：发布最近一次 reserve 的记录
+            void commit() {
+                writePos = pendingPos;
+                cursor->head.store(writePos, std::memory_order_release);
+            }
+
+            // 消费者：取队首记录，队列为空返回 nullptr
+            const char* front(size_t* bytes = nullptr) {
+                for (;;) {
+                    uint64_t pos = readPos;
+                    if (pos == cachedHead) {
+                        cachedHead = cursor->head.load(std::memory_order_acquire);
+                        if (pos == cachedHead) {
+                            return nullptr;
+                        }
+                    }
+                    size_t offset = static_cast<size_t>(pos & mask);
+                    uint32_t frame;
+                    uint32_t padding;
+                    std::memcpy(&frame, buffer + offset, sizeof(frame));
+                    std::memcpy(&padding, buffer + offset + 4, sizeof(padding));
+                    if (padding) {
+                        readPos += frame;
+                        continue;
+                    }
+                    frontFrame = frame;
+                    if (bytes) {
+                        *bytes = frame - FRAME_HEADER;
+                    }
+                    return buffer + offset + FRAME_HEADER;
+                }
+            }
+
+            // 消费者：释放 front 返回的记录
+            void pop() {
+                readPos += frontFrame;
+                cursor->tail.store(readPos, std::memory_order_release);
+            }
+
+            bool empty() const {
+                return cursor->tail.load(std::memory_order_acquire) == cursor->head.load(std::memory_order_acquire);
+            }
+
+            // 已发布但未消费的字节数（近似值）
+            size_t usedBytes() const {
+                return static_cast<size_t>(cursor->head.load(std::memory_order_acquire) -
+                                           cursor->tail.load(std::memory_order_acquire));
+            }
+
+            // 生产者侧写入位置 / 消费者侧读取位置（单调递增）
+            uint64_t producedPosition() const { return cursor->head.load(std::memory_order_acquire); }
+            uint64_t consumedPosition() const { return cursor->tail.load(std::memory_order_acquire); }
+
+            size_t capacity() const { return cap; }
+
+        private:
+            void writeFrameHeader(size_t offset, uint32_t frame, uint32_t padding) {
+                std::memcpy(buffer + offset, &frame, sizeof(frame));
+                std::memcpy(buffer + offset + 4, &padding, sizeof(padding));
+            }
+
+            char* const buffer;
+            const size_t cap;
+            const uint64_t mask;
+            Cursor  own;
+            Cursor* const cursor;
+
+            // 生产者独占
+            alignas(64) uint64_t writePos = 0;
+            uint64_t pendingPos = 0;
+            uint64_t cachedTail = 0;
+
+            // 消费者独占
+            alignas(64) uint64_t readPos = 0;
+            uint64_t cachedHead = 0;
+            uint32_t frontFrame = 0;
+        };
+
+    } // namespace LOG
+} // namespace beiklive
+
+#endif  // INC_LOG_RING_HH_
@@ -0,0 +1,191 @@
+// Copyright (c) RealCoolEngineer. 2024. All rights reserved.
+// Author: beiklive
+// Date: 2024-04-15
+#ifndef INC_LOG_SCHED_HH_
+#define INC_LOG_SCHED_HH_
+
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+#ifdef __linux__
+#include <pthread.h>
+#include <sched.h>
+#include <sys/mman.h>
+#include <sys/resource.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+// 线程放置相关的工具函数：CPU 亲和性、NUMA 节点、nice 值与调度策略。
+// 仅 Linux 下生效，其他平台返回 false / -1。
+namespace beiklive
+{
+    namespace LOG
+    {
+        struct SchedOptions
+        {
+            int cpu = -1;           // 绑定到指定 CPU，-1 表示不绑定
+            int numaNode = -1;      // 绑定到 NUMA 节点的全部 CPU，cpu >= 0 时忽略
+            int nice = 0;           // 仅在 setNice 为 true 时生效
+            bool setNice = false;
+            int schedPolicy = -1;   // SCHED_OTHER / SCHED_FIFO / SCHED_RR，-1 表示不修改
+            int schedPriority = 0;
+        };
+
+        inline long currentThreadId()
+        {
+#ifdef __linux__
+            return static_cast<long>(syscall(SYS_gettid));
+#else
+            return -1;
+#endif
+        }
+
+        inline int currentNumaNode()
+        {
+#ifdef __linux__
+            unsigned cpu = 0;
+            unsigned node = 0;
+            if (syscall(SYS_getcpu, &cpu, &node, nullptr) == 0) {
+                return static_cast<int>(node);
+            }
+#endif
+            return -1;
+        }
+
+        // fork 出的子进程里只有调用 fork 的线程，其余 std::thread 对应的线程并不存在，
+        // 既不能 join，也不能以 joinable 状态析构（会 terminate）。这里把线程对象移到堆上且永不释放，
+        // 是有意的泄漏：每个组件每次 fork 至多一个对象，子进程也不会再去等待它
+        inline void abandonThreadAfterFork(std::thread& thread)
+        {
+            if (thread.joinable()) {
+                static_cast<void>(new std::thread(std::move(thread)));
+            }
+        }
+
+        // 解析 /sys/devices/system/node/nodeN/cpulist，例如 "0-3,8-11"
+        inline std::vector<int> numaNodeCpus(int node)
+        {
+            std::vector<int> cpus;
+            std::ifstream f("/sys/devices/system/node/node" + std::to_string(node) + "/cpulist");
+            std::string list;
+            if (!f.is_open() || !std::getline(f, list)) {
+                return cpus;
+            }
+            std::stringstream ss(list);
+            std::string range;
+            while (std::getline(ss, range, ',')) {
+                size_t dash = range.find('-');
+                int first = std::atoi(range.c_str());
+                int last = dash == std::string::npos ? first : std::atoi(range.c_str() + dash + 1);
+                for (int c = first; c <= last; ++c) {
+                    cpus.push_back(c);
+                }
+            }
+            return cpus;
+        }
+
+#ifdef __linux__
+        inline bool setThreadAffinity(pthread_t thread, const std::vector<int>& cpus)
+        {
+            if (cpus.empty()) {
+                return false;
+            }
+            cpu_set_t set;
+            CPU_ZERO(&set);
+            for (int c : cpus) {
+                if (c >= 0 && c < CPU_SETSIZE) {
+                    CPU_SET(c, &set);
+                }
+            }
+            return pthread_setaffinity_np(thread, sizeof(set), &set) == 0;
+        }
+
+        inline bool setThreadScheduler(pthread_t thread, int policy, int priority)
+        {
+            sched_param param;
+            std::memset(&param, 0, sizeof(param));
+            param.sched_priority = priority;
+            return pthread_setschedparam(thread, policy, &param) == 0;
+        }
+
+        // Linux 下 nice 值是按线程（tid）生效的
+        inline bool setThreadNice(long tid, int nice)
+        {
+            return setpriority(PRIO_PROCESS, static_cast<id_t>(tid), nice) == 0;
+        }
+
+        // 按 SchedOptions 调整线程，返回失败项的描述，全部成功时为空
+        inline std::string applySchedOptions(pthread_t thread, long tid, const SchedOptions& opt)
+        {
+            std::string errors;
+            if (opt.cpu >= 0) {
+                if (!setThreadAffinity(thread, { opt.cpu })) {
+                    errors += "affinity(cpu " + std::to_string(opt.cpu) + ") ";
+                }
+            }
+            else if (opt.numaNode >= 0) {
+                if (!setThreadAffinity(thread, numaNodeCpus(opt.numaNode))) {
+                    errors += "affinity(node " + std::to_string(opt.numaNode) + ") ";
+                }
+            }
+            if (opt.schedPolicy >= 0 && !setThreadScheduler(thread, opt.schedPolicy, opt.schedPriority)) {
+                errors += "sched(policy " + std::to_string(opt.schedPolicy) + ") ";
+            }
+            if (opt.setNice && !setThreadNice(tid, opt.nice)) {
+                errors += "nice(" + std::to_string(opt.nice) + ") ";
+            }
+            return errors;
+        }
+#endif
+
+        // 在指定 NUMA 节点上分配内存（mmap + mbind 首选策略），并由调用线程预先触页。
+        // node < 0 或不支持 NUMA 时仅依赖首次触页策略。
+        inline void* numaAlloc(size_t bytes, int node)
+        {
+#ifdef __linux__
+            void* p = mmap(nullptr, bytes, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+            if (p == MAP_FAILED) {
+                return nullptr;
+            }
+#ifdef SYS_mbind
+            if (node >= 0 && node < 64) {
+                const int MPOL_PREFERRED_ = 1;
+                unsigned long mask = 1ul << node;
+                syscall(SYS_mbind, p, bytes, MPOL_PREFERRED_, &mask, sizeof(mask) * 8, 0);
+            }
+#endif
+            std::memset(p, 0, bytes);
+            return p;
+#else
+            (void)node;
+            void* p = std::malloc(bytes);
+            if (p) {
+                std::memset(p, 0, bytes);
+            }
+            return p;
+#endif
+        }
+
+        inline void numaFree(void* p, size_t bytes)
+        {
+            if (!p) {
+                return;
+            }
+#ifdef __linux__
+            munmap(p, bytes);
+#else
+            (void)bytes;
+            std::free(p);
+#endif
+        }
+
+    } // namespace LOG
+} // namespace beiklive
+
+#endif  // INC_LOG_SCHED_HH_
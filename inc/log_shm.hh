@@ -0,0 +1,509 @@
+// Copyright (c) RealCoolEngineer. 2024. All rights reserved.
+// Author: beiklive
+// Date: 2024-04-29
+#ifndef INC_LOG_SHM_HH_
+#define INC_LOG_SHM_HH_
+
+#ifdef __linux__
+
+#include <atomic>
+#include <cerrno>
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+#include <functional>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <new>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+#include <fcntl.h>
+#include <signal.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "log_backend.hh"
+
+namespace beiklive
+{
+    namespace LOG
+    {
+        struct SharedOptions
+        {
+            std::string name;                    // shm_open 名称（如 "/app_log"），为空时用 memfd，仅 fork 出的子进程可见
+            size_t slots = 64;                   // 可同时写入的生产者线程数（所有进程合计）
+            size_t ringCapacity = 1 << 18;       // 每个槽位的环形队列字节数，须为 2 的幂
+            bool   blockWhenFull = true;         // 队列满时等待，false 则丢弃并计数
+            size_t batchSize = 256;              // 每轮从单个槽位取出的最大记录数
+            std::chrono::microseconds idleSleep{ 100 };
+        };
+
+        // 可执行文件（设备号 + inode）与 anchor 加载地址的组合，相同才能直接使用对方记录中的函数/调用点指针
+        inline uint64_t imageIdentity(const void* anchor)
+        {
+            struct stat st;
+            uint64_t h = 1469598103934665603ull;
+            auto mix = [&h](uint64_t v) {
+                h ^= v;
+                h *= 1099511628211ull;
+            };
+            if (stat("/proc/self/exe", &st) == 0) {
+                mix(static_cast<uint64_t>(st.st_dev));
+                mix(static_cast<uint64_t>(st.st_ino));
+            }
+            mix(static_cast<uint64_t>(reinterpret_cast<uintptr_t>(anchor)));
+            return h;
+        }
+
+        // 多进程共享的日志队列：共享内存中划分固定数量的槽位，每个生产者线程独占一个 SPSC 队列，
+        // 由创建者进程中的收集线程统一取出并交给 handler 格式化与写文件。
+        // fork 出的子进程自动成为生产者；无亲缘关系的进程通过 attach(name) 加入。
+        class SharedRing {
+        public:
+            using RecordHandler = std::function<void(const char* payload, size_t bytes)>;
+            using IdleHandler = std::function<void()>;
+
+            SharedRing() = default;
+            ~SharedRing() { stop(); }
+
+            SharedRing(const SharedRing&) = delete;
+            SharedRing& operator=(const SharedRing&) = delete;
+
+            // 创建共享段并启动收集线程，调用进程成为收集者
+            bool create(const SharedOptions& opt, uint64_t image, RecordHandler onRecord, IdleHandler onIdle) {
+                std::lock_guard<std::mutex> lock(controlMutex);
+                if (base) {
+                    return false;
+                }
+                if (opt.slots == 0 || opt.ringCapacity < 4096 || (opt.ringCapacity & (opt.ringCapacity - 1)) != 0) {
+                    std::cerr << "Invalid shared ring options: slots=" << opt.slots
+                              << " capacity=" << opt.ringCapacity << std::endl;
+                    return false;
+                }
+                size_t total = layout(opt.slots, opt.ringCapacity);
+                int fd;
+                if (opt.name.empty()) {
+                    fd = memfd_create("beiklive_log", MFD_CLOEXEC);
+                }
+                else {
+                    shm_unlink(opt.name.c_str());   // 清理上次异常退出遗留的同名段
+                    fd = shm_open(opt.name.c_str(), O_CREAT | O_EXCL | O_RDWR | O_CLOEXEC, 0600);
+                }
+                if (fd < 0) {
+                    std::perror(std::string("Error creating shared log ring: " + opt.name).c_str());
+                    return false;
+                }
+                if (ftruncate(fd, static_cast<off_t>(total)) != 0 || !map(fd, total)) {
+                    std::perror("Error mapping shared log ring");
+                    ::close(fd);
+                    unlinkName(opt.name);
+                    return false;
+                }
+                ::close(fd);
+
+                Header* h = new (base) Header();
+                h->slotCount = static_cast<uint32_t>(opt.slots);
+                h->ringCapacity = opt.ringCapacity;
+                h->image = image;
+                h->collectorPid.store(getpid(), std::memory_order_relaxed);
+                for (size_t i = 0; i < opt.slots; ++i) {
+                    new (slotAt(i)) Slot();
+                }
+                h->magic = MAGIC;
+                h->accepting.store(1, std::memory_order_seq_cst);
+
+                options = opt;
+                compatible = true;
+                collector = true;
+                bindViews();
+                handler = std::move(onRecord);
+                idleHandler = std::move(onIdle);
+                epoch = nextEpoch();
+                worker = std::thread([this]() { run(); });
+                return true;
+            }
+
+            // 以生产者身份加入其他进程创建的共享段
+            bool attach(const std::string& name, uint64_t image) {
+                std::lock_guard<std::mutex> lock(controlMutex);
+                if (base) {
+                    return false;
+                }
+                int fd = shm_open(name.c_str(), O_RDWR | O_CLOEXEC, 0600);
+                struct stat st;
+                if (fd < 0 || fstat(fd, &st) != 0 || static_cast<size_t>(st.st_size) < sizeof(Header) ||
+                    !map(fd, static_cast<size_t>(st.st_size))) {
+                    std::perror(std::string("Error attaching shared log ring: " + name).c_str());
+                    if (fd >= 0) {
+                        ::close(fd);
+                    }
+                    return false;
+                }
+                ::close(fd);
+                Header* h = header();
+                if (h->magic != MAGIC || h->version != VERSION ||
+                    layout(h->slotCount, h->ringCapacity) > mappedBytes) {
+                    std::cerr << "Incompatible shared log ring: " << name << std::endl;
+                    unmap();
+                    return false;
+                }
+                options.name = name;
+                compatible = h->image == image;
+                collector = false;
+                bindViews();
+                epoch = nextEpoch();
+                producer.store(true, std::memory_order_seq_cst);
+                return true;
+            }
+
+            // 收集者：停止接收、排空所有槽位后删除共享段；
+            // 生产者：等本进程中正在访问映射的线程离开后解除映射
+            void stop() {
+                std::lock_guard<std::mutex> lock(controlMutex);
+                if (!base) {
+                    return;
+                }
+                producer.store(false, std::memory_order_seq_cst);
+                while (inFlight.load(std::memory_order_seq_cst) != 0) {
+                    std::this_thread::yield();
+                }
+                epoch = nextEpoch();
+                if (collector) {
+                    header()->accepting.store(0, std::memory_order_seq_cst);
+                    if (worker.joinable()) {
+                        worker.join();
+                    }
+                    unlinkName(options.name);
+                }
+                views.clear();
+                unmap();
+            }
+
+            // 在 fork 的子进程中调用：收集线程不存在，子进程只作为生产者继续写入
+            void afterForkChild() {
+                epoch = nextEpoch();
+                abandonThreadAfterFork(worker);
+                collector = false;
+                inFlight.store(0, std::memory_order_relaxed);   // 父进程中的其他线程在子进程里不存在
+                producer.store(base != nullptr, std::memory_order_seq_cst);
+            }
+
+            // 当前进程应把记录写入共享队列
+            bool producing() {
+                Access access(*this);
+                return access.mapped && header()->accepting.load(std::memory_order_relaxed);
+            }
+
+            bool collecting() const {
+                return base && collector;
+            }
+
+            // 记录中的函数指针与调用点指针对收集者有效
+            bool binaryCompatible() const {
+                return compatible;
+            }
+
+            // 生产者：encode(char*) 向预留的 bytes 字节写入记录
+            template <typename Encoder>
+            PUSH_RESULT push(size_t bytes, Encoder&& encode) {
+                Access access(*this);
+                if (!access.mapped) {
+                    return PUSH_RESULT::REJECTED;
+                }
+                LocalSlot* local = localSlot();
+                if (!local) {
+                    return PUSH_RESULT::REJECTED;   // 槽位已用完
+                }
+                Header* h = header();
+                Slot* s = local->slot;
+                s->pushing.store(1, std::memory_order_seq_cst);
+                if (!h->accepting.load(std::memory_order_seq_cst) || bytes > local->ring->maxPayload()) {
+                    s->pushing.store(0, std::memory_order_release);
+                    return PUSH_RESULT::REJECTED;
+                }
+                char* p = local->ring->reserve(bytes);
+                for (uint32_t spins = 1; !p; ++spins) {
+                    if (!options.blockWhenFull) {
+                        s->pushing.store(0, std::memory_order_release);
+                        return PUSH_RESULT::DROPPED;
+                    }
+                    // 收集者停止或已退出时不再等待
+                    if ((spins & 1023) == 0 && (!h->accepting.load(std::memory_order_seq_cst) ||
+                                                !alive(h->collectorPid.load(std::memory_order_relaxed)))) {
+                        s->pushing.store(0, std::memory_order_release);
+                        return PUSH_RESULT::REJECTED;
+                    }
+                    std::this_thread::yield();
+                    p = local->ring->reserve(bytes);
+                }
+                encode(p);
+                local->ring->commit();
+                s->pushing.store(0, std::memory_order_release);
+                return PUSH_RESULT::OK;
+            }
+
+            // 已被占用的槽位数量
+            size_t producerCount() const {
+                if (!base) {
+                    return 0;
+                }
+                size_t n = 0;
+                for (size_t i = 0; i < header()->slotCount; ++i) {
+                    n += slotAt(i)->state.load(std::memory_order_acquire) != FREE;
+                }
+                return n;
+            }
+
+        private:
+            static constexpr uint64_t MAGIC = 0x474e49524c4b4942ull;   // "BIKLRING"
+            static constexpr uint32_t VERSION = 1;
+
+            enum : uint32_t { FREE = 0, OWNED = 1, RETIRED = 2 };
+
+            struct Header
+            {
+                uint64_t magic = 0;
+                uint32_t version = VERSION;
+                uint32_t slotCount = 0;
+                uint64_t ringCapacity = 0;
+                uint64_t image = 0;
+                std::atomic<int32_t>  collectorPid{ 0 };
+                std::atomic<uint32_t> accepting{ 0 };
+            };
+
+            struct Slot
+            {
+                std::atomic<uint32_t> state{ FREE };
+                std::atomic<int32_t>  pid{ 0 };
+                std::atomic<int64_t>  tid{ 0 };
+                std::atomic<uint32_t> pushing{ 0 };
+                SpscRing::Cursor      cursor;
+            };
+
+            static_assert(std::atomic<uint64_t>::is_always_lock_free && std::atomic<uint32_t>::is_always_lock_free,
+                          "shared ring requires address-free atomics");
+
+            // 生产者线程访问映射期间计入 inFlight；stop() 先关闭 producer 再等计数归零，之后才解除映射
+            struct Access
+            {
+                explicit Access(SharedRing& r) : ring(r) {
+                    ring.inFlight.fetch_add(1, std::memory_order_seq_cst);
+                    mapped = ring.producer.load(std::memory_order_seq_cst);
+                }
+                ~Access() { ring.inFlight.fetch_sub(1, std::memory_order_release); }
+
+                SharedRing& ring;
+                bool        mapped = false;
+            };
+
+            // 生产者线程持有的槽位视图
+            struct LocalSlot
+            {
+                const SharedRing* owner = nullptr;
+                uint64_t epoch = 0;
+                Slot* slot = nullptr;
+                std::unique_ptr<SpscRing> ring;
+
+                ~LocalSlot() { release(); }
+
+                // 仅在仍属于同一次创建/加入且未经 fork 时归还槽位
+                void release() {
+                    if (slot && owner && owner->epoch == epoch) {
+                        slot->state.store(RETIRED, std::memory_order_release);
+                    }
+                    slot = nullptr;
+                    ring.reset();
+                }
+            };
+
+            static uint64_t nextEpoch() {
+                static std::atomic<uint64_t> counter{ 0 };
+                return ++counter;
+            }
+
+            static size_t slotsOffset() {
+                return (sizeof(Header) + 63) & ~size_t(63);
+            }
+
+            static size_t dataOffset(size_t slots) {
+                return (slotsOffset() + slots * sizeof(Slot) + 4095) & ~size_t(4095);
+            }
+
+            static size_t layout(size_t slots, size_t capacity) {
+                return dataOffset(slots) + slots * capacity;
+            }
+
+            static bool alive(int pid) {
+                return pid > 0 && (kill(pid, 0) == 0 || errno != ESRCH);
+            }
+
+            Header* header() const { return reinterpret_cast<Header*>(base); }
+
+            Slot* slotAt(size_t i) const {
+                return reinterpret_cast<Slot*>(base + slotsOffset()) + i;
+            }
+
+            char* dataAt(size_t i) const {
+                return base + dataOffset(header()->slotCount) + i * header()->ringCapacity;
+            }
+
+            bool map(int fd, size_t bytes) {
+                void* p = mmap(nullptr, bytes, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+                if (p == MAP_FAILED) {
+                    return false;
+                }
+                base = static_cast<char*>(p);
+                mappedBytes = bytes;
+                return true;
+            }
+
+            void unmap() {
+                munmap(base, mappedBytes);
+                base = nullptr;
+                mappedBytes = 0;
+            }
+
+            static void unlinkName(const std::string& name) {
+                if (!name.empty()) {
+                    shm_unlink(name.c_str());
+                }
+            }
+
+            // 每个槽位在本进程中的队列视图，收集者用作消费端
+            void bindViews() {
+                views.clear();
+                for (size_t i = 0; i < header()->slotCount; ++i) {
+                    views.emplace_back(new SpscRing(dataAt(i), header()->ringCapacity, &slotAt(i)->cursor));
+                }
+            }
+
+            LocalSlot* localSlot() {
+                thread_local LocalSlot local;
+                if (local.slot && local.owner == this && local.epoch == epoch) {
+                    return &local;
+                }
+                local.release();
+                for (size_t i = 0; i < header()->slotCount; ++i) {
+                    Slot* s = slotAt(i);
+                    uint32_t expected = FREE;
+                    if (s->state.load(std::memory_order_relaxed) == FREE &&
+                        s->state.compare_exchange_strong(expected, OWNED, std::memory_order_acq_rel)) {
+                        s->pid.store(getpid(), std::memory_order_relaxed);
+                        s->tid.store(currentThreadId(), std::memory_order_relaxed);
+                        local.owner = this;
+                        local.epoch = epoch;
+                        local.slot = s;
+                        local.ring.reset(new SpscRing(dataAt(i), header()->ringCapacity, &s->cursor));
+                        return &local;
+                    }
+                }
+                return nullptr;
+            }
+
+            // 回收已归还或所属进程已退出、且已排空的槽位
+            void reap() {
+                for (size_t i = 0; i < header()->slotCount; ++i) {
+                    Slot* s = slotAt(i);
+                    uint32_t state = s->state.load(std::memory_order_acquire);
+                    if (state == FREE || !views[i]->empty()) {
+                        continue;
+                    }
+                    if (state == RETIRED || !alive(s->pid.load(std::memory_order_relaxed))) {
+                        s->pushing.store(0, std::memory_order_relaxed);
+                        s->state.store(FREE, std::memory_order_release);
+                    }
+                }
+            }
+
+            size_t drainOnce() {
+                size_t total = 0;
+                for (size_t i = 0; i < views.size(); ++i) {
+                    if (slotAt(i)->state.load(std::memory_order_acquire) == FREE) {
+                        continue;
+                    }
+                    SpscRing& ring = *views[i];
+                    size_t n = 0;
+                    size_t bytes = 0;
+                    while (n < options.batchSize) {
+                        const char* p = ring.front(&bytes);
+                        if (!p) {
+                            break;
+                        }
+                        handler(p, bytes);
+                        ring.pop();
+                        ++n;
+                    }
+                    total += n;
+                }
+                return total;
+            }
+
+            bool quiescent() {
+                for (size_t i = 0; i < views.size(); ++i) {
+                    Slot* s = slotAt(i);
+                    if (s->state.load(std::memory_order_acquire) == FREE) {
+                        continue;
+                    }
+                    bool pushing = s->pushing.load(std::memory_order_seq_cst) &&
+                                   alive(s->pid.load(std::memory_order_relaxed));
+                    if (pushing || !views[i]->empty()) {
+                        return false;
+                    }
+                }
+                return true;
+            }
+
+            void run() {
+                Header* h = header();
+                auto lastReap = std::chrono::steady_clock::now();
+                for (;;) {
+                    size_t n = drainOnce();
+                    if (n != 0) {
+                        continue;
+                    }
+                    if (idleHandler) {
+                        idleHandler();
+                    }
+                    if (!h->accepting.load(std::memory_order_seq_cst)) {
+                        if (quiescent()) {
+                            break;
+                        }
+                        continue;
+                    }
+                    auto now = std::chrono::steady_clock::now();
+                    if (now - lastReap > std::chrono::seconds(1)) {
+                        reap();
+                        lastReap = now;
+                    }
+                    std::this_thread::sleep_for(options.idleSleep);
+                }
+                if (idleHandler) {
+                    idleHandler();
+                }
+            }
+
+            SharedOptions options;
+            RecordHandler handler;
+            IdleHandler idleHandler;
+
+            std::mutex controlMutex;
+            std::thread worker;
+            char*  base = nullptr;
+            size_t mappedBytes = 0;
+            bool   collector = false;
+            bool   compatible = false;
+            std::atomic<uint64_t> epoch{ 0 };
+            std::vector<std::unique_ptr<SpscRing>> views;
+            std::atomic<bool>     producer{ false };   // 本进程作为生产者映射着共享段
+            std::atomic<uint32_t> inFlight{ 0 };       // 本进程中正在访问映射的生产者线程数
+        };
+
+    } // namespace LOG
+} // namespace beiklive
+
+#endif  // __linux__
+
+#endif  // INC_LOG_SHM_HH_
@@ -0,0 +1,532 @@
+// Copyright (c) RealCoolEngineer. 2024. All rights reserved.
+// Author: beiklive
+// Date: 2024-06-01
+#ifndef INC_LOG_SOCKET_HH_
+#define INC_LOG_SOCKET_HH_
+
+#ifdef __linux__
+
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <cstring>
+#include <functional>
+#include <iostream>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <utility>
+#include <vector>
+#include <fcntl.h>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <sys/un.h>
+#include <unistd.h>
+#include "log_sched.hh"
+
+namespace beiklive
+{
+    namespace LOG
+    {
+        enum class SOCKETFORMAT : uint32_t
+        {
+            TEXT,      // 记录体为一行日志文本（不含换行）
+            BINARY     // 记录体为 SocketRecordMeta 加一行日志文本
+        };
+
+        struct SocketOptions
+        {
+            std::string  endpoint;                       // "unix:/run/app/log.sock" 或 "tcp:127.0.0.1:9000"
+            SOCKETFORMAT format = SOCKETFORMAT::TEXT;
+            size_t       batchBytes = 64 * 1024;         // 攒满即发送
+            size_t       maxBuffered = 4 * 1024 * 1024;  // 待发送超过此值时新记录改写文件
+            std::chrono::milliseconds flushInterval{ 5 };    // 不足一批时最长等待
+            std::chrono::milliseconds reconnectMin{ 50 };    // 重连退避的起止间隔
+            std::chrono::milliseconds reconnectMax{ 2000 };
+            std::chrono::milliseconds sendTimeout{ 1000 };   // 收集端卡住超过此时间视为断开
+        };
+
+        // 线上格式（本机字节序）：每批一个头，随后 records 条 { uint32 长度, 记录体 }
+        constexpr uint32_t SOCKET_MAGIC = 0x534c4b42;   // "BKLS"
+
+        struct SocketBatchHeader
+        {
+            uint32_t magic;
+            uint32_t bytes;      // 头之后的字节数
+            uint32_t records;
+            uint32_t format;     // SOCKETFORMAT
+        };
+
+        struct SocketRecordMeta
+        {
+            int64_t wallNs;      // Unix 纪元纳秒
+            int64_t tid;
+            int32_t pid;
+            int32_t level;       // LOGLEVEL
+        };
+
+        struct SocketStats
+        {
+            uint64_t sentRecords = 0;
+            uint64_t sentBatches = 0;
+            uint64_t spilledRecords = 0;   // 收集端不可用或积压时改写文件的记录
+            uint64_t connects = 0;
+        };
+
+        // 解析 unix:PATH / tcp:HOST:PORT，listen 为 true 时绑定并监听，失败返回 -1
+        inline int openEndpoint(const std::string& endpoint, bool listen, std::string* error)
+        {
+            auto fail = [error](const std::string& what) {
+                if (error) {
+                    *error = what + ": " + std::strerror(errno);
+                }
+                return -1;
+            };
+            if (endpoint.compare(0, 5, "unix:") == 0) {
+                std::string path = endpoint.substr(5);
+                struct sockaddr_un addr;
+                std::memset(&addr, 0, sizeof(addr));
+                addr.sun_family = AF_UNIX;
+                if (path.empty() || path.size() >= sizeof(addr.sun_path)) {
+                    errno = ENAMETOOLONG;
+                    return fail("bad unix socket path " + path);
+                }
+                std::memcpy(addr.sun_path, path.c_str(), path.size() + 1);
+                int fd = ::socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+                if (fd < 0) {
+                    return fail("socket");
+                }
+                if (listen) {
+                    ::unlink(path.c_str());
+                }
+                int rc = listen ? ::bind(fd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr))
+                                : ::connect(fd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr));
+                if (rc != 0 || (listen && ::listen(fd, 16) != 0)) {
+                    int saved = errno;
+                    ::close(fd);
+                    errno = saved;
+                    return fail(endpoint);
+                }
+                return fd;
+            }
+            if (endpoint.compare(0, 4, "tcp:") == 0) {
+                size_t colon = endpoint.rfind(':');
+                std::string host = endpoint.substr(4, colon - 4);
+                std::string port = endpoint.substr(colon + 1);
+                struct addrinfo hints;
+                std::memset(&hints, 0, sizeof(hints));
+                hints.ai_family = AF_UNSPEC;
+                hints.ai_socktype = SOCK_STREAM;
+                hints.ai_flags = AI_NUMERICSERV | (listen ? AI_PASSIVE : 0);
+                struct addrinfo* list = nullptr;
+                if (colon <= 4 || ::getaddrinfo(host.c_str(), port.c_str(), &hints, &list) != 0) {
+                    errno = EINVAL;
+                    return fail("bad tcp endpoint " + endpoint);
+                }
+                int fd = -1;
+                for (struct addrinfo* ai = list; ai && fd < 0; ai = ai->ai_next) {
+                    fd = ::socket(ai->ai_family, ai->ai_socktype | SOCK_CLOEXEC, ai->ai_protocol);
+                    if (fd < 0) {
+                        continue;
+                    }
+                    int one = 1;
+                    if (listen) {
+                        ::setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+                    }
+                    else {
+                        ::setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+                    }
+                    int rc = listen ? ::bind(fd, ai->ai_addr, ai->ai_addrlen) : ::connect(fd, ai->ai_addr, ai->ai_addrlen);
+                    if (rc != 0 || (listen && ::listen(fd, 16) != 0)) {
+                        int saved = errno;
+                        ::close(fd);
+                        errno = saved;
+                        fd = -1;
+                    }
+                }
+                ::freeaddrinfo(list);
+                return fd >= 0 ? fd : fail(endpoint);
+            }
+            errno = EINVAL;
+            return fail("unknown endpoint " + endpoint + " (expected unix:PATH or tcp:HOST:PORT)");
+        }
+
+        // 把日志按批发往本机的收集端。写入方只在锁内追加到待发送缓冲区，发送与重连都在发送线程中进行；
+        // 未连接、积压超过上限或发送失败的记录交给 spill（写入文件），收集端恢复后自动重连。
+        class SocketSink {
+        public:
+            // meta 为记录的来源与时间，flushNow 为写入方对这条记录的刷新要求
+            using SpillHandler = std::function<void(const SocketRecordMeta& meta, const std::string& line, bool flushNow)>;
+
+            ~SocketSink() { stop(); }
+
+            bool start(const SocketOptions& opt, SpillHandler onSpill) {
+                std::lock_guard<std::mutex> control(controlMutex);
+                if (worker.joinable()) {
+                    return false;
+                }
+                if (opt.endpoint.compare(0, 5, "unix:") != 0 && opt.endpoint.compare(0, 4, "tcp:") != 0) {
+                    std::cerr << "Invalid socket endpoint: " << opt.endpoint << std::endl;
+                    return false;
+                }
+                options = opt;
+                spill = std::move(onSpill);
+                stopping = false;
+                active.store(true, std::memory_order_release);
+                worker = std::thread([this]() { run(); });
+                return true;
+            }
+
+            // 发出已缓冲的记录后断开；未连接时缓冲的记录写入文件
+            void stop() {
+                std::lock_guard<std::mutex> control(controlMutex);
+                {
+                    std::lock_guard<std::mutex> lock(mutex);
+                    stopping = true;
+                }
+                cv.notify_all();
+                if (worker.joinable()) {
+                    worker.join();
+                }
+                active.store(false, std::memory_order_release);
+            }
+
+            // fork 出的子进程中发送线程并不存在：之后的记录直接写文件
+            void abandonAfterFork() {
+                active.store(false, std::memory_order_release);
+                up.store(false, std::memory_order_release);
+                abandonThreadAfterFork(worker);
+            }
+
+            // fork 前持有待发送缓冲区的锁
+            void lockForFork() { mutex.lock(); }
+            void unlockAfterFork() { mutex.unlock(); }
+
+            bool running() const { return active.load(std::memory_order_acquire); }
+            bool connected() const { return up.load(std::memory_order_acquire); }
+
+            // 返回 false 时由调用方写文件
+            bool write(const SocketRecordMeta& meta, const std::string& line, const bool flushNow) {
+                if (!up.load(std::memory_order_acquire)) {
+                    spilled.fetch_add(1, std::memory_order_relaxed);
+                    return false;
+                }
+                const size_t body = line.size() + (options.format == SOCKETFORMAT::BINARY ? sizeof(meta) : 0);
+                bool full = false;
+                {
+                    std::lock_guard<std::mutex> lock(mutex);
+                    if (!up.load(std::memory_order_relaxed) || batch.size() + sizeof(uint32_t) + body > options.maxBuffered) {
+                        spilled.fetch_add(1, std::memory_order_relaxed);
+                        return false;
+                    }
+                    if (batch.empty()) {
+                        batch.resize(sizeof(SocketBatchHeader));
+                    }
+                    const uint32_t length = static_cast<uint32_t>(body);
+                    batch.append(reinterpret_cast<const char*>(&length), sizeof(length));
+                    if (options.format == SOCKETFORMAT::BINARY) {
+                        batch.append(reinterpret_cast<const char*>(&meta), sizeof(meta));
+                    }
+                    batch.append(line);
+                    pending.push_back(PendingRecord{ meta, flushNow });
+                    full = batch.size() >= options.batchBytes;
+                }
+                if (full) {
+                    cv.notify_one();
+                }
+                return true;
+            }
+
+            SocketStats stats() const {
+                SocketStats s;
+                s.sentRecords = sentRecords.load(std::memory_order_relaxed);
+                s.sentBatches = sentBatches.load(std::memory_order_relaxed);
+                s.spilledRecords = spilled.load(std::memory_order_relaxed);
+                s.connects = connects.load(std::memory_order_relaxed);
+                return s;
+            }
+
+        private:
+            struct PendingRecord
+            {
+                SocketRecordMeta meta;
+                bool             flushNow;
+            };
+
+            static bool sendAll(int fd, const char* p, size_t n) {
+                while (n > 0) {
+                    ssize_t w = ::send(fd, p, n, MSG_NOSIGNAL);
+                    if (w < 0 && errno == EINTR) {
+                        continue;
+                    }
+                    if (w <= 0) {
+                        return false;
+                    }
+                    p += w;
+                    n -= static_cast<size_t>(w);
+                }
+                return true;
+            }
+
+            // 发送失败的一批记录按原顺序写入文件
+            void spillBatch(const std::string& frame, const std::vector<PendingRecord>& records) {
+                size_t offset = sizeof(SocketBatchHeader);
+                const size_t skip = options.format == SOCKETFORMAT::BINARY ? sizeof(SocketRecordMeta) : 0;
+                for (const PendingRecord& r : records) {
+                    uint32_t length;
+                    std::memcpy(&length, frame.data() + offset, sizeof(length));
+                    offset += sizeof(length);
+                    if (spill) {
+                        spill(r.meta, frame.substr(offset + skip, length - skip), r.flushNow);
+                    }
+                    offset += length;
+                }
+                spilled.fetch_add(records.size(), std::memory_order_relaxed);
+            }
+
+            void run() {
+                std::chrono::milliseconds backoff = options.reconnectMin;
+                int fd = -1;
+                std::unique_lock<std::mutex> lock(mutex);
+                for (;;) {
+                    if (fd < 0) {
+                        if (stopping) {
+                            break;
+                        }
+                        lock.unlock();
+                        fd = openEndpoint(options.endpoint, false, nullptr);
+                        if (fd >= 0) {
+                            struct timeval tv;
+                            tv.tv_sec = static_cast<time_t>(options.sendTimeout.count() / 1000);
+                            tv.tv_usec = static_cast<suseconds_t>(options.sendTimeout.count() % 1000 * 1000);
+                            ::setsockopt(fd, SOL_SOCKET, SO_SNDTIMEO, &tv, sizeof(tv));
+                        }
+                        lock.lock();
+                        if (fd < 0) {
+                            cv.wait_for(lock, backoff, [this]() { return stopping; });
+                            backoff = std::min(backoff * 2, options.reconnectMax);
+                            continue;
+                        }
+                        backoff = options.reconnectMin;
+                        connects.fetch_add(1, std::memory_order_relaxed);
+                        up.store(true, std::memory_order_release);
+                    }
+                    cv.wait_for(lock, options.flushInterval,
+                                [this]() { return stopping || batch.size() >= options.batchBytes; });
+                    if (pending.empty()) {
+                        if (stopping) {
+                            break;
+                        }
+                        continue;
+                    }
+                    std::string frame;
+                    std::vector<PendingRecord> sent;
+                    frame.swap(batch);
+                    sent.swap(pending);
+                    lock.unlock();
+
+                    SocketBatchHeader header{ SOCKET_MAGIC, static_cast<uint32_t>(frame.size() - sizeof(SocketBatchHeader)),
+                                              static_cast<uint32_t>(sent.size()), static_cast<uint32_t>(options.format) };
+                    std::memcpy(&frame[0], &header, sizeof(header));
+                    if (sendAll(fd, frame.data(), frame.size())) {
+                        sentRecords.fetch_add(sent.size(), std::memory_order_relaxed);
+                        sentBatches.fetch_add(1, std::memory_order_relaxed);
+                        lock.lock();
+                        continue;
+                    }
+                    // 收集端断开：之后的写入改写文件，这一批也写入文件，已缓冲的记录在重连后发出
+                    up.store(false, std::memory_order_release);
+                    ::close(fd);
+                    fd = -1;
+                    spillBatch(frame, sent);
+                    lock.lock();
+                }
+                up.store(false, std::memory_order_release);
+                std::string frame;
+                std::vector<PendingRecord> rest;
+                frame.swap(batch);
+                rest.swap(pending);
+                lock.unlock();
+                if (!rest.empty()) {
+                    spillBatch(frame, rest);
+                }
+                if (fd >= 0) {
+                    ::close(fd);
+                }
+            }
+
+            SocketOptions options;
+            SpillHandler  spill;
+
+            std::mutex controlMutex;
+            std::thread worker;
+            std::atomic<bool> active{ false };
+            std::atomic<bool> up{ false };
+
+            std::mutex mutex;
+            std::condition_variable cv;
+            std::string batch;              // 以预留的批头开始的待发送记录
+            std::vector<PendingRecord> pending;   // 各记录的来源与刷新要求，写入文件时使用
+            bool stopping = false;
+
+            std::atomic<uint64_t> sentRecords{ 0 };
+            std::atomic<uint64_t> sentBatches{ 0 };
+            std::atomic<uint64_t> spilled{ 0 };
+            std::atomic<uint64_t> connects{ 0 };
+        };
+
+        // 本机收集端：接受多个连接，按批解析后把每条记录交给 handler（TEXT 格式时 meta 为空）
+        class SocketReceiver {
+        public:
+            using RecordHandler = std::function<void(const SocketRecordMeta* meta, std::string_view line)>;
+
+            ~SocketReceiver() { stop(); }
+
+            bool start(const std::string& endpoint, RecordHandler onRecord) {
+                if (worker.joinable()) {
+                    return false;
+                }
+                std::string error;
+                listenFd = openEndpoint(endpoint, true, &error);
+                if (listenFd < 0) {
+                    std::cerr << "Error listening on " << error << std::endl;
+                    return false;
+                }
+                path = endpoint.compare(0, 5, "unix:") == 0 ? endpoint.substr(5) : std::string();
+                handler = std::move(onRecord);
+                stopping.store(false, std::memory_order_relaxed);
+                worker = std::thread([this]() { run(); });
+                return true;
+            }
+
+            // 关闭监听与所有连接，已收到的完整批次都已交给 handler
+            void stop() {
+                stopping.store(true, std::memory_order_relaxed);
+                if (worker.joinable()) {
+                    worker.join();
+                }
+                if (listenFd >= 0) {
+                    ::close(listenFd);
+                    listenFd = -1;
+                    if (!path.empty()) {
+                        ::unlink(path.c_str());
+                    }
+                }
+            }
+
+            uint64_t records() const { return received.load(std::memory_order_relaxed); }
+            uint64_t batches() const { return batchCount.load(std::memory_order_relaxed); }
+
+        private:
+            struct Peer
+            {
+                int         fd;
+                std::string buffer;
+            };
+
+            // 解析缓冲区中完整的批次；格式错误返回 false
+            bool parse(Peer& peer) {
+                size_t offset = 0;
+                while (peer.buffer.size() - offset >= sizeof(SocketBatchHeader)) {
+                    SocketBatchHeader h;
+                    std::memcpy(&h, peer.buffer.data() + offset, sizeof(h));
+                    if (h.magic != SOCKET_MAGIC || h.format > static_cast<uint32_t>(SOCKETFORMAT::BINARY)) {
+                        return false;
+                    }
+                    if (peer.buffer.size() - offset - sizeof(h) < h.bytes) {
+                        break;
+                    }
+                    const char* p = peer.buffer.data() + offset + sizeof(h);
+                    const char* end = p + h.bytes;
+                    for (uint32_t i = 0; i < h.records; ++i) {
+                        uint32_t length;
+                        if (end - p < static_cast<ptrdiff_t>(sizeof(length))) {
+                            return false;
+                        }
+                        std::memcpy(&length, p, sizeof(length));
+                        p += sizeof(length);
+                        if (end - p < static_cast<ptrdiff_t>(length)) {
+                            return false;
+                        }
+                        if (h.format == static_cast<uint32_t>(SOCKETFORMAT::BINARY)) {
+                            SocketRecordMeta meta;
+                            if (length < sizeof(meta)) {
+                                return false;
+                            }
+                            std::memcpy(&meta, p, sizeof(meta));
+                            handler(&meta, std::string_view(p + sizeof(meta), length - sizeof(meta)));
+                        }
+                        else {
+                            handler(nullptr, std::string_view(p, length));
+                        }
+                        p += length;
+                    }
+                    received.fetch_add(h.records, std::memory_order_relaxed);
+                    batchCount.fetch_add(1, std::memory_order_relaxed);
+                    offset += sizeof(h) + h.bytes;
+                }
+                peer.buffer.erase(0, offset);
+                return true;
+            }
+
+            void run() {
+                std::vector<Peer> peers;
+                std::vector<struct pollfd> fds;
+                char chunk[64 * 1024];
+                while (!stopping.load(std::memory_order_relaxed)) {
+                    fds.assign(1, pollfd{ listenFd, POLLIN, 0 });
+                    for (const Peer& peer : peers) {
+                        fds.push_back(pollfd{ peer.fd, POLLIN, 0 });
+                    }
+                    if (::poll(fds.data(), fds.size(), 50) <= 0) {
+                        continue;
+                    }
+                    for (size_t i = peers.size(); i > 0; --i) {
+                        if (!(fds[i].revents & (POLLIN | POLLHUP | POLLERR))) {
+                            continue;
+                        }
+                        Peer& peer = peers[i - 1];
+                        ssize_t n = ::read(peer.fd, chunk, sizeof(chunk));
+                        if (n > 0) {
+                            peer.buffer.append(chunk, static_cast<size_t>(n));
+                        }
+                        if (n == 0 || (n < 0 && errno != EINTR && errno != EAGAIN) || !parse(peer)) {
+                            ::close(peer.fd);   // 连接中断时未完整收到的批次由发送端写入文件
+                            peers.erase(peers.begin() + static_cast<std::ptrdiff_t>(i - 1));
+                        }
+                    }
+                    if (fds[0].revents & POLLIN) {
+                        int fd = ::accept4(listenFd, nullptr, nullptr, SOCK_CLOEXEC);
+                        if (fd >= 0) {
+                            peers.push_back(Peer{ fd, std::string() });
+                        }
+                    }
+                }
+                for (Peer& peer : peers) {
+                    ::close(peer.fd);
+                }
+            }
+
+            int listenFd = -1;
+            std::string path;
+            RecordHandler handler;
+            std::thread worker;
+            std::atomic<bool> stopping{ false };
+            std::atomic<uint64_t> received{ 0 };
+            std::atomic<uint64_t> batchCount{ 0 };
+        };
+
+    } // namespace LOG
+} // namespace beiklive
+
+#endif  // __linux__
+
+#endif  // INC_LOG_SOCKET_HH_
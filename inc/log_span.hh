@@ -0,0 +1,278 @@
+// Copyright (c) RealCoolEngineer. 2024. All rights reserved.
+// Author: beiklive
+// Date: 2024-05-20
+#ifndef INC_LOG_SPAN_HH_
+#define INC_LOG_SPAN_HH_
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+#include "log_metrics.hh"
+#include "log_sched.hh"
+
+namespace beiklive
+{
+    namespace LOG
+    {
+        // span 调用点的静态描述，由 LOG_SCOPE / LOG_SPAN 宏在每个调用点生成一份
+        struct SpanSite
+        {
+            const char* name;
+            const char* function;
+            const char* file;
+            int         line;
+            mutable std::atomic<int32_t> timerSlot{ -1 };   // 同名计时器共用的直方图槽位，首次记录时分配
+        };
+
+        // 一个已结束的 span；start / end 与记录时间戳同一时钟（纳秒或 TSC tick）
+        struct SpanEvent
+        {
+            const SpanSite* site;
+            int64_t         start;
+            int64_t         end;
+            int64_t         tid;
+            uint32_t        depth;
+            uint8_t         clock;
+        };
+
+        struct SpanStats
+        {
+            const SpanSite* site = nullptr;
+            uint64_t count = 0;
+            uint64_t totalNs = 0;
+            uint64_t minNs = UINT64_MAX;
+            uint64_t maxNs = 0;
+            uint32_t maxDepth = 0;
+
+            double meanNs() const { return count ? static_cast<double>(totalNs) / count : 0.0; }
+        };
+
+        // 按调用点汇总 span 耗时；异步模式下只由后台线程写入
+        class SpanAggregator {
+        public:
+            void add(const SpanSite* site, uint64_t durationNs, uint32_t depth) {
+                std::lock_guard<std::mutex> lock(mutex);
+                SpanStats& s = stats[site];
+                s.site = site;
+                ++s.count;
+                s.totalNs += durationNs;
+                s.minNs = std::min(s.minNs, durationNs);
+                s.maxNs = std::max(s.maxNs, durationNs);
+                s.maxDepth = std::max(s.maxDepth, depth);
+            }
+
+            // 按总耗时从大到小排列
+            std::vector<SpanStats> snapshot() const {
+                std::vector<SpanStats> out;
+                {
+                    std::lock_guard<std::mutex> lock(mutex);
+                    out.reserve(stats.size());
+                    for (const auto& kv : stats) {
+                        out.push_back(kv.second);
+                    }
+                }
+                std::sort(out.begin(), out.end(), [](const SpanStats& a, const SpanStats& b) {
+                    return a.totalNs > b.totalNs;
+                });
+                return out;
+            }
+
+            void reset() {
+                std::lock_guard<std::mutex> lock(mutex);
+                stats.clear();
+            }
+
+            // fork 前持有汇总表的锁，子进程在调用线程上汇总 span 时不会卡在继承来的锁上
+            void lockForFork() { mutex.lock(); }
+            void unlockAfterFork() { mutex.unlock(); }
+
+            std::string report() const {
+                std::stringstream ss;
+                for (const SpanStats& s : snapshot()) {
+                    ss << "\n  " << s.site->name << " [" << s.site->function << ":" << s.site->line << "]"
+                       << " count=" << s.count << " total_ns=" << s.totalNs
+                       << " mean_ns=" << static_cast<uint64_t>(s.meanNs())
+                       << " min_ns=" << s.minNs << " max_ns=" << s.maxNs << " depth=" << s.maxDepth;
+                }
+                return ss.str();
+            }
+
+        private:
+            mutable std::mutex mutex;
+            std::unordered_map<const SpanSite*, SpanStats> stats;
+        };
+
+        struct TimerSummary
+        {
+            std::string    name;
+            LatencySummary ns;
+        };
+
+        // 按名称统计 span 耗时的 HDR 直方图：每个线程各自记录（无争用的原子加），
+        // collect() 周期性地把各线程的计数移入本周期直方图，再累加到总计；线程退出时其计数并入下一周期。
+        class TimerRegistry {
+        public:
+            static constexpr size_t MAX_TIMERS = 256;   // 超出的名称不统计
+
+            ~TimerRegistry() {
+                std::lock_guard<std::mutex> lock(mutex);
+                for (ThreadTimers* t : threads) {
+                    t->owner = nullptr;
+                }
+            }
+
+            void record(const SpanSite& site, uint64_t ns) {
+                int32_t slot = site.timerSlot.load(std::memory_order_acquire);
+                if (slot < 0 && (slot = assignSlot(site)) < 0) {
+                    return;
+                }
+                ThreadTimers& local = localTimers();
+                LatencyHistogram* h = local.slots[slot].load(std::memory_order_relaxed);
+                if (!h) {
+                    h = new LatencyHistogram();
+                    local.slots[slot].store(h, std::memory_order_release);
+                }
+                h->record(ns);
+            }
+
+            // 汇总自上次调用以来的记录，只返回本周期有记录的计时器
+            std::vector<TimerSummary> collect() {
+                std::lock_guard<std::mutex> lock(mutex);
+                for (ThreadTimers* t : threads) {
+                    drainLocked(*t);
+                }
+                std::vector<TimerSummary> out;
+                for (size_t i = 0; i < names.size(); ++i) {
+                    if (interval[i]->count()) {
+                        out.push_back(TimerSummary{ names[i], LatencySummary::of(*interval[i]) });
+                        interval[i]->drainInto(*total[i]);
+                    }
+                }
+                return out;
+            }
+
+            // 启动以来的累计统计
+            std::vector<TimerSummary> totals() {
+                collect();
+                std::lock_guard<std::mutex> lock(mutex);
+                std::vector<TimerSummary> out;
+                for (size_t i = 0; i < names.size(); ++i) {
+                    if (total[i]->count()) {
+                        out.push_back(TimerSummary{ names[i], LatencySummary::of(*total[i]) });
+                    }
+                }
+                return out;
+            }
+
+            void reset() {
+                collect();
+                std::lock_guard<std::mutex> lock(mutex);
+                for (size_t i = 0; i < names.size(); ++i) {
+                    total[i]->reset();
+                }
+            }
+
+            void lockForFork() { mutex.lock(); }
+            void unlockAfterFork() { mutex.unlock(); }
+
+        private:
+            struct ThreadTimers
+            {
+                TimerRegistry* owner = nullptr;
+                std::array<std::atomic<LatencyHistogram*>, MAX_TIMERS> slots{};
+
+                ~ThreadTimers() {
+                    if (owner) {
+                        owner->retire(this);
+                    }
+                    for (auto& s : slots) {
+                        delete s.load(std::memory_order_relaxed);
+                    }
+                }
+            };
+
+            ThreadTimers& localTimers() {
+                thread_local ThreadTimers local;
+                if (!local.owner) {
+                    std::lock_guard<std::mutex> lock(mutex);
+                    local.owner = this;
+                    threads.push_back(&local);
+                }
+                return local;
+            }
+
+            int32_t assignSlot(const SpanSite& site) {
+                std::lock_guard<std::mutex> lock(mutex);
+                int32_t slot = site.timerSlot.load(std::memory_order_relaxed);
+                if (slot >= 0) {
+                    return slot;
+                }
+                auto it = std::find(names.begin(), names.end(), site.name);
+                if (it != names.end()) {
+                    slot = static_cast<int32_t>(it - names.begin());
+                }
+                else if (names.size() < MAX_TIMERS) {
+                    slot = static_cast<int32_t>(names.size());
+                    names.push_back(site.name);
+                    interval.push_back(std::make_unique<LatencyHistogram>());
+                    total.push_back(std::make_unique<LatencyHistogram>());
+                }
+                else {
+                    return -1;
+                }
+                site.timerSlot.store(slot, std::memory_order_release);
+                return slot;
+            }
+
+            void drainLocked(ThreadTimers& t) {
+                for (size_t i = 0; i < names.size(); ++i) {
+                    if (LatencyHistogram* h = t.slots[i].load(std::memory_order_acquire)) {
+                        h->drainInto(*interval[i]);
+                    }
+                }
+            }
+
+            void retire(ThreadTimers* t) {
+                std::lock_guard<std::mutex> lock(mutex);
+                drainLocked(*t);
+                threads.erase(std::remove(threads.begin(), threads.end(), t), threads.end());
+            }
+
+            std::mutex mutex;
+            std::vector<std::string> names;
+            std::vector<std::unique_ptr<LatencyHistogram>> interval;
+            std::vector<std::unique_ptr<LatencyHistogram>> total;
+            std::vector<ThreadTimers*> threads;
+        };
+
+        // 当前线程打开的 span 层数
+        inline uint32_t& spanDepth()
+        {
+            thread_local uint32_t depth = 0;
+            return depth;
+        }
+
+        // 线程 ID 只在每个线程首次使用时取一次
+        inline int64_t spanThreadId()
+        {
+            thread_local int64_t tid = [] {
+                long id = currentThreadId();
+                return id > 0 ? static_cast<int64_t>(id)
+                              : static_cast<int64_t>(std::hash<std::thread::id>()(std::this_thread::get_id()));
+            }();
+            return tid;
+        }
+
+    } // namespace LOG
+} // namespace beiklive
+
+#endif  // INC_LOG_SPAN_HH_
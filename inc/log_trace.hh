@@ -0,0 +1,213 @@
+// Copyright (c) RealCoolEngineer. 2024. All rights reserved.
+// Author: beiklive
+// Date: 2024-05-21
+#ifndef INC_LOG_TRACE_HH_
+#define INC_LOG_TRACE_HH_
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <cstdio>
+#include <mutex>
+#include <string>
+#include <string_view>
+
+namespace beiklive
+{
+    namespace LOG
+    {
+        // Chrome trace-event 的 JSON 数组格式，chrome://tracing 与 ui.perfetto.dev 均可直接打开：
+        // span 写为完整事件（ph "X"），日志写为线程级瞬时事件（ph "i"），时间单位为微秒。
+        // 数组格式允许缺少结尾的 ']'，进程异常退出时已写出的部分仍可加载。
+        class TraceWriter {
+        public:
+            static constexpr size_t FLUSH_BYTES = 64 * 1024;
+            static constexpr size_t NAME_LIMIT = 64;   // 瞬时事件名取消息前缀，完整消息放在 args 中
+
+            ~TraceWriter() { close(); }
+
+            bool open(const std::string& path) {
+                std::lock_guard<std::mutex> lock(mutex);
+                closeLocked();
+                file = std::fopen(path.c_str(), "wb");
+                if (!file) {
+                    return false;
+                }
+                std::setvbuf(file, nullptr, _IONBF, 0);   // 只用自己的缓冲区，fork 后子进程直接丢弃
+                buffer = "[\n";
+                first = true;
+                count = 0;
+                opened.store(true, std::memory_order_release);
+                return true;
+            }
+
+            bool isOpen() const { return opened.load(std::memory_order_acquire); }
+
+            void close() {
+                std::lock_guard<std::mutex> lock(mutex);
+                closeLocked();
+            }
+
+            void flush() {
+                if (!isOpen()) {
+                    return;
+                }
+                std::lock_guard<std::mutex> lock(mutex);
+                flushLocked();
+            }
+
+            // fork 前持有写入锁
+            void lockForFork() { mutex.lock(); }
+            void unlockAfterFork() { mutex.unlock(); }
+
+            // fork 出的子进程不再写父进程的文件
+            void abandonAfterFork() {
+                opened.store(false, std::memory_order_relaxed);
+                file = nullptr;
+                buffer.clear();
+            }
+
+            void span(std::string_view name, const char* function, int line, int64_t startNs, uint64_t durationNs,
+                      int pid, int64_t tid, uint32_t depth, bool flushNow) {
+                std::lock_guard<std::mutex> lock(mutex);
+                if (!beginEvent()) {
+                    return;
+                }
+                buffer += "{\"name\":";
+                appendString(buffer, name);
+                buffer += ",\"cat\":\"span\",\"ph\":\"X\",\"ts\":";
+                appendMicros(buffer, startNs);
+                buffer += ",\"dur\":";
+                appendMicros(buffer, static_cast<int64_t>(durationNs));
+                appendIds(buffer, pid, tid);
+                buffer += ",\"args\":{\"depth\":" + std::to_string(depth) + ",\"callsite\":";
+                appendString(buffer, std::string(function) + ":" + std::to_string(line));
+                buffer += "}}";
+                endEvent(flushNow);
+            }
+
+            void instant(const char* level, const char* function, int line, int64_t wallNs, int pid, int64_t tid,
+                         std::string_view message, std::string_view context, bool flushNow) {
+                std::lock_guard<std::mutex> lock(mutex);
+                if (!beginEvent()) {
+                    return;
+                }
+                buffer += "{\"name\":";
+                size_t nameLength = std::min(message.size(), NAME_LIMIT);
+                while (nameLength < message.size() && (static_cast<unsigned char>(message[nameLength]) & 0xC0) == 0x80) {
+                    --nameLength;   // 不截断 UTF-8 字符
+                }
+                appendString(buffer, message.substr(0, nameLength));
+                buffer += ",\"cat\":\"log\",\"ph\":\"i\",\"s\":\"t\",\"ts\":";
+                appendMicros(buffer, wallNs);
+                appendIds(buffer, pid, tid);
+                buffer += ",\"args\":{\"level\":\"";
+                buffer += level;
+                buffer += "\"";
+                if (function) {
+                    buffer += ",\"callsite\":";
+                    appendString(buffer, std::string(function) + ":" + std::to_string(line));
+                }
+                if (!context.empty()) {
+                    buffer += ",\"context\":";
+                    appendString(buffer, context);
+                }
+                buffer += ",\"message\":";
+                appendString(buffer, message);
+                buffer += "}}";
+                endEvent(flushNow);
+            }
+
+            uint64_t events() const {
+                std::lock_guard<std::mutex> lock(mutex);
+                return count;
+            }
+
+            static void appendString(std::string& out, std::string_view s) {
+                static const char HEX[] = "0123456789abcdef";
+                out += '"';
+                for (char c : s) {
+                    unsigned char u = static_cast<unsigned char>(c);
+                    if (c == '"' || c == '\\') {
+                        out += '\\';
+                        out += c;
+                    }
+                    else if (u < 0x20) {
+                        out += "\\u00";
+                        out += HEX[u >> 4];
+                        out += HEX[u & 0xf];
+                    }
+                    else {
+                        out += c;
+                    }
+                }
+                out += '"';
+            }
+
+        private:
+            // 纳秒写为带三位小数的微秒
+            static void appendMicros(std::string& out, int64_t ns) {
+                if (ns < 0) {
+                    out += '-';
+                    ns = -ns;
+                }
+                out += std::to_string(ns / 1000);
+                char frac[5] = { '.', static_cast<char>('0' + ns % 1000 / 100), static_cast<char>('0' + ns % 100 / 10),
+                                 static_cast<char>('0' + ns % 10), '\0' };
+                out += frac;
+            }
+
+            static void appendIds(std::string& out, int pid, int64_t tid) {
+                out += ",\"pid\":" + std::to_string(pid) + ",\"tid\":" + std::to_string(tid);
+            }
+
+            bool beginEvent() {
+                if (!file) {
+                    return false;
+                }
+                if (!first) {
+                    buffer += ",\n";
+                }
+                first = false;
+                return true;
+            }
+
+            void endEvent(bool flushNow) {
+                ++count;
+                if (flushNow || buffer.size() >= FLUSH_BYTES) {
+                    flushLocked();
+                }
+            }
+
+            void flushLocked() {
+                if (file && !buffer.empty()) {
+                    if (std::fwrite(buffer.data(), 1, buffer.size(), file) != buffer.size()) {
+                        std::perror("Error writing trace file");
+                    }
+                    buffer.clear();
+                }
+            }
+
+            void closeLocked() {
+                if (!file) {
+                    return;
+                }
+                buffer += "\n]\n";
+                flushLocked();
+                std::fclose(file);
+                file = nullptr;
+                opened.store(false, std::memory_order_release);
+            }
+
+            mutable std::mutex mutex;
+            std::atomic<bool>  opened{ false };
+            std::FILE*         file = nullptr;
+            std::string        buffer;
+            bool               first = true;
+            uint64_t           count = 0;
+        };
+
+    } // namespace LOG
+} // namespace beiklive
+
+#endif  // INC_LOG_TRACE_HH_
@@ -0,0 +1,120 @@
+// Copyright (c) RealCoolEngineer. 2024. All rights reserved.
+// Author: beiklive
+// Date: 2024-05-28
+#ifndef INC_LOG_WAKE_HH_
+#define INC_LOG_WAKE_HH_
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <thread>
+#ifdef __linux__
+#include <climits>
+#include <ctime>
+#include <linux/futex.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#endif
+
+namespace beiklive
+{
+    namespace LOG
+    {
+        // 后台线程得知队列中有新记录的方式
+        enum class WAKEMODE
+        {
+            POLL,     // 空闲时按 idleSleep 固定间隔轮询
+            SPIN,     // 忙等，延迟最低，适合独占 CPU 的后台线程
+            NOTIFY    // 空闲时在 futex 上睡眠，生产者按批唤醒
+        };
+
+        inline void cpuRelax()
+        {
+#if defined(__x86_64__) || defined(__i386__)
+            _mm_pause();
+#elif defined(__aarch64__)
+            asm volatile("yield");
+#else
+            std::this_thread::yield();
+#endif
+        }
+
+        // 后台睡眠 / 生产者唤醒的握手：
+        //   后台  prepare() -> 再检查一次队列 -> 仍为空则 wait()，否则 cancel()
+        //   生产者 提交记录 -> asleep() 为真时才 arrive() / notify()
+        // 后台醒着时生产者只多一次读操作；只有把 asleep 从 true 改为 false 的那个生产者进入内核。
+        class WakeSignal {
+        public:
+            uint32_t prepare() {
+                pending.store(0, std::memory_order_relaxed);
+                uint32_t s = seq.load(std::memory_order_acquire);
+                sleeping.store(true, std::memory_order_seq_cst);
+                return s;
+            }
+
+            void cancel() {
+                sleeping.store(false, std::memory_order_relaxed);
+            }
+
+            // 阻塞到被唤醒或超时；seq 已变化时立即返回
+            void wait(uint32_t s, std::chrono::microseconds timeout) {
+                ++sleeps;
+#ifdef __linux__
+                struct timespec ts;
+                ts.tv_sec = static_cast<time_t>(timeout.count() / 1000000);
+                ts.tv_nsec = static_cast<long>(timeout.count() % 1000000 * 1000);
+                syscall(SYS_futex, reinterpret_cast<uint32_t*>(&seq), FUTEX_WAIT_PRIVATE, s, &ts, nullptr, 0);
+#else
+                (void)s;
+                std::this_thread::sleep_for(timeout);
+#endif
+                sleeping.store(false, std::memory_order_relaxed);
+            }
+
+            bool asleep() const {
+                return sleeping.load(std::memory_order_seq_cst);
+            }
+
+            // 后台睡眠期间又到达一条记录，累计到 batch 条时唤醒
+            void arrive(uint32_t batch) {
+                if (pending.fetch_add(1, std::memory_order_relaxed) + 1 >= batch) {
+                    notify();
+                }
+            }
+
+            void notify() {
+                if (!sleeping.exchange(false, std::memory_order_acq_rel)) {
+                    return;
+                }
+                seq.fetch_add(1, std::memory_order_release);
+                wakeups.fetch_add(1, std::memory_order_relaxed);
+#ifdef __linux__
+                syscall(SYS_futex, reinterpret_cast<uint32_t*>(&seq), FUTEX_WAKE_PRIVATE, 1, nullptr, nullptr, 0);
+#endif
+            }
+
+            uint64_t sleepCount() const { return sleeps.load(std::memory_order_relaxed); }
+            uint64_t wakeupCount() const { return wakeups.load(std::memory_order_relaxed); }
+
+            void resetCounts() {
+                sleeps.store(0, std::memory_order_relaxed);
+                wakeups.store(0, std::memory_order_relaxed);
+            }
+
+        private:
+            static_assert(sizeof(std::atomic<uint32_t>) == sizeof(uint32_t), "futex word must be 32 bits");
+
+            alignas(64) std::atomic<uint32_t> seq{ 0 };
+            std::atomic<bool>     sleeping{ false };
+            std::atomic<uint32_t> pending{ 0 };
+            alignas(64) std::atomic<uint64_t> sleeps{ 0 };   // 仅后台线程写
+            std::atomic<uint64_t> wakeups{ 0 };
+        };
+
+    } // namespace LOG
+} // namespace beiklive
+
+#endif  // INC_LOG_WAKE_HH_
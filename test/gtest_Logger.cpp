@@ -1,112 +1,1069 @@
 // test/test_gtest_stress.cpp
 
 #include <gtest/gtest.h>
-#include "../inc/Logger.hpp"
+#include "../inc/log.hh"
 #include <thread>
 #include <random>
 #include <iostream>
 #include <fstream>
-#include <cstdio>  // 使用 std::remove 删除文件
-// 获取文件大小的函数
-std::streamsize getFileSize(const std::string& filename) {
-    std::ifstream file(filename, std::ios::binary | std::ios::ate);
-    if (!file.is_open()) {
-        std::cerr << "Failed to open file: " << filename << std::endl;
-        return -1;
-    }
+#include <filesystem>
+#include <map>
+#include <set>
+#include <sys/wait.h>
 
-    std::streamsize size = file.tellg();
-    file.close();
+using namespace beiklive::LOG;
 
-    return size;
+namespace
+{
+    const std::string kLogDir = "./gtest_log";
 }
 
-// 删除文件的函数
-bool deleteFile(const std::string& filename) {
-    return std::remove(filename.c_str()) == 0;
+// 获取目录下所有日志文件的总大小
+std::uintmax_t getDirectorySize(const std::string& dir) {
+    std::uintmax_t size = 0;
+    std::error_code ec;
+    for (auto& entry : std::filesystem::recursive_directory_iterator(dir, ec)) {
+        if (entry.is_regular_file()) {
+            size += entry.file_size();
+        }
+    }
+    return size;
 }
+
 // Test fixture class
 class LoggerStressTest : public ::testing::Test {
 protected:
     // Per-test-suite set-up
     static void SetUpTestSuite() {
-        Logger::initializeLogger(true);
-        Logger::setLogLevel(Logger::LogLevel::DEBUG);
-        Logger::ConsoleOutputCtrl(true);
+        LogFilePathSet(kLogDir);
+        LoggerLevelSet(LOGLEVEL::DEBUG);
+        LoggerOutputSet(OUTPUT::FILE);
     }
 
     // Per-test-suite tear-down
     static void TearDownTestSuite() {
-        Logger::shutdownLogger();
-            const std::string filename = "Logfile.txt";
-
-            // 获取文件大小
-            std::streamsize size = getFileSize(filename);
+        LoggerStop();
+        // 输出文件大小
+        std::cout << "File size: " << getDirectorySize(kLogDir) / 1024 << " KB" << std::endl;
 
-            // 输出文件大小
-            std::cout << "File size: " << size / 1024 /1024<< " MB" << std::endl;
-
-            // 删除文件
-            if (deleteFile(filename)) {
-                std::cout << "File deleted: " << filename << std::endl;
-            } else {
-                std::cerr << "Error deleting file: " << filename << std::endl;
-            }
+        // 删除文件
+        std::error_code ec;
+        std::filesystem::remove_all(kLogDir, ec);
     }
 };
 
 // Define the stress test function
 void StressTestFunction() {
-    const int iterations = 10000;
+    const int iterations = 1000;
     std::random_device rd;
     std::mt19937 gen(rd());
-    std::uniform_int_distribution<int> levelDistribution(static_cast<int>(Logger::LogLevel::ERROR),
-                                                     static_cast<int>(Logger::LogLevel::DEBUG));
+    std::uniform_int_distribution<int> levelDistribution(static_cast<int>(LOGLEVEL::ERROR),
+                                                     static_cast<int>(LOGLEVEL::DEBUG));
 
 
     for (int i = 0; i < iterations; ++i) {
-        Logger::LogLevel level = static_cast<Logger::LogLevel>(levelDistribution(gen));
+        LOGLEVEL level = static_cast<LOGLEVEL>(levelDistribution(gen));
         switch (level) {
-            case Logger::LogLevel::ERROR:
-                LOG_ERROR("Thread ID: %d - Iteration: %d",std::this_thread::get_id(), i);
+            case LOGLEVEL::ERROR:
+                LOG_ERROR("Thread ID: {} - Iteration: {}", std::this_thread::get_id(), i);
                 break;
-            case Logger::LogLevel::WARNING:
-                LOG_WARNING("Thread ID: %d - Iteration: %d",std::this_thread::get_id(), i);
+            case LOGLEVEL::WARNING:
+                LOG_WARNING("Thread ID: {} - Iteration: {}", std::this_thread::get_id(), i);
                 break;
-            case Logger::LogLevel::INFO:
-                LOG_INFO("Thread ID: %d - Iteration: %d",std::this_thread::get_id(), i);
+            case LOGLEVEL::INFO:
+                LOG_INFO("Thread ID: {} - Iteration: {}", std::this_thread::get_id(), i);
                 break;
-            case Logger::LogLevel::DEBUG:
-                LOG_DEBUG("Thread ID: %d - Iteration: %d",std::this_thread::get_id(), i);
+            case LOGLEVEL::DEBUG:
+                LOG_DEBUG("Thread ID: {} - Iteration: {}", std::this_thread::get_id(), i);
                 break;
             default:
                 break;
         }
+    }
+}
+
+TEST(LoggerFormat, ReplacesPlaceholdersInOrder) {
+    EXPECT_EQ(format("a={} b={}", 1, "two"), "a=1 b=two");
+    EXPECT_EQ(format("no placeholder"), "no placeholder");
+    EXPECT_EQ(format("{}", 3.5), "3.5");
+}
+
+namespace
+{
+    struct Point
+    {
+        int x;
+        int y;
+    };
+
+    std::ostream& operator<<(std::ostream& os, const Point& p) {
+        return os << "(" << p.x << "," << p.y << ")";
+    }
+}
 
-        // Add more stress test assertions as needed
-        ASSERT_TRUE(true);
+TEST(LoggerFormat, FormatsBuiltinTypesWithoutStreams) {
+    EXPECT_EQ(format("{} {} {}", -42, 18446744073709551615ull, static_cast<short>(7)), "-42 18446744073709551615 7");
+    EXPECT_EQ(format("{} {} {}", 0.1, 1.0 / 3, 2.5f), "0.1 0.3333333333333333 2.5");
+    EXPECT_EQ(format("{}{}{}", 'x', true, std::string_view("sv")), "x1sv");
+    EXPECT_EQ(format("{}", reinterpret_cast<void*>(0x1234)), "0x1234");
+    EXPECT_EQ(format("{}", static_cast<const char*>(nullptr)), "(null)");
+    EXPECT_EQ(format("{}", LOGLEVEL::DEBUG), "3");
+    EXPECT_EQ(format("{}", Point{ 1, 2 }), "(1,2)");
+
+    std::ostringstream ss;
+    ss << std::this_thread::get_id();
+    EXPECT_EQ(format("{}", std::this_thread::get_id()), ss.str());
+
+    // 替换进来的内容不再参与后续占位符的替换
+    EXPECT_EQ(format("{} {}", "{}", 1), "{} 1");
+    EXPECT_EQ(format("{} {} {}", 1, 2), "1 2 {}");
+}
+
+TEST(LoggerFormat, AppliesFormatSpecs) {
+    EXPECT_EQ(format("{:x} {:#X} {:o} {:#b}", 255, 255, 8, 5), "ff 0XFF 10 0b101");
+    EXPECT_EQ(format("{:B} {:#B}", 5, 5), "101 0B101");
+    static_assert(checkFormat("{:B} {:#B}"), "");
+    EXPECT_EQ(format("{:08.3f}|{:+.2e}|{:.3}", 3.14159, 12345.678, 2.0 / 3), "0003.142|+1.23e+04|0.667");
+    EXPECT_EQ(format("[{:>6}][{:<6}][{:*^7}]", "ab", 42, "mid"), "[    ab][42    ][**mid**]");
+    EXPECT_EQ(format("{:05}|{:+d}|{:.2s}|{:c}", -42, 7, "hello", 65), "-0042|+7|he|A");
+    EXPECT_EQ(format("{{{}}} {name:>3}", 1, 2), "{1}   2");
+
+    // 编译期解析出的程序与运行时解析结果一致
+    static constexpr auto steps = compileFormat<countFormatSteps("id={:04x} v={:.1f} {}")>("id={:04x} v={:.1f} {}");
+    static_assert(steps.count == 3 && steps.steps[0].spec.width == 4 && steps.steps[0].spec.type == 'x', "");
+    static_assert(steps.steps[1].spec.precision == 1 && !steps.steps[2].spec.present, "");
+    constexpr FormatProgram program{ "id={:04x} v={:.1f} {}", steps.steps, steps.count };
+    std::string out;
+    formatProgram(out, program, 0xab, 2.25, Point{ 3, 4 });
+    EXPECT_EQ(out, "id=00ab v=2.2 (3,4)");
+    out.clear();
+    formatProgram(out, program, 1);
+    EXPECT_EQ(out, "id=0001 v={:.1f} {}");
+}
+
+TEST(LoggerFormat, ChecksLiteralPatternFields) {
+    static_assert(checkFormat("{} {:>3} {:08.3f} {{name}} {unclosed"), "");
+    static_assert(!checkFormat("{name:>3}"), "named field");
+    static_assert(!checkFormat("{0}"), "indexed field");
+    static_assert(!checkFormat("{:>3q}"), "unknown type");
+    static_assert(!checkFormat("{:dd}"), "trailing characters");
+    static_assert(!checkFormat("{:.f}"), "precision without digits");
+
+    // 只有字符串字面量得到编译期程序
+    const std::string text = "{}";
+    const char* pointer = "{}";
+    static_assert(literalPattern("{}") != nullptr, "");
+    EXPECT_EQ(literalPattern(text), nullptr);
+    EXPECT_EQ(literalPattern(pointer), nullptr);
+}
+
+TEST(LoggerRecent, TinyCapacityIsClampedAndKeepsNewestRecord) {
+    for (size_t bytes : { 1, 16, 20, 31, 64 }) {
+        RecentLog log;
+        log.configure(bytes);
+        ASSERT_TRUE(log.enabled());
+        for (int i = 0; i < 100; ++i) {
+            log.append(i, 2, std::string(40, static_cast<char>('a' + i % 26)));
+        }
+        std::vector<std::string> lines = log.query(RecentQuery());
+        ASSERT_FALSE(lines.empty());
+        EXPECT_EQ(lines.size(), log.size());
+        EXPECT_EQ(lines.back(), std::string(lines.back().size(), 'a' + 99 % 26));
     }
 }
 
+TEST(LoggerFormat, RendersHexDumpLikeHexdumpC) {
+    const char data[] = "Hello world\n\x01\x80\xff tail";
+    EXPECT_EQ(format("{}", HexDump{ reinterpret_cast<const uint8_t*>(data), 20, 20 }),
+              "hexdump 20 bytes\n"
+              "00000000  48 65 6c 6c 6f 20 77 6f  72 6c 64 0a 01 80 ff 20  |Hello world.... |\n"
+              "00000010  74 61 69 6c                                       |tail|");
+
+    // 每个字节值的十六进制与 ASCII 列都与逐字节的结果一致
+    uint8_t all[256];
+    for (int i = 0; i < 256; ++i) {
+        all[i] = static_cast<uint8_t>(i);
+    }
+    std::string dump;
+    appendHexDump(dump, all, sizeof(all));
+    std::istringstream lines(dump);
+    int row = 0;
+    for (std::string line; std::getline(lines, line); ++row) {
+        ASSERT_EQ(line.size(), 78u);
+        for (int i = 0; i < 16; ++i) {
+            int b = row * 16 + i;
+            char hex[3];
+            std::snprintf(hex, sizeof(hex), "%02x", b);
+            EXPECT_EQ(line.substr(10 + 3 * i + (i >= 8), 2), hex);
+            EXPECT_EQ(line[61 + i], b >= 0x20 && b < 0x7f ? static_cast<char>(b) : '.');
+        }
+    }
+    EXPECT_EQ(row, 16);
 
+    LoggerHexDumpLimitSet(16);
+    HexDump truncated = hexDumpArg(all, sizeof(all));
+    EXPECT_EQ(format("{}", truncated), "hexdump 256 bytes (first 16)\n" + dump.substr(0, 78));
+    LoggerHexDumpLimitSet(4096);
+}
 
+TEST(LoggerClock, TscConvertsToWallClock) {
+    TscClock::calibrate();
+    uint64_t ticks = TscClock::now();
+    int64_t wall = systemNowNs();
+    EXPECT_LT(std::llabs(TscClock::toWallNs(ticks) - wall), 1000000);
+}
+
+TEST(LoggerClock, TimestampPrecision) {
+    const int64_t ns = 1700000000123456789;
+    EXPECT_EQ(formatTimestamp(ns, PRECISION::MILLI).substr(20), "123");
+    EXPECT_EQ(formatTimestamp(ns, PRECISION::MICRO).substr(20), "123456");
+    EXPECT_EQ(formatTimestamp(ns, PRECISION::NANO).substr(20), "123456789");
+}
+
+TEST(LoggerMetrics, HistogramPercentiles) {
+    static LatencyHistogram h;
+    for (uint64_t i = 1; i <= 1000; ++i) {
+        h.record(i);
+    }
+    EXPECT_EQ(h.count(), 1000u);
+    EXPECT_EQ(h.min(), 1u);
+    EXPECT_EQ(h.max(), 1000u);
+    // 相对误差不超过一个子桶
+    EXPECT_NEAR(static_cast<double>(h.percentile(0.5)), 500.0, 500.0 / LatencyHistogram::SUB_BUCKETS + 1);
+    EXPECT_LE(h.percentile(0.999), h.max());
+}
+
+TEST(LoggerMetrics, TimerHistogramsMergeAcrossThreads) {
+    static TimerRegistry registry;
+    static const SpanSite fast{ "fast", "f", "f", 1 };
+    static const SpanSite slow{ "slow", "g", "g", 2 };
+    static const SpanSite slowAgain{ "slow", "h", "h", 3 };   // 同名调用点合并统计
+
+    std::vector<std::thread> threads;
+    for (int t = 0; t < 4; ++t) {
+        threads.emplace_back([] {
+            for (uint64_t i = 1; i <= 1000; ++i) {
+                registry.record(fast, i);
+                registry.record(i % 2 ? slow : slowAgain, 1000000 + i);
+            }
+        });
+    }
+    for (auto& thread : threads) {
+        thread.join();   // 线程退出时计数并入下一周期
+    }
+    registry.record(fast, 5000);   // 仍在运行的线程由 collect() 取走
+
+    std::map<std::string, LatencySummary> interval;
+    for (const TimerSummary& t : registry.collect()) {
+        interval[t.name] = t.ns;
+    }
+    ASSERT_EQ(interval.size(), 2u);
+    EXPECT_EQ(interval["fast"].count, 4001u);
+    EXPECT_EQ(interval["fast"].max, 5000u);
+    EXPECT_NEAR(static_cast<double>(interval["fast"].p50), 500.0, 500.0 / LatencyHistogram::SUB_BUCKETS + 1);
+    EXPECT_EQ(interval["slow"].count, 4000u);
+    EXPECT_GE(interval["slow"].p99, 1000000u);
+    EXPECT_EQ(slow.timerSlot.load(), slowAgain.timerSlot.load());
+
+    // 已汇总的计数不再出现在下一周期，但计入累计统计
+    registry.record(slow, 7);
+    std::vector<TimerSummary> next = registry.collect();
+    ASSERT_EQ(next.size(), 1u);
+    EXPECT_EQ(next[0].ns.count, 1u);
+    for (const TimerSummary& t : registry.totals()) {
+        EXPECT_EQ(t.ns.count, 4001u) << t.name;
+    }
+}
+
+TEST(LoggerDirectFile, KeepsTailBlockAcrossFlushAndReopen) {
+    const std::string path = "./gtest_direct.log";
+    std::error_code ec;
+    std::filesystem::remove(path, ec);
+
+    std::string expected;
+    {
+        // 缓冲区只有两个块，写满时交给 I/O 线程，末尾不足一块
+        DirectFileWriter writer(2 * DirectFileWriter::BLOCK);
+        ASSERT_TRUE(writer.open(path));
+        for (int i = 0; i < 1000; ++i) {
+            std::string line = "line " + std::to_string(i) + "\n";
+            writer.write(line.data(), line.size());
+            expected += line;
+        }
+        writer.flush();
+        EXPECT_EQ(std::filesystem::file_size(path), expected.size());
+        writer.write("tail\n", 5);
+        expected += "tail\n";
+    }
+    {
+        // 追加打开未对齐的文件，尾部块读回后继续写
+        DirectFileWriter writer(2 * DirectFileWriter::BLOCK);
+        ASSERT_TRUE(writer.open(path));
+        EXPECT_EQ(writer.size(), static_cast<long long>(expected.size()));
+        writer.write("again\n", 6);
+        expected += "again\n";
+    }
+
+    std::ifstream in(path, std::ios::binary);
+    std::string content((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+    EXPECT_EQ(content, expected);
+    std::filesystem::remove(path, ec);
+}
+
+TEST(LoggerTimeIndex, MapsTimeRangeToByteRange) {
+    const std::string path = "./gtest_index.idx";
+    const int64_t base = 1700000000;
+    TimeIndex index(1);
+    // 每秒 10 条、每条 100 字节，第 2 秒出现一条乱序的早期记录
+    int64_t offset = 0;
+    for (int64_t sec = 0; sec < 10; ++sec) {
+        for (int i = 0; i < 10; ++i) {
+            index.observe((base + sec) * 1000000000 + i * 1000000, offset);
+            offset += 100;
+        }
+        if (sec == 2) {
+            index.observe(base * 1000000000, offset);
+            offset += 100;
+        }
+    }
+    ASSERT_EQ(index.data().size(), 10u);
+    ASSERT_TRUE(index.save(path));
+
+    TimeIndex loaded;
+    ASSERT_TRUE(loaded.load(path));
+    int64_t begin = 0;
+    int64_t end = 0;
+    ASSERT_TRUE(loaded.range(base + 3, base + 4, 1, &begin, &end));
+    EXPECT_EQ(begin, 3100);
+    EXPECT_EQ(end, 6100);
+    ASSERT_TRUE(loaded.range(base + 8, base + 20, 1, &begin, &end));
+    EXPECT_EQ(end, -1);
+    EXPECT_FALSE(loaded.range(base + 11, base + 20, 1, &begin, &end));
+    EXPECT_FALSE(loaded.range(base - 10, base - 1, 1, &begin, &end));
+
+    std::error_code ec;
+    std::filesystem::remove(path, ec);
+}
 
 TEST_F(LoggerStressTest, StressTestAllLevels) {
-    const int numThreads = 64;
+    const int numThreads = 16;
     std::vector<std::thread> threads;
 
+    LoggerMetricsReset();
     // Launch multiple threads to simulate stress for each log level
     for (int i = 0; i < numThreads; ++i) {
         threads.emplace_back(StressTestFunction);
+    }
+
+    // Wait for all threads to finish
+    for (auto& thread : threads) {
+        thread.join();
+    }
+
+    MetricsSnapshot snap = LoggerMetricsSnapshot();
+    uint64_t records = 0;
+    for (auto n : snap.levelRecords) {
+        records += n;
+    }
+    EXPECT_EQ(records, static_cast<uint64_t>(numThreads) * 1000);
+    EXPECT_EQ(snap.sinkRecords[static_cast<size_t>(SINK::FILE)], records);
+    EXPECT_EQ(snap.dropped, 0u);
+    EXPECT_EQ(snap.queueDepth, 0);
+}
+
+TEST_F(LoggerStressTest, AsyncBackendDrainsOnStop) {
+    const int numThreads = 8;
+    std::vector<std::thread> threads;
+
+    BackendOptions options;
+    options.ringCapacity = 1 << 14;
+    ASSERT_TRUE(LoggerAsyncStart(options));
+    EXPECT_TRUE(isAsyncOutput());
+    LoggerMetricsReset();
+    for (int i = 0; i < numThreads; ++i) {
         threads.emplace_back(StressTestFunction);
-        threads.emplace_back(StressTestFunction);
+    }
+    for (auto& thread : threads) {
+        thread.join();
+    }
+    LoggerAsyncStop();
+    EXPECT_FALSE(isAsyncOutput());
+
+    MetricsSnapshot snap = LoggerMetricsSnapshot();
+    EXPECT_EQ(snap.sinkRecords[static_cast<size_t>(SINK::FILE)], static_cast<uint64_t>(numThreads) * 1000);
+    EXPECT_EQ(snap.dropped, 0u);
+    EXPECT_EQ(snap.queueDepth, 0);
+    EXPECT_GT(snap.queuePeak, 0);   // 由后台从各队列计数观察得到
+}
+
+TEST_F(LoggerStressTest, OrderWindowWritesRecordsChronologically) {
+    BackendOptions options;
+    options.orderWindow = std::chrono::milliseconds(50);
+    LoggerTimestampPrecisionSet(PRECISION::NANO);
+    ASSERT_TRUE(LoggerAsyncStart(options));
+    std::vector<std::thread> threads;
+    for (int t = 0; t < 8; ++t) {
+        threads.emplace_back([t] {
+            for (int i = 0; i < 500; ++i) {
+                LOG_INFO("ordered marker {} {}", t, i);
+                if (i % 100 == 0) {
+                    std::this_thread::sleep_for(std::chrono::milliseconds(1));
+                }
+            }
+        });
+    }
+    for (auto& thread : threads) {
+        thread.join();
+    }
+    LoggerAsyncStop();
+    LoggerTimestampPrecisionSet(PRECISION::MILLI);
+
+    size_t records = 0;
+    std::string last;
+    std::error_code ec;
+    for (auto& entry : std::filesystem::recursive_directory_iterator(kLogDir, ec)) {
+        if (!entry.is_regular_file() || entry.path().extension() != ".log") {
+            continue;
+        }
+        std::ifstream in(entry.path());
+        for (std::string line; std::getline(in, line);) {
+            if (line.find("ordered marker ") == std::string::npos) {
+                continue;
+            }
+            std::string stamp = line.substr(0, line.find(']'));
+            EXPECT_GE(stamp, last) << line;
+            last = stamp;
+            ++records;
+        }
+    }
+    EXPECT_EQ(records, 8u * 500);
+}
+
+TEST_F(LoggerStressTest, NotifyWakeDeliversTrickleAndStopsPromptly) {
+    BackendOptions options;
+    options.wake = WAKEMODE::NOTIFY;
+    options.wakeBatch = 1;
+    options.wakeTimeout = std::chrono::seconds(10);
+    ASSERT_TRUE(LoggerAsyncStart(options));
+    LoggerMetricsReset();
+
+    // 每条之间留出足够时间让后台睡下，记录只能靠生产者唤醒
+    for (int i = 0; i < 20; ++i) {
+        LOG_INFO("trickle {}", i);
+        std::this_thread::sleep_for(std::chrono::milliseconds(2));
+    }
+    auto begin = std::chrono::steady_clock::now();
+    while (LoggerMetricsSnapshot().queueDepth != 0 &&
+           std::chrono::steady_clock::now() - begin < std::chrono::seconds(5)) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    EXPECT_LT(std::chrono::steady_clock::now() - begin, std::chrono::seconds(5));
+    BackendStats stats = LoggerBackendStats();
+    EXPECT_GT(stats.sleeps, 0u);
+    EXPECT_GT(stats.wakeups, 0u);
+
+    begin = std::chrono::steady_clock::now();
+    LoggerAsyncStop();
+    EXPECT_LT(std::chrono::steady_clock::now() - begin, std::chrono::seconds(5));
+
+    MetricsSnapshot snap = LoggerMetricsSnapshot();
+    EXPECT_EQ(snap.sinkRecords[static_cast<size_t>(SINK::FILE)], 20u);
+    EXPECT_EQ(snap.queueLatencyNs.count, 20u);
+}
+
+namespace
+{
+    void spanLeaf()
+    {
+        LOG_SCOPE("leaf");
+    }
+
+    void spanOuter()
+    {
+        LOG_SCOPE("outer");
+        LOG_SPAN("inner") {
+            spanLeaf();
+        }
+    }
+}
+
+TEST_F(LoggerStressTest, SpansAggregateDurationAndDepth) {
+    LoggerSpanReset();
+    spanOuter();   // 同步模式在调用线程汇总
+
+    ASSERT_TRUE(LoggerAsyncStart());
+    std::vector<std::thread> threads;
+    for (int i = 0; i < 4; ++i) {
+        threads.emplace_back([] {
+            for (int j = 0; j < 1000; ++j) {
+                spanOuter();
+            }
+        });
+    }
+    for (auto& thread : threads) {
+        thread.join();
+    }
+    LoggerAsyncStop();
+
+    std::map<std::string, SpanStats> byName;
+    for (const SpanStats& s : LoggerSpanStats()) {
+        byName[s.site->name] = s;
+    }
+    ASSERT_EQ(byName.size(), 3u);
+    for (const char* name : { "outer", "inner", "leaf" }) {
+        EXPECT_EQ(byName[name].count, 4001u) << name;
+        EXPECT_LE(byName[name].minNs, byName[name].maxNs) << name;
+    }
+    EXPECT_EQ(byName["outer"].maxDepth, 0u);
+    EXPECT_EQ(byName["inner"].maxDepth, 1u);
+    EXPECT_EQ(byName["leaf"].maxDepth, 2u);
+    EXPECT_GE(byName["outer"].totalNs, byName["leaf"].totalNs);
+    EXPECT_EQ(spanDepth(), 0u);
+}
+
+TEST_F(LoggerStressTest, TraceWritesSpansAndRecordsAsTraceEvents) {
+    const std::string path = kLogDir + "/trace.json";
+    std::filesystem::create_directories(kLogDir);
+    ASSERT_TRUE(LoggerTraceStart(path));
+    ASSERT_TRUE(LoggerAsyncStart());
+    std::thread worker([] {
+        for (int i = 0; i < 10; ++i) {
+            spanOuter();
+            LOG_INFO("quote \" and\ttab {}", i);
+        }
+    });
+    worker.join();
+    LoggerAsyncStop();
+    LoggerTraceStop();
+
+    std::ifstream in(path);
+    std::vector<std::string> lines;
+    for (std::string line; std::getline(in, line);) {
+        lines.push_back(line);
+    }
+    ASSERT_GE(lines.size(), 2u);
+    EXPECT_EQ(lines.front(), "[");
+    EXPECT_EQ(lines.back(), "]");
+    size_t spans = 0;
+    size_t instants = 0;
+    std::set<std::string> tids;
+    for (size_t i = 1; i + 1 < lines.size(); ++i) {
+        const std::string& line = lines[i];
+        EXPECT_EQ(line.front(), '{');
+        EXPECT_EQ(line.back(), i + 2 < lines.size() ? ',' : '}');
+        if (line.find("\"ph\":\"X\"") != std::string::npos) {
+            ++spans;
+        }
+        else if (line.find("\"ph\":\"i\"") != std::string::npos) {
+            ++instants;
+            EXPECT_NE(line.find("quote \\\" and\\u0009tab"), std::string::npos) << line;
+        }
+        size_t tid = line.find("\"tid\":");
+        ASSERT_NE(tid, std::string::npos);
+        tids.insert(line.substr(tid, line.find(',', tid) - tid));
+    }
+    EXPECT_EQ(spans, 30u);
+    EXPECT_EQ(instants, 10u);
+    EXPECT_EQ(tids.size(), 1u);   // 全部来自工作线程，而不是后台线程
+}
+
+TEST_F(LoggerStressTest, ContextTravelsWithQueuedRecords) {
+    ASSERT_TRUE(LoggerAsyncStart());
+    std::thread worker([] {
+        LogContext request{ "req_id", "ctx-7" };
+        for (int i = 0; i < 100; ++i) {
+            LogContext attempt{ "attempt", i };
+            LOG_INFO("context marker {}", i);
+        }
+    });
+    worker.join();   // 作用域已结束，记录仍在队列中
+    LOG_INFO("context cleared marker");
+    EXPECT_EQ(currentContext(), nullptr);
+    LoggerAsyncStop();
+
+    size_t marked = 0;
+    std::error_code ec;
+    for (auto& entry : std::filesystem::recursive_directory_iterator(kLogDir, ec)) {
+        if (!entry.is_regular_file() || entry.path().extension() != ".log") {
+            continue;
+        }
+        std::ifstream in(entry.path());
+        for (std::string line; std::getline(in, line);) {
+            size_t at = line.find("context marker ");
+            if (at != std::string::npos) {
+                std::string i = line.substr(at + 15);
+                EXPECT_NE(line.find("[req_id=ctx-7 attempt=" + i + "] "), std::string::npos) << line;
+                ++marked;
+            }
+            if (line.find("context cleared marker") != std::string::npos) {
+                EXPECT_EQ(line.find("req_id"), std::string::npos) << line;
+            }
+        }
+    }
+    EXPECT_EQ(marked, 100u);
+}
+
+TEST_F(LoggerStressTest, DirectFileModeRotatesWithoutPadding) {
+    LogFileModeSet(FILEMODE::DIRECT);
+    LogFileSizeSet(64 * 1024);
+    ASSERT_TRUE(LoggerAsyncStart());
+    std::vector<std::thread> threads;
+    for (int i = 0; i < 4; ++i) {
         threads.emplace_back(StressTestFunction);
     }
+    for (auto& thread : threads) {
+        thread.join();
+    }
+    LoggerAsyncStop();
+    LogFileModeSet(FILEMODE::BUFFERED);
+    LogFileSizeSet();
 
-    // Wait for all threads to finish
+    // 轮转和关闭时末尾块都已截断回真实长度，文件中不应残留补齐用的 0 字节
+    std::error_code ec;
+    for (auto& entry : std::filesystem::recursive_directory_iterator(kLogDir, ec)) {
+        if (!entry.is_regular_file() || entry.path().extension() != ".log") {
+            continue;
+        }
+        std::ifstream in(entry.path(), std::ios::binary);
+        std::string content((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+        EXPECT_EQ(content.find('\0'), std::string::npos) << entry.path();
+        EXPECT_TRUE(content.empty() || content.back() == '\n') << entry.path();
+    }
+}
+
+TEST_F(LoggerStressTest, ShardsFilesPerThreadInSyncAndAsyncModes) {
+    LogFileShardSet(true);
+    auto writers = [](const char* tag) {
+        std::vector<std::thread> threads;
+        for (int t = 0; t < 4; ++t) {
+            threads.emplace_back([tag, t] {
+                for (int i = 0; i < 200; ++i) {
+                    LOG_INFO("shard marker {} {} {}", tag, t, i);
+                }
+            });
+        }
+        for (auto& thread : threads) {
+            thread.join();
+        }
+    };
+    writers("sync");
+    ASSERT_TRUE(LoggerAsyncStart());
+    writers("async");
+    LoggerAsyncStop();
+    LogFileClose();
+    LogFileShardSet(false);
+
+    // 每个分片只含一个线程的记录，且时间戳（纳秒精度）与写入顺序一致
+    std::map<std::string, int> owners;
+    size_t records = 0;
+    std::error_code ec;
+    for (auto& entry : std::filesystem::recursive_directory_iterator(kLogDir, ec)) {
+        if (!entry.is_regular_file() || entry.path().filename().string().rfind("shard_", 0) != 0 ||
+            entry.path().extension() != ".log") {
+            continue;
+        }
+        std::ifstream in(entry.path());
+        std::string owner;
+        std::string lastStamp;
+        int lastIndex = -1;
+        for (std::string line; std::getline(in, line);) {
+            size_t at = line.find("shard marker ");
+            if (at == std::string::npos) {
+                continue;
+            }
+            std::string stamp = line.substr(0, line.find(']'));
+            EXPECT_EQ(stamp.size(), 30u) << line;   // "[YYYY-mm-dd HH:MM:SS.nnnnnnnnn"
+            EXPECT_GE(stamp, lastStamp) << line;
+            lastStamp = stamp;
+            std::string rest = line.substr(at + 13);
+            std::string who = rest.substr(0, rest.rfind(' '));
+            int index = std::stoi(rest.substr(rest.rfind(' ') + 1));
+            if (owner.empty()) {
+                owner = who;
+                ++owners[who];
+            }
+            EXPECT_EQ(who, owner) << entry.path();
+            EXPECT_GT(index, lastIndex);
+            lastIndex = index;
+            ++records;
+        }
+    }
+    EXPECT_EQ(records, 2u * 4 * 200);
+    EXPECT_EQ(owners.size(), 8u);
+    for (auto& kv : owners) {
+        EXPECT_EQ(kv.second, 1) << kv.first;
+    }
+}
+
+namespace
+{
+    // 目录下所有 .log 文件中包含 marker 的行数
+    size_t countLines(const std::string& dir, const std::string& marker, size_t* files = nullptr)
+    {
+        size_t lines = 0;
+        std::error_code ec;
+        for (auto& entry : std::filesystem::recursive_directory_iterator(dir, ec)) {
+            if (!entry.is_regular_file() || entry.path().extension() != ".log") {
+                continue;
+            }
+            if (files) {
+                ++*files;
+            }
+            std::ifstream in(entry.path());
+            for (std::string line; std::getline(in, line);) {
+                lines += line.find(marker) != std::string::npos;
+            }
+        }
+        return lines;
+    }
+}
+
+TEST_F(LoggerStressTest, IndependentLoggersKeepSeparateFilesAndPolicies) {
+    LoggerOptions accessOptions;
+    accessOptions.dir = kLogDir + "/access";
+    accessOptions.maxFileSize = 16 * 1024;
+    accessOptions.flush = FLUSHPOLICY::BATCH;
+    accessOptions.async = true;
+    Logger access(accessOptions);
+
+    LoggerOptions auditOptions;
+    auditOptions.dir = kLogDir + "/audit";
+    auditOptions.flush = FLUSHPOLICY::DURABLE;
+    auditOptions.level = LOGLEVEL::WARNING;
+    Logger audit(auditOptions);
+
+    std::vector<std::thread> threads;
+    for (int t = 0; t < 4; ++t) {
+        threads.emplace_back([&access, t] {
+            for (int i = 0; i < 500; ++i) {
+                LOG_INFO_TO(access, "access marker {} {}", t, i);
+            }
+        });
+    }
+    LOG_WARNING_TO(audit, "audit marker {}", 1);
+    LOG_INFO_TO(audit, "audit marker {}", 2);   // 低于该实例的级别
+    // 同步落盘的实例返回时记录已写入文件
+    EXPECT_EQ(countLines(auditOptions.dir, "audit marker"), 1u);
     for (auto& thread : threads) {
         thread.join();
     }
+    access.stop();
+    audit.stop();
+
+    size_t accessFiles = 0;
+    EXPECT_EQ(countLines(accessOptions.dir, "access marker", &accessFiles), 4u * 500);
+    EXPECT_GT(accessFiles, 1u);   // 按实例自己的大小上限轮转
+    EXPECT_EQ(countLines(accessOptions.dir, "audit marker"), 0u);
+    EXPECT_EQ(countLines(auditOptions.dir, "access marker"), 0u);
+}
+
+TEST_F(LoggerStressTest, LoggersSharingADirectoryWriteSeparateFiles) {
+    LoggerOptions options;
+    options.dir = kLogDir + "/shared_dir";
+    Logger first(options);
+    Logger second(options);
+    for (int i = 0; i < 300; ++i) {
+        LOG_INFO_TO(first, "first marker {}", i);
+        LOG_INFO_TO(second, "second marker {}", i);
+    }
+    first.stop();
+    second.stop();
+
+    size_t files = 0;
+    EXPECT_EQ(countLines(options.dir, "first marker", &files), 300u);
+    EXPECT_EQ(countLines(options.dir, "second marker"), 300u);
+    EXPECT_EQ(files, 2u);
+}
+
+TEST_F(LoggerStressTest, RingAllocationFailureFallsBackToSyncWrites) {
+    std::ifstream overcommit("/proc/sys/vm/overcommit_memory");
+    int mode = 0;
+    if (overcommit >> mode && mode == 1) {
+        GTEST_SKIP() << "overcommit_memory=1 would let the oversized ring map";
+    }
+    // 远超物理内存与交换区的队列无法分配，记录改由调用线程同步写出
+    LoggerOptions options;
+    options.dir = kLogDir + "/no_ring";
+    options.async = true;
+    options.backend.ringCapacity = size_t(1) << 46;
+    Logger logger(options);
+    for (int i = 0; i < 10; ++i) {
+        LOG_INFO_TO(logger, "no ring marker {}", i);
+    }
+    EXPECT_EQ(countLines(options.dir, "no ring marker"), 10u);
+    logger.stop();
+}
+
+TEST_F(LoggerStressTest, FlushWaitsForRecordsEnqueuedBeforeIt) {
+    LoggerOptions options;
+    options.dir = kLogDir + "/flush";
+    options.flush = FLUSHPOLICY::BATCH;
+    options.async = true;
+    options.backend.orderWindow = std::chrono::milliseconds(200);   // 后台至少压住记录 200ms
+    Logger logger(options);
+
+    for (int i = 0; i < 300; ++i) {
+        LOG_INFO_TO(logger, "flush marker {}", i);
+    }
+    FlushRequest drained = logger.drain();
+    EXPECT_FALSE(drained.done());
+    EXPECT_TRUE(drained.wait(std::chrono::seconds(5)));
+    EXPECT_EQ(countLines(options.dir, "flush marker"), 300u);
+
+    LOG_INFO_TO(logger, "flush marker {}", 300);
+    EXPECT_TRUE(logger.flush(std::chrono::seconds(5)));
+    EXPECT_EQ(countLines(options.dir, "flush marker"), 301u);
+
+    // 全局日志：同步与异步模式下都在返回前写出
+    LOG_INFO("global flush marker {}", 0);
+    EXPECT_TRUE(LoggerFlush(std::chrono::seconds(5)));
+    ASSERT_TRUE(LoggerAsyncStart());
+    LOG_INFO("global flush marker {}", 1);
+    EXPECT_TRUE(LoggerFlush(std::chrono::seconds(5)));
+    EXPECT_EQ(countLines(kLogDir, "global flush marker"), 2u);
+    LoggerAsyncStop();
+}
+
+namespace
+{
+    void filterNetRequest(int ms)
+    {
+        LOG_INFO("filter marker net latency={}ms", ms);
+    }
+
+    void filterDiskRequest(int ms)
+    {
+        LOG_INFO("filter marker disk latency={}ms", ms);
+    }
+}
+
+TEST_F(LoggerStressTest, RuntimeFilterSelectsCallsitesAndFields) {
+    EXPECT_FALSE(LoggerFilterSet("latency>"));
+    EXPECT_FALSE(LoggerFilterSet("level:LOUD"));
+    EXPECT_FALSE(LoggerFilterSet("msg~\"(\""));
+    ASSERT_TRUE(LoggerFilterSet("func:*filterNet* && latency>10ms"));
+
+    // 只依赖调用点的部分在调用点判定
+    Callsite disk{ "void disk::read(int)", "disk.cc", 1 };
+    Callsite net{ "void filterNetRequest(int)", "net.cc", 1 };
+    EXPECT_EQ(callsiteFilter(LOGLEVEL::INFO, disk), FILTERMATCH::NO);
+    EXPECT_EQ(callsiteFilter(LOGLEVEL::INFO, net), FILTERMATCH::MAYBE);
+
+    filterNetRequest(5);
+    filterNetRequest(20);
+    filterDiskRequest(20);
+    EXPECT_EQ(countLines(kLogDir, "filter marker"), 1u);
+
+    ASSERT_TRUE(LoggerAsyncStart());
+    filterNetRequest(3);
+    filterNetRequest(11);
+    {
+        LogContext ctx{ "latency", "0.5s" };   // 字段也可以来自诊断上下文
+        LOG_INFO("filter marker outside");
+        filterNetRequest(1);
+    }
+    filterDiskRequest(50);
+    LoggerAsyncStop();
+    EXPECT_EQ(countLines(kLogDir, "filter marker"), 3u);
+
+    ASSERT_TRUE(LoggerFilterSet("msg~\"disk latency=[0-9]{2}ms\" || level:ERROR"));
+    filterDiskRequest(7);
+    filterDiskRequest(70);
+    filterNetRequest(70);
+    EXPECT_EQ(countLines(kLogDir, "filter marker"), 4u);
+
+    ASSERT_TRUE(LoggerFilterSet(""));
+    filterDiskRequest(1);
+    EXPECT_EQ(countLines(kLogDir, "filter marker"), 5u);
+}
+
+TEST_F(LoggerStressTest, RuntimePatternsAreParsedAtRuntime) {
+    const std::string pattern = "runtime marker {:>4}|{}";
+    const char* plain = "runtime marker plain";
+    LOG_INFO(pattern, 7, "s");
+    LOG_INFO(plain);
+    LOGGER_WARNING(std::string("runtime marker {:x}"), 255);
+    EXPECT_EQ(countLines(kLogDir, "runtime marker    7|s"), 1u);
+    EXPECT_EQ(countLines(kLogDir, "runtime marker plain"), 1u);
+    EXPECT_EQ(countLines(kLogDir, "runtime marker ff"), 1u);
+}
+
+TEST_F(LoggerStressTest, TopCallsitesRankByEmittedBytes) {
+    LoggerCallsiteStatsReset();
+    LoggerMetricsReset();
+    const std::string payload(200, 'x');
+    ASSERT_TRUE(LoggerAsyncStart());
+    for (int i = 0; i < 100; ++i) {
+        LOG_INFO("noisy line {} {}", i, payload);
+        if (i % 10 == 0) {
+            LOG_WARNING("quiet line {}", i);
+        }
+    }
+    LOG_DEBUG("chatty but short {}", 1);
+    LoggerAsyncStop();
+
+    uint64_t total = 0;
+    std::vector<CallsiteVolume> top = LoggerTopCallsites(2, &total);
+    ASSERT_EQ(top.size(), 2u);
+    EXPECT_EQ(top[0].records, 100u);
+    EXPECT_EQ(top[1].records, 10u);
+    EXPECT_GT(top[0].bytes, 100u * payload.size());
+    EXPECT_GT(top[0].bytes, top[1].bytes);
+    EXPECT_EQ(top[0].callsite->line + 2, top[1].callsite->line);
+    EXPECT_GT(total, top[0].bytes + top[1].bytes);
+    // 调用点与输出端按同样的方式计字节（含换行符）
+    EXPECT_EQ(total, LoggerMetricsSnapshot().sinkBytes[static_cast<size_t>(SINK::FILE)]);
+
+    LoggerTopCallsitesDump(2);
+    EXPECT_EQ(countLines(kLogDir, "[top] "), 2u);
+}
+
+TEST_F(LoggerStressTest, SharedRingCollectsRecordsFromChildProcesses) {
+    const int numChildren = 4;
+    SharedOptions options;
+    options.slots = 8;
+    options.ringCapacity = 1 << 14;
+    ASSERT_TRUE(LoggerSharedStart(options));
+    LoggerMetricsReset();
+
+    std::vector<pid_t> children;
+    for (int i = 0; i < numChildren; ++i) {
+        pid_t pid = fork();
+        ASSERT_GE(pid, 0);
+        if (pid == 0) {
+            StressTestFunction();
+            _exit(isSharedOutput() ? 0 : 1);
+        }
+        children.push_back(pid);
+    }
+    for (pid_t pid : children) {
+        int status = 0;
+        waitpid(pid, &status, 0);
+        EXPECT_TRUE(WIFEXITED(status) && WEXITSTATUS(status) == 0);
+    }
+    EXPECT_FALSE(isSharedOutput());
+    LoggerSharedStop();
+
+    // 子进程的记录全部由本进程写出，并带有来源 PID
+    MetricsSnapshot snap = LoggerMetricsSnapshot();
+    EXPECT_EQ(snap.sinkRecords[static_cast<size_t>(SINK::FILE)], static_cast<uint64_t>(numChildren) * 1000);
+    LogFileFlush();
+    std::string content;
+    std::error_code ec;
+    for (auto& entry : std::filesystem::recursive_directory_iterator(kLogDir, ec)) {
+        if (entry.is_regular_file()) {
+            std::ifstream in(entry.path(), std::ios::binary);
+            content.append(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+        }
+    }
+    for (pid_t pid : children) {
+        EXPECT_NE(content.find("[pid:" + std::to_string(pid) + "]"), std::string::npos);
+    }
+}
+
+// 生产者进程在其他线程仍在写共享队列时退出共享队列，不应访问已解除的映射
+TEST_F(LoggerStressTest, ProducerStopsSharedRingWhileSiblingThreadsLog) {
+    SharedOptions options;
+    options.ringCapacity = 1 << 14;
+    ASSERT_TRUE(LoggerSharedStart(options));
+    std::vector<pid_t> children;
+    for (int c = 0; c < 4; ++c) {
+        pid_t pid = fork();
+        ASSERT_GE(pid, 0);
+        if (pid == 0) {
+            std::atomic<bool> done{ false };
+            std::vector<std::thread> threads;
+            for (int t = 0; t < 4; ++t) {
+                threads.emplace_back([&done, t] {
+                    for (int i = 0; !done.load(std::memory_order_relaxed); ++i) {
+                        LOG_INFO("producer stop marker {} {}", t, i);
+                    }
+                });
+            }
+            std::this_thread::sleep_for(std::chrono::milliseconds(20));
+            LoggerSharedStop();
+            const bool stopped = !isSharedOutput();
+            std::this_thread::sleep_for(std::chrono::milliseconds(10));
+            done.store(true);
+            for (auto& thread : threads) {
+                thread.join();
+            }
+            _exit(stopped ? 0 : 1);
+        }
+        children.push_back(pid);
+    }
+    for (pid_t pid : children) {
+        int status = 0;
+        waitpid(pid, &status, 0);
+        EXPECT_TRUE(WIFEXITED(status) && WEXITSTATUS(status) == 0) << "status " << status;
+    }
+    LoggerSharedStop();
+}
+
+// 父进程的其他线程持续写日志时 fork，子进程退出共享队列后走同步路径，不应卡在继承来的锁上
+TEST_F(LoggerStressTest, ForkedChildWritesSyncWhileParentThreadsLog) {
+    ASSERT_TRUE(LoggerSharedStart());
+    ASSERT_TRUE(LoggerRecentStart(64 * 1024));
+    ASSERT_TRUE(LoggerFilterSet("level:DEBUG"));
+    std::atomic<bool> stop{ false };
+    std::vector<std::thread> writers;
+    for (int t = 0; t < 4; ++t) {
+        writers.emplace_back([&stop]() {
+            while (!stop.load()) {
+                LOG_SPAN("fork writer") {
+                    LOG_INFO("parent writer {}", 1);
+                }
+            }
+        });
+    }
+    std::vector<pid_t> children;
+    for (int i = 0; i < 20; ++i) {
+        pid_t pid = fork();
+        ASSERT_GE(pid, 0);
+        if (pid == 0) {
+            alarm(10);   // 死锁时由 SIGALRM 结束，父进程据此判定失败
+            LoggerSharedStop();
+            LOG_SPAN("fork child") {
+                LOG_INFO("child {} writes synchronously", i);
+            }
+            _exit(LoggerFlush(std::chrono::seconds(5)) && !LoggerRecentQuery(RecentQuery()).empty() ? 0 : 1);
+        }
+        children.push_back(pid);
+        std::this_thread::sleep_for(std::chrono::milliseconds(2));
+    }
+    for (pid_t pid : children) {
+        int status = 0;
+        waitpid(pid, &status, 0);
+        EXPECT_TRUE(WIFEXITED(status) && WEXITSTATUS(status) == 0) << "child " << pid << " status " << status;
+    }
+    stop.store(true);
+    for (auto& w : writers) {
+        w.join();
+    }
+    LoggerSharedStop();
+    LoggerFilterSet("");
+    LoggerRecentStop();
+}
+
+TEST_F(LoggerStressTest, FlightRecorderDumpsSuppressedRecordsOnError) {
+    LoggerLevelSet(LOGLEVEL::INFO);
+    LoggerFlightRecorderSet(8);
+    LoggerMetricsReset();
+    for (int i = 0; i < 20; ++i) {
+        LOG_DEBUG("suppressed {}", i);
+    }
+    EXPECT_EQ(LoggerMetricsSnapshot().sinkRecords[static_cast<size_t>(SINK::FILE)], 0u);
+
+    LOG_ERROR("failure");
+    // 8 条历史 + 首尾两行标记 + ERROR 本身
+    EXPECT_EQ(LoggerMetricsSnapshot().sinkRecords[static_cast<size_t>(SINK::FILE)], 11u);
+
+    // 历史已清空，主动转储没有输出
+    LoggerFlightRecorderDump();
+    EXPECT_EQ(LoggerMetricsSnapshot().sinkRecords[static_cast<size_t>(SINK::FILE)], 11u);
+
+    LoggerFlightRecorderSet(0);
+    LoggerLevelSet(LOGLEVEL::DEBUG);
 }
 
 // Main function for gtest
@@ -114,3 +1071,144 @@ int main(int argc, char** argv) {
     ::testing::InitGoogleTest(&argc, argv);
     return RUN_ALL_TESTS();
 }
+
+namespace
+{
+    template <typename Pred>
+    bool waitFor(Pred pred)
+    {
+        auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(5);
+        while (!pred() && std::chrono::steady_clock::now() < deadline) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(2));
+        }
+        return pred();
+    }
+}
+
+TEST_F(LoggerStressTest, SocketSinkBatchesSpillsAndReconnects) {
+    const std::string endpoint = "unix:/tmp/gtest_log_" + std::to_string(getpid()) + ".sock";
+    std::mutex mutex;
+    std::vector<std::string> lines;
+    std::set<int> pids;
+    auto collect = [&](const SocketRecordMeta* meta, std::string_view line) {
+        std::lock_guard<std::mutex> lock(mutex);
+        lines.emplace_back(line);
+        pids.insert(meta ? meta->pid : -1);
+    };
+    auto received = [&](const std::string& marker) {
+        std::lock_guard<std::mutex> lock(mutex);
+        return static_cast<size_t>(std::count_if(lines.begin(), lines.end(), [&](const std::string& l) {
+            return l.find(marker) != std::string::npos;
+        }));
+    };
+
+    auto receiver = std::make_unique<SocketReceiver>();
+    ASSERT_TRUE(receiver->start(endpoint, collect));
+    SocketOptions options;
+    options.endpoint = endpoint;
+    options.format = SOCKETFORMAT::BINARY;
+    options.reconnectMin = std::chrono::milliseconds(5);
+    options.reconnectMax = std::chrono::milliseconds(20);
+    ASSERT_TRUE(LoggerSocketStart(options));
+    ASSERT_TRUE(waitFor([] { return isSocketConnected(); }));
+
+    for (int i = 0; i < 200; ++i) {
+        LOG_INFO("socket marker {}", i);
+    }
+    EXPECT_TRUE(waitFor([&] { return received("socket marker") == 200; }));
+    EXPECT_LT(receiver->batches(), 200u);   // 按批发送
+    EXPECT_EQ(pids, std::set<int>{ getpid() });
+    EXPECT_EQ(countLines(kLogDir, "socket marker"), 0u);
+
+    // 收集端停止后记录改写文件，不丢失也不阻塞；已进入批次的记录与直接写文件的一样按线程分片
+    LogFileShardSet(true);
+    receiver->stop();
+    for (int i = 0; i < 50; ++i) {
+        LOG_INFO("socket spill {}", i);
+        std::this_thread::sleep_for(std::chrono::microseconds(200));
+    }
+    EXPECT_TRUE(waitFor([] { return LoggerSocketStats().spilledRecords >= 50; }));
+    LogFileFlush();
+    EXPECT_EQ(countLines(kLogDir, "socket spill"), 50u);
+    size_t sharded = 0;
+    for (auto& entry : std::filesystem::recursive_directory_iterator(kLogDir)) {
+        if (entry.path().filename().string().rfind("shard_", 0) == 0) {
+            std::ifstream in(entry.path());
+            for (std::string line; std::getline(in, line);) {
+                sharded += line.find("socket spill") != std::string::npos;
+            }
+        }
+    }
+    EXPECT_EQ(sharded, 50u);
+    LogFileShardSet(false);
+
+    // 收集端恢复后自动重连
+    receiver = std::make_unique<SocketReceiver>();
+    ASSERT_TRUE(receiver->start(endpoint, collect));
+    ASSERT_TRUE(waitFor([] { return isSocketConnected(); }));
+    for (int i = 0; i < 10; ++i) {
+        LOG_INFO("socket again {}", i);
+    }
+    LoggerSocketStop();
+    EXPECT_TRUE(waitFor([&] { return received("socket again") == 10; }));
+    EXPECT_GE(LoggerSocketStats().connects, 2u);
+    receiver->stop();
+}
+
+TEST_F(LoggerStressTest, RecentRecordsAreQueryableWithoutFileOutput) {
+    const std::string path = "/tmp/gtest_log_query_" + std::to_string(getpid()) + ".sock";
+    LoggerOutputSet(OUTPUT::NONE);
+    ASSERT_TRUE(LoggerRecentStart(64 * 1024, path));
+    for (int i = 0; i < 1000; ++i) {
+        LOG_INFO("recent marker {}", i);
+        if (i % 100 == 0) {
+            LOG_WARNING("recent warning {}", i);
+        }
+    }
+
+    // 只保留最近约 64KB，最新的一条总在
+    RecentQuery all;
+    std::vector<std::string> lines = LoggerRecentQuery(all);
+    EXPECT_LT(lines.size(), 1000u);
+    ASSERT_FALSE(lines.empty());
+    EXPECT_NE(lines.back().find("recent marker 999"), std::string::npos);
+    EXPECT_EQ(countLines(kLogDir, "recent marker"), 0u);
+
+    RecentQuery warnings;
+    std::string error;
+    ASSERT_TRUE(RecentQuery::parse("level=W since=1m limit=2", systemNowNs(), &warnings, &error));
+    lines = LoggerRecentQuery(warnings);
+    ASSERT_EQ(lines.size(), 2u);
+    EXPECT_NE(lines[1].find("recent warning 900"), std::string::npos);
+    EXPECT_FALSE(RecentQuery::parse("level=X", 0, &warnings, &error));
+
+    // 通过 Unix 套接字查询
+    int fd = openEndpoint("unix:" + path, false, &error);
+    ASSERT_GE(fd, 0) << error;
+    const std::string request = "limit=3 grep=recent marker 99\n";
+    ASSERT_EQ(::write(fd, request.data(), request.size()), static_cast<ssize_t>(request.size()));
+    std::string response;
+    char chunk[4096];
+    for (ssize_t n; (n = ::read(fd, chunk, sizeof(chunk))) > 0;) {
+        response.append(chunk, static_cast<size_t>(n));
+    }
+    ::close(fd);
+    EXPECT_EQ(std::count(response.begin(), response.end(), '\n'), 3);
+    EXPECT_NE(response.find("recent marker 999\n"), std::string::npos);
+
+    // 再次启动时保留记录与端点，不关闭捕获
+    const size_t kept = LoggerRecentQuery(all).size();
+    ASSERT_TRUE(LoggerRecentStart(64 * 1024, path));
+    EXPECT_EQ(LoggerRecentQuery(all).size(), kept);
+    LOG_INFO("recent after restart");
+    lines = LoggerRecentQuery(all);
+    ASSERT_FALSE(lines.empty());
+    EXPECT_NE(lines.back().find("recent after restart"), std::string::npos);
+    fd = openEndpoint("unix:" + path, false, &error);
+    ASSERT_GE(fd, 0) << error;
+    ::close(fd);
+
+    LoggerRecentStop();
+    LoggerOutputSet(OUTPUT::FILE);
+    EXPECT_FALSE(std::filesystem::exists(path));
+}
@@ -0,0 +1,145 @@
+// test/gtest_Logger_coro.cpp
+// 以 C++20 编译：co_await LoggerFlush() / Logger::drain() 在完成线程上恢复
+
+#include <gtest/gtest.h>
+#include "../inc/log.hh"
+#include <filesystem>
+#include <fstream>
+#include <future>
+#include <thread>
+
+using namespace beiklive::LOG;
+
+static_assert(__cplusplus >= 202002L, "this test must be built as C++20");
+
+namespace
+{
+    const std::string kLogDir = "./gtest_coro_log";
+
+    // 目录下所有 .log 文件中包含 marker 的行数
+    size_t countLines(const std::string& dir, const std::string& marker)
+    {
+        size_t lines = 0;
+        std::error_code ec;
+        for (auto& entry : std::filesystem::recursive_directory_iterator(dir, ec)) {
+            if (!entry.is_regular_file() || entry.path().extension() != ".log") {
+                continue;
+            }
+            std::ifstream in(entry.path());
+            for (std::string line; std::getline(in, line);) {
+                lines += line.find(marker) != std::string::npos;
+            }
+        }
+        return lines;
+    }
+
+    // 立即开始执行、结束后自行销毁的协程；字符串参数按值传入，挂起后仍然有效
+    struct Detached
+    {
+        struct promise_type
+        {
+            Detached get_return_object() { return {}; }
+            std::suspend_never initial_suspend() noexcept { return {}; }
+            std::suspend_never final_suspend() noexcept { return {}; }
+            void return_void() {}
+            void unhandled_exception() { std::terminate(); }
+        };
+    };
+
+    struct Resumed
+    {
+        std::thread::id thread;
+        size_t          lines = 0;
+    };
+
+    Detached flushThenCount(std::string marker, std::promise<Resumed>& out)
+    {
+        co_await LoggerFlush();
+        out.set_value(Resumed{ std::this_thread::get_id(), countLines(kLogDir, marker) });
+    }
+
+    Detached drainThenCount(Logger& logger, std::string dir, std::string marker,
+                            std::promise<Resumed>& out)
+    {
+        co_await logger.drain();
+        out.set_value(Resumed{ std::this_thread::get_id(), countLines(dir, marker) });
+    }
+
+    // 让完成线程停在一个任务上，保证 co_await 时请求尚未完成、协程确实挂起
+    class CompletionGate {
+    public:
+        CompletionGate() {
+            completions_.post([this]() {
+                thread = std::this_thread::get_id();
+                opened.get_future().wait();
+            });
+        }
+
+        void open() { opened.set_value(); }
+
+        std::thread::id thread;
+
+    private:
+        std::promise<void> opened;
+    };
+}
+
+class LoggerCoroutineTest : public ::testing::Test {
+protected:
+    static void SetUpTestSuite() {
+        LogFilePathSet(kLogDir);
+        LoggerLevelSet(LOGLEVEL::DEBUG);
+        LoggerOutputSet(OUTPUT::FILE);
+    }
+
+    static void TearDownTestSuite() {
+        LoggerStop();
+        std::filesystem::remove_all(kLogDir);
+    }
+};
+
+TEST_F(LoggerCoroutineTest, FlushResumesOnCompletionThreadAfterRecordsAreOnDisk) {
+    ASSERT_TRUE(LoggerAsyncStart());
+    for (int i = 0; i < 1000; ++i) {
+        LOG_INFO("coro flush marker {}", i);
+    }
+    CompletionGate gate;
+    std::promise<Resumed> resumed;
+    std::future<Resumed> result = resumed.get_future();
+    flushThenCount("coro flush marker", resumed);
+    EXPECT_NE(result.wait_for(std::chrono::milliseconds(20)), std::future_status::ready);   // 已挂起
+    gate.open();
+    ASSERT_EQ(result.wait_for(std::chrono::seconds(5)), std::future_status::ready);
+    Resumed r = result.get();
+    EXPECT_EQ(r.thread, gate.thread);
+    EXPECT_NE(r.thread, std::this_thread::get_id());
+    EXPECT_EQ(r.lines, 1000u);
+    LoggerAsyncStop();
+}
+
+TEST_F(LoggerCoroutineTest, InstanceDrainResumesOnCompletionThreadAfterRecordsAreWritten) {
+    LoggerOptions options;
+    options.dir = kLogDir + "/instance";
+    options.flush = FLUSHPOLICY::BATCH;
+    options.async = true;
+    Logger logger(options);
+    for (int i = 0; i < 1000; ++i) {
+        LOG_INFO_TO(logger, "coro drain marker {}", i);
+    }
+    CompletionGate gate;
+    std::promise<Resumed> resumed;
+    std::future<Resumed> result = resumed.get_future();
+    drainThenCount(logger, options.dir, "coro drain marker", resumed);
+    EXPECT_NE(result.wait_for(std::chrono::milliseconds(20)), std::future_status::ready);
+    gate.open();
+    ASSERT_EQ(result.wait_for(std::chrono::seconds(5)), std::future_status::ready);
+    Resumed r = result.get();
+    EXPECT_EQ(r.thread, gate.thread);
+    EXPECT_EQ(r.lines, 1000u);
+    logger.stop();
+}
+
+int main(int argc, char** argv) {
+    ::testing::InitGoogleTest(&argc, argv);
+    return RUN_ALL_TESTS();
+}
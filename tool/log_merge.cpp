@@ -0,0 +1,244 @@
+// Copyright (c) RealCoolEngineer. 2024. All rights reserved.
+// Author: beiklive
+// Date: 2024-05-29
+//
+// 把按线程分片的日志文件（LogFileShardSet(true)）k 路归并为一条按时间排序的输出：
+// 各文件 mmap 后只比较行首时间戳，每个文件内部已按写入顺序排列，用最小堆每次取出最早的一条。
+// 时间戳按数值比较，毫秒与纳秒精度的文件可以混合归并（同一毫秒内低精度的记录排在前面）。
+// 日志中的时间戳是不带时区的本地时间：夏令时回拨前后一小时内的记录无法区分先后，跨越回拨的输入不保证顺序。
+//   xmake run log_merge -o merged.log ./log/20240529_10_00_00_000
+#include "../inc/log_index.hh"
+#include <algorithm>
+#include <climits>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <iostream>
+#include <queue>
+#include <string>
+#include <string_view>
+#include <vector>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace
+{
+    struct MergeConfig
+    {
+        std::vector<std::string> paths;
+        std::string output;                 // 为空时写到标准输出
+        bool        shardsOnly = false;     // 目录中只取 shard_*.log
+    };
+
+    // 一个已映射的文件及其当前记录
+    struct Cursor
+    {
+        const char*      base = nullptr;
+        size_t           size = 0;
+        const char*      p = nullptr;       // 当前记录起点
+        const char*      next = nullptr;    // 下一条记录起点
+        int64_t          seconds = INT64_MIN;   // 行首时间戳，没有时间戳时最先输出
+        int64_t          nanos = 0;
+        size_t           order = 0;         // 时间戳相同时按文件顺序输出
+    };
+
+    bool hasTimestamp(const char* line, const char* end)
+    {
+        return end - line > 2 && line[0] == '[' && line[1] >= '0' && line[1] <= '9';
+    }
+
+    // 公历日期到 1970-01-01 的天数
+    int64_t daysFromCivil(int64_t y, int64_t m, int64_t d)
+    {
+        y -= m <= 2;
+        const int64_t era = (y >= 0 ? y : y - 399) / 400;
+        const int64_t yoe = y - era * 400;
+        const int64_t doy = (153 * (m + (m > 2 ? -3 : 9)) + 2) / 5 + d - 1;
+        const int64_t doe = yoe * 365 + yoe / 4 - yoe / 100 + doy;
+        return era * 146097 + doe - 719468;
+    }
+
+    // 解析 "YYYY-mm-dd HH:MM:SS[.小数]"：按日历字段换算为秒（不做时区转换），小数部分补齐为纳秒
+    bool parseStamp(std::string_view s, int64_t* seconds, int64_t* nanos)
+    {
+        auto number = [&s](size_t pos, size_t len, int64_t* v) {
+            *v = 0;
+            for (size_t i = pos; i < pos + len; ++i) {
+                if (i >= s.size() || s[i] < '0' || s[i] > '9') {
+                    return false;
+                }
+                *v = *v * 10 + (s[i] - '0');
+            }
+            return true;
+        };
+        int64_t y, mo, d, h, mi, sec;
+        if (!number(0, 4, &y) || !number(5, 2, &mo) || !number(8, 2, &d) || !number(11, 2, &h) ||
+            !number(14, 2, &mi) || !number(17, 2, &sec)) {
+            return false;
+        }
+        *seconds = daysFromCivil(y, mo, d) * 86400 + h * 3600 + mi * 60 + sec;
+        *nanos = 0;
+        int64_t scale = 100000000;
+        for (size_t i = 20; s.size() > 19 && s[19] == '.' && i < s.size() && s[i] >= '0' && s[i] <= '9'; ++i) {
+            *nanos += (s[i] - '0') * scale;
+            scale /= 10;
+        }
+        return true;
+    }
+
+    // 记录为一行带时间戳的日志加上其后没有时间戳的续行（如十六进制转储）
+    bool advance(Cursor& c)
+    {
+        const char* end = c.base + c.size;
+        c.p = c.next;
+        if (c.p >= end) {
+            return false;
+        }
+        const char* q = c.p;
+        c.seconds = INT64_MIN;   // 文件开头没有时间戳或无法解析的行最先输出
+        c.nanos = 0;
+        if (hasTimestamp(q, end)) {
+            const char* close = static_cast<const char*>(std::memchr(q, ']', static_cast<size_t>(end - q)));
+            if (close && !parseStamp(std::string_view(q + 1, static_cast<size_t>(close - q - 1)), &c.seconds,
+                                     &c.nanos)) {
+                c.seconds = INT64_MIN;
+                c.nanos = 0;
+            }
+        }
+        do {
+            const char* nl = static_cast<const char*>(std::memchr(q, '\n', static_cast<size_t>(end - q)));
+            q = nl ? nl + 1 : end;
+        } while (q < end && !hasTimestamp(q, end));
+        c.next = q;
+        return true;
+    }
+
+    struct Later
+    {
+        bool operator()(const Cursor* a, const Cursor* b) const {
+            if (a->seconds != b->seconds) {
+                return a->seconds > b->seconds;
+            }
+            return a->nanos != b->nanos ? a->nanos > b->nanos : a->order > b->order;
+        }
+    };
+
+    bool mapFile(const std::string& path, Cursor& c)
+    {
+        int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+        struct stat st;
+        if (fd < 0 || fstat(fd, &st) != 0) {
+            std::perror(path.c_str());
+            if (fd >= 0) {
+                ::close(fd);
+            }
+            return false;
+        }
+        c.size = static_cast<size_t>(st.st_size);
+        if (c.size == 0) {
+            ::close(fd);
+            return false;
+        }
+        void* m = mmap(nullptr, c.size, PROT_READ, MAP_PRIVATE, fd, 0);
+        ::close(fd);
+        if (m == MAP_FAILED) {
+            std::perror(path.c_str());
+            return false;
+        }
+        madvise(m, c.size, MADV_SEQUENTIAL);
+        c.base = static_cast<const char*>(m);
+        c.next = c.base;
+        return true;
+    }
+
+    std::vector<std::string> listFiles(const MergeConfig& cfg)
+    {
+        std::vector<std::string> files;
+        for (const auto& path : cfg.paths) {
+            std::error_code ec;
+            if (!std::filesystem::is_directory(path, ec)) {
+                files.push_back(path);
+                continue;
+            }
+            for (auto& entry : std::filesystem::recursive_directory_iterator(path, ec)) {
+                const std::filesystem::path& p = entry.path();
+                if (entry.is_regular_file() && p.extension() == ".log" &&
+                    (!cfg.shardsOnly || p.filename().string().compare(0, 6, "shard_") == 0)) {
+                    files.push_back(p.string());
+                }
+            }
+        }
+        std::sort(files.begin(), files.end(), beiklive::LOG::logFileBefore);
+        return files;
+    }
+
+    int usage()
+    {
+        std::cerr << "usage: log_merge [-o output] [--shards-only] logdir|file..." << std::endl;
+        return 1;
+    }
+}
+
+int main(int argc, char* argv[])
+{
+    MergeConfig cfg;
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        std::string next = (i + 1 < argc) ? argv[i + 1] : "";
+        if (arg == "-o" || arg == "--output") { cfg.output = next; ++i; }
+        else if (arg == "--shards-only") { cfg.shardsOnly = true; }
+        else if (!arg.empty() && arg[0] == '-') { return usage(); }
+        else { cfg.paths.push_back(arg); }
+    }
+    if (cfg.paths.empty()) {
+        return usage();
+    }
+
+    std::vector<std::string> files = listFiles(cfg);
+    std::vector<Cursor> cursors(files.size());
+    std::priority_queue<Cursor*, std::vector<Cursor*>, Later> heap;
+    for (size_t i = 0; i < files.size(); ++i) {
+        cursors[i].order = i;
+        if (mapFile(files[i], cursors[i]) && advance(cursors[i])) {
+            heap.push(&cursors[i]);
+        }
+    }
+
+    std::FILE* out = cfg.output.empty() ? stdout : std::fopen(cfg.output.c_str(), "wb");
+    if (!out) {
+        std::perror(cfg.output.c_str());
+        return 1;
+    }
+    static char buffer[1 << 20];
+    std::setvbuf(out, buffer, _IOFBF, sizeof(buffer));
+
+    size_t records = 0;
+    size_t bytes = 0;
+    while (!heap.empty()) {
+        Cursor* c = heap.top();
+        heap.pop();
+        size_t length = static_cast<size_t>(c->next - c->p);
+        std::fwrite(c->p, 1, length, out);
+        if (c->p[length - 1] != '\n') {
+            std::fputc('\n', out);   // 文件末尾缺少换行的记录
+        }
+        ++records;
+        bytes += length;
+        if (advance(*c)) {
+            heap.push(c);
+        }
+    }
+    std::fflush(out);
+    if (out != stdout) {
+        std::fclose(out);
+    }
+    for (Cursor& c : cursors) {
+        if (c.base) {
+            munmap(const_cast<char*>(c.base), c.size);
+        }
+    }
+    std::cerr << "files=" << files.size() << " records=" << records << " bytes=" << bytes << std::endl;
+    return 0;
+}
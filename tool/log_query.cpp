@@ -0,0 +1,202 @@
+// Copyright (c) RealCoolEngineer. 2024. All rights reserved.
+// Author: beiklive
+// Date: 2024-05-06
+//
+// 按时间段查询日志目录：借助轮转时写出的 .idx 时间索引只映射命中的区间，没有索引的文件整体扫描
+//   xmake run log_query --from "2024-05-06 10:00:00" --to "2024-05-06 10:10:00" --level E ./log
+#include "../inc/log_index.hh"
+#include <algorithm>
+#include <charconv>
+#include <climits>
+#include <cstring>
+#include <ctime>
+#include <filesystem>
+#include <iostream>
+#include <string>
+#include <vector>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+using namespace beiklive::LOG;
+
+namespace
+{
+    struct QueryConfig
+    {
+        std::vector<std::string> dirs;
+        int64_t     fromSecond = LLONG_MIN;
+        int64_t     toSecond = LLONG_MAX;
+        std::string fromKey;                // 与日志行首 "[%Y-%m-%d %H:%M:%S" 逐字节比较
+        std::string toKey = "\x7f";
+        char        level = 0;              // E / W / I / D，0 表示不过滤
+        int64_t     slack = 2;              // 允许的乱序秒数
+    };
+
+    struct QueryStats
+    {
+        size_t  files = 0;
+        size_t  indexed = 0;
+        size_t  skipped = 0;
+        int64_t totalBytes = 0;
+        int64_t mappedBytes = 0;
+    };
+
+    const size_t KEY_LENGTH = 20;   // "[YYYY-mm-dd HH:MM:SS"
+
+    bool parseTime(const std::string& text, int64_t* second, std::string* key)
+    {
+        std::tm tm{};
+        const char* end = strptime(text.c_str(), "%Y-%m-%d %H:%M:%S", &tm);
+        if (!end || *end != '\0') {
+            return false;
+        }
+        tm.tm_isdst = -1;
+        *second = static_cast<int64_t>(std::mktime(&tm));
+        char buf[32];
+        std::strftime(buf, sizeof(buf), "[%Y-%m-%d %H:%M:%S", &tm);
+        *key = buf;
+        return true;
+    }
+
+    bool hasTimestamp(const char* line, size_t length)
+    {
+        return length >= KEY_LENGTH && line[0] == '[' && line[1] >= '0' && line[1] <= '9';
+    }
+
+    // 时间戳之后的级别标记，如 "] [E]"
+    char levelOf(const char* line, size_t length)
+    {
+        const char* p = static_cast<const char*>(std::memchr(line, ']', length));
+        if (!p || p + 4 >= line + length || p[1] != ' ' || p[2] != '[' || p[4] != ']') {
+            return 0;
+        }
+        return p[3];
+    }
+
+    void scanRegion(const QueryConfig& cfg, const char* p, const char* end)
+    {
+        bool include = false;
+        while (p < end) {
+            const char* nl = static_cast<const char*>(std::memchr(p, '\n', static_cast<size_t>(end - p)));
+            const char* lineEnd = nl ? nl + 1 : end;
+            size_t length = static_cast<size_t>(lineEnd - p);
+            // 没有时间戳的续行跟随上一条日志
+            if (hasTimestamp(p, length)) {
+                include = std::memcmp(p, cfg.fromKey.data(), std::min(KEY_LENGTH, cfg.fromKey.size())) >= 0 &&
+                          std::memcmp(p, cfg.toKey.data(), std::min(KEY_LENGTH, cfg.toKey.size())) <= 0 &&
+                          (cfg.level == 0 || levelOf(p, length) == cfg.level);
+            }
+            if (include) {
+                std::fwrite(p, 1, length, stdout);
+            }
+            p = lineEnd;
+        }
+    }
+
+    void queryFile(const QueryConfig& cfg, const std::string& path, QueryStats& stats)
+    {
+        int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+        struct stat st;
+        if (fd < 0 || fstat(fd, &st) != 0) {
+            std::perror(path.c_str());
+            if (fd >= 0) {
+                ::close(fd);
+            }
+            return;
+        }
+        ++stats.files;
+        int64_t size = static_cast<int64_t>(st.st_size);
+        stats.totalBytes += size;
+
+        int64_t begin = 0;
+        int64_t end = size;
+        TimeIndex index;
+        if (index.load(path + ".idx")) {
+            ++stats.indexed;
+            if (!index.range(cfg.fromSecond, cfg.toSecond, cfg.slack, &begin, &end)) {
+                ++stats.skipped;
+                ::close(fd);
+                return;
+            }
+            if (end < 0 || end > size) {
+                end = size;
+            }
+        }
+        if (begin >= end) {
+            ::close(fd);
+            return;
+        }
+
+        // 只映射命中的区间，起点按页对齐
+        int64_t page = sysconf(_SC_PAGESIZE);
+        int64_t mapBegin = begin & ~(page - 1);
+        size_t mapLength = static_cast<size_t>(end - mapBegin);
+        void* m = mmap(nullptr, mapLength, PROT_READ, MAP_PRIVATE, fd, static_cast<off_t>(mapBegin));
+        ::close(fd);
+        if (m == MAP_FAILED) {
+            std::perror(path.c_str());
+            return;
+        }
+        madvise(m, mapLength, MADV_SEQUENTIAL);
+        stats.mappedBytes += static_cast<int64_t>(mapLength);
+        const char* base = static_cast<const char*>(m);
+        scanRegion(cfg, base + (begin - mapBegin), base + mapLength);
+        munmap(m, mapLength);
+    }
+
+    // 整个参数是一个不小于 0 的十进制整数时成功
+    bool parseSeconds(const std::string& text, int64_t* value)
+    {
+        const char* end = text.data() + text.size();
+        auto result = std::from_chars(text.data(), end, *value);
+        return !text.empty() && result.ec == std::errc() && result.ptr == end && *value >= 0;
+    }
+
+    int usage()
+    {
+        std::cerr << "usage: log_query [--from \"YYYY-mm-dd HH:MM:SS\"] [--to \"YYYY-mm-dd HH:MM:SS\"]"
+                  << " [--level E|W|I|D] [--slack seconds] logdir..." << std::endl;
+        return 1;
+    }
+}
+
+int main(int argc, char* argv[])
+{
+    QueryConfig cfg;
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        std::string next = (i + 1 < argc) ? argv[i + 1] : "";
+        if (arg == "--from") {
+            if (!parseTime(next, &cfg.fromSecond, &cfg.fromKey)) return usage();
+            ++i;
+        }
+        else if (arg == "--to") {
+            if (!parseTime(next, &cfg.toSecond, &cfg.toKey)) return usage();
+            ++i;
+        }
+        else if (arg == "--level") { cfg.level = next.empty() ? 0 : next[0]; ++i; }
+        else if (arg == "--slack") {
+            if (!parseSeconds(next, &cfg.slack)) return usage();
+            ++i;
+        }
+        else if (!arg.empty() && arg[0] == '-') { return usage(); }
+        else { cfg.dirs.push_back(arg); }
+    }
+    if (cfg.dirs.empty()) {
+        return usage();
+    }
+
+    // 运行目录与文件名中的创建时间决定顺序，分片、实例文件名的前缀不参与比较
+    std::vector<std::string> files = listLogFiles(cfg.dirs);
+
+    QueryStats stats;
+    for (const auto& f : files) {
+        queryFile(cfg, f, stats);
+    }
+    std::fflush(stdout);
+    std::cerr << "files=" << stats.files << " indexed=" << stats.indexed << " skipped=" << stats.skipped
+              << " mapped=" << stats.mappedBytes << "/" << stats.totalBytes << " bytes" << std::endl;
+    return 0;
+}
@@ -0,0 +1,86 @@
+// Copyright (c) RealCoolEngineer. 2024. All rights reserved.
+// Author: beiklive
+// Date: 2024-06-01
+//
+// 本机日志收集端：监听 LoggerSocketStart 使用的端点，把收到的记录逐行写到标准输出或文件，
+// 用于测试套接字输出，也可作为简单的集中收集进程。
+//   xmake run log_receiver -o collected.log unix:/tmp/app_log.sock
+//   xmake run log_receiver --count 10000 tcp:127.0.0.1:9000
+#include "../inc/log_socket.hh"
+#include <atomic>
+#include <chrono>
+#include <csignal>
+#include <cstdio>
+#include <cstdlib>
+#include <iostream>
+#include <mutex>
+#include <string>
+#include <thread>
+
+namespace
+{
+    std::atomic<bool> interrupted{ false };
+
+    void onSignal(int)
+    {
+        interrupted.store(true);
+    }
+
+    int usage()
+    {
+        std::cerr << "usage: log_receiver [-o output] [--count N] [--meta] unix:PATH|tcp:HOST:PORT" << std::endl;
+        return 1;
+    }
+}
+
+int main(int argc, char* argv[])
+{
+    std::string endpoint;
+    std::string output;
+    unsigned long long count = 0;   // 收到这么多条后退出，0 表示直到 Ctrl-C
+    bool meta = false;              // BINARY 格式时在行首输出 pid/tid/level
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        std::string next = (i + 1 < argc) ? argv[i + 1] : "";
+        if (arg == "-o" || arg == "--output") { output = next; ++i; }
+        else if (arg == "--count") { count = std::strtoull(next.c_str(), nullptr, 10); ++i; }
+        else if (arg == "--meta") { meta = true; }
+        else if (!arg.empty() && arg[0] == '-') { return usage(); }
+        else { endpoint = arg; }
+    }
+    if (endpoint.empty()) {
+        return usage();
+    }
+
+    std::FILE* out = output.empty() ? stdout : std::fopen(output.c_str(), "ab");
+    if (!out) {
+        std::perror(output.c_str());
+        return 1;
+    }
+    std::signal(SIGINT, onSignal);
+    std::signal(SIGTERM, onSignal);
+
+    std::mutex outMutex;
+    beiklive::LOG::SocketReceiver receiver;
+    bool ok = receiver.start(endpoint, [&](const beiklive::LOG::SocketRecordMeta* m, std::string_view line) {
+        std::lock_guard<std::mutex> lock(outMutex);
+        if (meta && m) {
+            std::fprintf(out, "[pid:%d tid:%lld level:%d] ", m->pid, static_cast<long long>(m->tid), m->level);
+        }
+        std::fwrite(line.data(), 1, line.size(), out);
+        std::fputc('\n', out);
+    });
+    if (!ok) {
+        return 1;
+    }
+    while (!interrupted.load() && (count == 0 || receiver.records() < count)) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(20));
+    }
+    receiver.stop();
+    std::fflush(out);
+    if (out != stdout) {
+        std::fclose(out);
+    }
+    std::cerr << "records=" << receiver.records() << " batches=" << receiver.batches() << std::endl;
+    return 0;
+}
@@ -0,0 +1,367 @@
+// Copyright (c) RealCoolEngineer. 2024. All rights reserved.
+// Author: beiklive
+// Date: 2024-05-10
+//
+// 日志目录搜索：mmap 各日志文件，用 SIMD 子串查找按关键字 / 级别 / 调用点过滤，每个工作线程处理一个文件；
+// -f 跟随最新的日志文件并在轮转后切换到新文件
+//   xmake run log_search --level E --callsite "main:42" -e timeout ./log
+//   xmake run log_search -f --level W ./log
+#include "../inc/log_index.hh"
+#include <algorithm>
+#include <atomic>
+#include <charconv>
+#include <chrono>
+#include <cstring>
+#include <filesystem>
+#include <iostream>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#endif
+
+using namespace beiklive::LOG;
+
+namespace
+{
+    //*SIMD ***************************************************************
+    // 先用向量比较同时匹配子串的首字节与末字节，候选位置再逐字节确认
+    inline const char* scalarFind(const char* s, size_t n, std::string_view needle)
+    {
+        std::string_view hay(s, n);
+        size_t pos = hay.find(needle);
+        return pos == std::string_view::npos ? nullptr : s + pos;
+    }
+
+#if defined(__x86_64__) || defined(__i386__)
+    const char* sse2Find(const char* s, size_t n, std::string_view needle)
+    {
+        const size_t k = needle.size();
+        const __m128i first = _mm_set1_epi8(needle[0]);
+        const __m128i last = _mm_set1_epi8(needle[k - 1]);
+        size_t i = 0;
+        for (; i + k - 1 + 16 <= n; i += 16) {
+            __m128i a = _mm_loadu_si128(reinterpret_cast<const __m128i*>(s + i));
+            __m128i b = _mm_loadu_si128(reinterpret_cast<const __m128i*>(s + i + k - 1));
+            unsigned mask = static_cast<unsigned>(_mm_movemask_epi8(
+                _mm_and_si128(_mm_cmpeq_epi8(a, first), _mm_cmpeq_epi8(b, last))));
+            while (mask) {
+                unsigned bit = static_cast<unsigned>(__builtin_ctz(mask));
+                if (std::memcmp(s + i + bit + 1, needle.data() + 1, k > 2 ? k - 2 : 0) == 0) {
+                    return s + i + bit;
+                }
+                mask &= mask - 1;
+            }
+        }
+        return scalarFind(s + i, n - i, needle);
+    }
+
+    __attribute__((target("avx2")))
+    const char* avx2Find(const char* s, size_t n, std::string_view needle)
+    {
+        const size_t k = needle.size();
+        const __m256i first = _mm256_set1_epi8(needle[0]);
+        const __m256i last = _mm256_set1_epi8(needle[k - 1]);
+        size_t i = 0;
+        for (; i + k - 1 + 32 <= n; i += 32) {
+            __m256i a = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(s + i));
+            __m256i b = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(s + i + k - 1));
+            unsigned mask = static_cast<unsigned>(_mm256_movemask_epi8(
+                _mm256_and_si256(_mm256_cmpeq_epi8(a, first), _mm256_cmpeq_epi8(b, last))));
+            while (mask) {
+                unsigned bit = static_cast<unsigned>(__builtin_ctz(mask));
+                if (std::memcmp(s + i + bit + 1, needle.data() + 1, k > 2 ? k - 2 : 0) == 0) {
+                    return s + i + bit;
+                }
+                mask &= mask - 1;
+            }
+        }
+        return scalarFind(s + i, n - i, needle);
+    }
+#endif
+
+    // 在 [s, s + n) 中查找 needle，单字节时直接用 memchr
+    const char* simdFind(const char* s, size_t n, std::string_view needle)
+    {
+        if (needle.empty()) {
+            return s;
+        }
+        if (n < needle.size()) {
+            return nullptr;
+        }
+        if (needle.size() == 1) {
+            return static_cast<const char*>(std::memchr(s, needle[0], n));
+        }
+#if defined(__x86_64__) || defined(__i386__)
+        static const bool hasAvx2 = __builtin_cpu_supports("avx2");
+        return hasAvx2 ? avx2Find(s, n, needle) : sse2Find(s, n, needle);
+#else
+        return scalarFind(s, n, needle);
+#endif
+    }
+    //***************************************************************
+
+    struct SearchConfig
+    {
+        std::vector<std::string> dirs;
+        std::vector<std::string> needles;   // 同一行须全部包含
+        unsigned threads = std::max(1u, std::thread::hardware_concurrency());
+        bool     follow = false;
+        bool     count = false;
+        bool     withFilename = false;
+        std::chrono::milliseconds pollInterval{ 200 };
+    };
+
+    // 以最长的关键字扫描整块内存，命中后再在所在行内确认其余关键字；没有关键字时匹配每一行
+    class LineMatcher {
+    public:
+        explicit LineMatcher(const std::vector<std::string>& needles) : others(needles.begin(), needles.end()) {
+            auto longest = std::max_element(others.begin(), others.end(),
+                [](std::string_view a, std::string_view b) { return a.size() < b.size(); });
+            if (longest != others.end()) {
+                primary = *longest;
+                others.erase(longest);
+            }
+        }
+
+        // 对 [p, end) 中每个匹配行调用 fn(lineBegin, lineLength)，行包含结尾换行符
+        template <typename F>
+        void scan(const char* p, const char* end, F&& fn) const {
+            const char* const begin = p;
+            while (p < end) {
+                const char* hit = simdFind(p, static_cast<size_t>(end - p), primary);
+                if (!hit) {
+                    return;
+                }
+                const char* lineBegin = hit;
+                while (lineBegin > begin && lineBegin[-1] != '\n') {
+                    --lineBegin;
+                }
+                const char* nl = static_cast<const char*>(std::memchr(hit, '\n', static_cast<size_t>(end - hit)));
+                const char* lineEnd = nl ? nl + 1 : end;
+                if (matchOthers(lineBegin, static_cast<size_t>(lineEnd - lineBegin))) {
+                    fn(lineBegin, static_cast<size_t>(lineEnd - lineBegin));
+                }
+                p = lineEnd;
+            }
+        }
+
+    private:
+        bool matchOthers(const char* line, size_t length) const {
+            for (std::string_view n : others) {
+                if (!simdFind(line, length, n)) {
+                    return false;
+                }
+            }
+            return true;
+        }
+
+        std::string_view primary;
+        std::vector<std::string_view> others;
+    };
+
+    struct FileResult
+    {
+        std::string output;
+        size_t      matches = 0;
+        size_t      scanned = 0;   // 已扫描到的文件偏移，跟随模式从这里接着读
+    };
+
+    void appendLine(const SearchConfig& cfg, const std::string& path, const char* line, size_t length,
+                    FileResult& result)
+    {
+        ++result.matches;
+        if (cfg.count) {
+            return;
+        }
+        if (cfg.withFilename) {
+            result.output += path;
+            result.output += ':';
+        }
+        result.output.append(line, length);
+        if (length == 0 || line[length - 1] != '\n') {
+            result.output += '\n';
+        }
+    }
+
+    // completeOnly 时只扫描到最后一个换行，末尾正在写入的半行留给跟随模式
+    void searchFile(const SearchConfig& cfg, const LineMatcher& matcher, const std::string& path, FileResult& result,
+                    bool completeOnly)
+    {
+        int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+        struct stat st;
+        if (fd < 0 || fstat(fd, &st) != 0) {
+            std::perror(path.c_str());
+            if (fd >= 0) {
+                ::close(fd);
+            }
+            return;
+        }
+        size_t size = static_cast<size_t>(st.st_size);
+        if (size == 0) {
+            ::close(fd);
+            return;
+        }
+        void* m = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+        ::close(fd);
+        if (m == MAP_FAILED) {
+            std::perror(path.c_str());
+            return;
+        }
+        madvise(m, size, MADV_SEQUENTIAL);
+        const char* base = static_cast<const char*>(m);
+        size_t end = size;
+        if (completeOnly) {
+            const void* nl = memrchr(base, '\n', size);
+            end = nl ? static_cast<size_t>(static_cast<const char*>(nl) - base) + 1 : 0;
+        }
+        matcher.scan(base, base + end, [&](const char* line, size_t length) {
+            appendLine(cfg, path, line, length, result);
+        });
+        result.scanned = end;
+        munmap(m, size);
+    }
+
+    // lastScanned 返回最后一个（最新的）文件实际扫描到的偏移
+    size_t searchAll(const SearchConfig& cfg, const LineMatcher& matcher, const std::vector<std::string>& files,
+                     size_t* lastScanned)
+    {
+        std::vector<FileResult> results(files.size());
+        std::atomic<size_t> next{ 0 };
+        std::vector<std::thread> workers;
+        unsigned n = std::min<unsigned>(cfg.threads, static_cast<unsigned>(files.size()));
+        for (unsigned t = 0; t < n; ++t) {
+            workers.emplace_back([&]() {
+                for (size_t i = next.fetch_add(1); i < files.size(); i = next.fetch_add(1)) {
+                    searchFile(cfg, matcher, files[i], results[i], cfg.follow && i + 1 == files.size());
+                }
+            });
+        }
+        for (auto& w : workers) {
+            w.join();
+        }
+        // 按文件顺序输出，结果与线程数无关
+        size_t total = 0;
+        for (size_t i = 0; i < files.size(); ++i) {
+            std::fwrite(results[i].output.data(), 1, results[i].output.size(), stdout);
+            total += results[i].matches;
+        }
+        std::fflush(stdout);
+        *lastScanned = files.empty() ? 0 : results.back().scanned;
+        return total;
+    }
+
+    // 跟随最新的日志文件，出现更新的文件（轮转或新的运行目录）时读完旧文件再切换
+    void follow(const SearchConfig& cfg, const LineMatcher& matcher, std::string current, size_t offset)
+    {
+        std::string pending;
+        auto readNew = [&](const std::string& path, size_t& pos) {
+            int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+            if (fd < 0) {
+                return;
+            }
+            char buf[1 << 16];
+            for (;;) {
+                ssize_t n = pread(fd, buf, sizeof(buf), static_cast<off_t>(pos));
+                if (n <= 0) {
+                    break;
+                }
+                pos += static_cast<size_t>(n);
+                pending.append(buf, static_cast<size_t>(n));
+            }
+            ::close(fd);
+            // 只处理完整的行，末尾不完整的部分留到下一轮
+            size_t complete = pending.rfind('\n');
+            if (complete == std::string::npos) {
+                return;
+            }
+            FileResult result;
+            matcher.scan(pending.data(), pending.data() + complete + 1, [&](const char* line, size_t length) {
+                appendLine(cfg, path, line, length, result);
+            });
+            pending.erase(0, complete + 1);
+            std::fwrite(result.output.data(), 1, result.output.size(), stdout);
+            std::fflush(stdout);
+        };
+
+        for (;;) {
+            if (!current.empty()) {
+                readNew(current, offset);
+            }
+            std::vector<std::string> files = listLogFiles(cfg.dirs);
+            if (!files.empty() && (current.empty() || logFileBefore(current, files.back()))) {
+                if (!current.empty()) {
+                    readNew(current, offset);   // 轮转前的最后几行
+                }
+                pending.clear();
+                current = files.back();
+                offset = 0;
+                continue;
+            }
+            std::this_thread::sleep_for(cfg.pollInterval);
+        }
+    }
+
+    // 整个参数是一个正的十进制整数时成功
+    bool parseThreads(const std::string& text, unsigned* value)
+    {
+        const char* end = text.data() + text.size();
+        auto result = std::from_chars(text.data(), end, *value);
+        return !text.empty() && result.ec == std::errc() && result.ptr == end && *value > 0;
+    }
+
+    int usage()
+    {
+        std::cerr << "usage: log_search [-e text]... [--level E|W|I|D] [--callsite func[:line]] [-c] [-H]"
+                  << " [--threads N] [-f] logdir..." << std::endl;
+        return 1;
+    }
+}
+
+int main(int argc, char* argv[])
+{
+    SearchConfig cfg;
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        std::string next = (i + 1 < argc) ? argv[i + 1] : "";
+        if (arg == "-e" || arg == "--grep") { cfg.needles.push_back(next); ++i; }
+        else if (arg == "--level") { cfg.needles.push_back("] [" + next.substr(0, 1) + "] "); ++i; }
+        // 调用点在日志中渲染为 "[函数签名:行号] "
+        else if (arg == "--callsite") { cfg.needles.push_back(next + (next.find(':') == std::string::npos ? "" : "] ")); ++i; }
+        else if (arg == "--threads") {
+            if (!parseThreads(next, &cfg.threads)) return usage();
+            ++i;
+        }
+        else if (arg == "-f" || arg == "--follow") { cfg.follow = true; }
+        else if (arg == "-c" || arg == "--count") { cfg.count = true; }
+        else if (arg == "-H" || arg == "--with-filename") { cfg.withFilename = true; }
+        else if (!arg.empty() && arg[0] == '-') { return usage(); }
+        else { cfg.dirs.push_back(arg); }
+    }
+    if (cfg.dirs.empty()) {
+        return usage();
+    }
+    LineMatcher matcher(cfg.needles);
+    std::vector<std::string> files = listLogFiles(cfg.dirs);
+    // 跟随模式从首次搜索实际扫描到的位置接着读，其间追加的行既不遗漏也不重复
+    std::string current = files.empty() ? std::string() : files.back();
+    size_t offset = 0;
+    auto begin = std::chrono::steady_clock::now();
+    size_t matches = searchAll(cfg, matcher, files, &offset);
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - begin).count();
+    if (cfg.count) {
+        std::cout << matches << std::endl;
+    }
+    std::cerr << "files=" << files.size() << " matches=" << matches << " seconds=" << seconds << std::endl;
+
+    if (cfg.follow) {
+        follow(cfg, matcher, current, offset);
+    }
+    return 0;
+}
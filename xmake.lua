@@ -1,5 +1,6 @@
 add_rules("mode.debug", "mode.release")
 add_requires("gtest")
+set_languages("c++17")
 
 target("main")
     set_kind("binary")
@@ -30,3 +31,53 @@ target("gtest_json")
     add_packages("gtest")
     add_files("test/gtest_json.cpp")
     add_deps("main")
+
+target("gtest_Logger")
+    set_kind("binary")
+    add_packages("gtest")
+    add_files("test/gtest_Logger.cpp")
+    add_syslinks("pthread", "rt")
+    add_deps("main")
+
+target("gtest_Logger_coro")
+    set_kind("binary")
+    set_languages("c++20")
+    add_packages("gtest")
+    add_files("test/gtest_Logger_coro.cpp")
+    add_syslinks("pthread", "rt")
+    add_deps("main")
+
+
+
+-- Benchmarks
+target("bench_logger")
+    set_kind("binary")
+    set_optimize("fastest")
+    add_files("bench/bench_logger.cpp")
+    add_syslinks("pthread", "rt")
+    add_deps("main")
+
+
+
+-- Tools
+target("log_query")
+    set_kind("binary")
+    set_optimize("fastest")
+    add_files("tool/log_query.cpp")
+
+target("log_search")
+    set_kind("binary")
+    set_optimize("fastest")
+    add_files("tool/log_search.cpp")
+    add_syslinks("pthread")
+
+target("log_merge")
+    set_kind("binary")
+    set_optimize("fastest")
+    add_files("tool/log_merge.cpp")
+
+target("log_receiver")
+    set_kind("binary")
+    set_optimize("fastest")
+    add_files("tool/log_receiver.cpp")
+    add_syslinks("pthread")